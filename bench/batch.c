@@ -0,0 +1,191 @@
+/*
+ * Compare looking up, inserting and removing keys one after another with the
+ * batch functions, which walk down the tree with multiple keys at once. The
+ * keys are used in random order, so most nodes are not in the cache. The
+ * batch removal purges half of the keys in one call, like a periodic expiry.
+ * In tombstone mode, the removal only clears the data pointers, and the nodes
+ * are removed by a compaction afterwards.
+ */
+
+#include "christree.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define BENCH_LAYERS     16
+#define BENCH_KEYS       2000000
+#define BENCH_LOOKUPS    4000000
+#define BENCH_BATCH      64
+
+
+static const char *variant[] = {"single", "batch", "tomb"};
+
+static u8 keys[BENCH_KEYS][BENCH_LAYERS];
+static u8 *str[BENCH_LOOKUPS];
+static void *res[BENCH_LOOKUPS];
+
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/*
+ * Insert all keys, either one after another or in batches.
+ *
+ * Returns: The throughput in million keys per second
+ */
+static double bench_add(struct dbs_christree *tree, s8 batch)
+{
+	double t;
+	s32 i;
+
+	t = bench_now();
+	if(batch) {
+		for(i = 0; i < BENCH_KEYS; i += BENCH_BATCH)
+			dbs_christree_add_batch(tree, str + i, (void **)(str + i),
+					BENCH_BATCH);
+	}
+	else {
+		for(i = 0; i < BENCH_KEYS; i++)
+			dbs_christree_add(tree, str[i], str[i]);
+	}
+	t = bench_now() - t;
+
+	return BENCH_KEYS / (t / 1e3);
+}
+
+
+/*
+ * Remove the second half of the keys, either one after another or in a
+ * single batch.
+ *
+ * Returns: The throughput in million keys per second
+ */
+static double bench_rmv(struct dbs_christree *tree, s8 batch)
+{
+	double t;
+	s32 i;
+
+	t = bench_now();
+	if(batch) {
+		dbs_christree_rmv_batch(tree, str + BENCH_KEYS / 2, BENCH_KEYS / 2);
+	}
+	else {
+		for(i = BENCH_KEYS / 2; i < BENCH_KEYS; i++)
+			dbs_christree_rmv(tree, str[i]);
+	}
+	t = bench_now() - t;
+
+	return BENCH_KEYS / 2 / (t / 1e3);
+}
+
+
+/*
+ * Look up the keys, either one after another or in batches, and count the
+ * lookups returning the wrong data pointer.
+ *
+ * Returns: The throughput in million keys per second
+ */
+static double bench_get(struct dbs_christree *tree, s8 batch, s32 *bad)
+{
+	double t;
+	s32 i;
+
+	t = bench_now();
+	if(batch) {
+		for(i = 0; i < BENCH_LOOKUPS; i += BENCH_BATCH)
+			dbs_christree_get_batch(tree, str + i, res + i, BENCH_BATCH);
+	}
+	else {
+		for(i = 0; i < BENCH_LOOKUPS; i++)
+			res[i] = dbs_christree_get(tree, str[i]);
+	}
+	t = bench_now() - t;
+
+	*bad = 0;
+	for(i = 0; i < BENCH_LOOKUPS; i++) {
+		if(res[i] != (str[i] < keys[BENCH_KEYS / 2] ? str[i] : NULL))
+			(*bad)++;
+	}
+
+	return BENCH_LOOKUPS / (t / 1e3);
+}
+
+
+/*
+ * Remove the nodes left behind by a removal in tombstone mode.
+ *
+ * Returns: The throughput in million removed keys per second
+ */
+static double bench_compact(struct dbs_christree *tree)
+{
+	double t;
+
+	t = bench_now();
+	dbs_christree_compact(tree);
+	t = bench_now() - t;
+
+	return BENCH_KEYS / 2 / (t / 1e3);
+}
+
+
+int main(void)
+{
+	struct dbs_christree *tree;
+	double mops;
+	s32 ret = 0;
+	s32 bad;
+	s32 i;
+	s32 j;
+	s8 batch;
+	s8 tomb;
+
+	srand(1);
+	for(i = 0; i < BENCH_KEYS; i++) {
+		for(j = 0; j < BENCH_LAYERS; j++)
+			keys[i][j] = rand() % 256;
+	}
+
+	printf("variant,op,mops,bad\n");
+	for(j = 0; j < 3; j++) {
+		batch = j > 0;
+		tomb = j > 1;
+
+		if(!(tree = dbs_christree_init_flags(BENCH_LAYERS,
+						tomb ? DBS_CHRISTREE_TOMB : 0)))
+			return 1;
+
+		for(i = 0; i < BENCH_KEYS; i++)
+			str[i] = keys[i];
+
+		printf("%s,add,%.2f,0\n", variant[j], bench_add(tree, batch));
+
+		/*
+		 * Remove the second half again, so half of the lookups miss.
+		 */
+		printf("%s,rmv,%.2f,0\n", variant[j], bench_rmv(tree, batch));
+
+		if(tomb)
+			printf("%s,compact,%.2f,0\n", variant[j],
+					bench_compact(tree));
+
+		for(i = 0; i < BENCH_LOOKUPS; i++)
+			str[i] = keys[rand() % BENCH_KEYS];
+
+		mops = bench_get(tree, batch, &bad);
+		printf("%s,get,%.2f,%d\n", variant[j], mops, bad);
+		ret |= bad;
+
+		dbs_christree_close(tree);
+	}
+
+	return ret ? 1 : 0;
+}
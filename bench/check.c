@@ -0,0 +1,604 @@
+/*
+ * Check the results of the tree against a brute-force reference. Random keys
+ * are added to a tree and its frozen copy, and every selection is compared
+ * with the keys found by going through all of them, and every bound and range
+ * with the sorted keys. Strings of every length are added and removed in
+ * random order, and all of them are looked up against the strings the
+ * reference holds. Every check is run for a plain tree, a lean tree and a
+ * tree with cross lists. Exits with 1 if any check failed.
+ */
+
+#include "dumbstruct.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define CHECK_LAYERS     6
+#define CHECK_KEYS       4000
+#define CHECK_ROUNDS     2000
+#define CHECK_STEP       64
+#define CHECK_BYTES      3
+#define CHECK_STRS       1092
+#define CHECK_OPS        40000
+#define CHECK_SWEEPS     8
+
+
+static u8 keys[CHECK_KEYS][CHECK_LAYERS];
+static u32 vals[CHECK_KEYS];
+static s32 key_num;
+
+/*
+ * All strings of up to one byte for each layer made of a few bytes, in
+ * ascending order, and the data pointers the reference has linked to them.
+ */
+static u8 strs[CHECK_STRS][CHECK_LAYERS];
+static s32 str_len[CHECK_STRS];
+static u32 str_vals[CHECK_STRS][2];
+static void *str_data[CHECK_STRS];
+static s32 str_num;
+
+static void *data[CHECK_KEYS];
+static u8 buf[CHECK_KEYS][CHECK_LAYERS];
+static u8 seen[CHECK_KEYS];
+static long checks;
+static long failed;
+
+
+static int check_cmp(const void *a, const void *b)
+{
+	return memcmp(a, b, CHECK_LAYERS);
+}
+
+
+static void check_fail(const char *name, const char *msg)
+{
+	if(failed++ < 10)
+		fprintf(stderr, "check failed: %s: %s\n", name, msg);
+}
+
+
+/*
+ * Get the index of the key a data pointer belongs to or -1 if the pointer is
+ * invalid.
+ */
+static s32 check_idx(void *ptr)
+{
+	long idx = (u32 *)ptr - vals;
+
+	if(!ptr || idx < 0 || idx >= key_num)
+		return -1;
+
+	return idx;
+}
+
+
+/*
+ * Compare the data pointers returned by a selection with the keys the
+ * reference has marked in the match array. Every marked key has to be
+ * returned exactly once and no other key may be returned.
+ */
+static void check_set(const char *name, s32 num, u8 *match)
+{
+	s32 exp = 0;
+	s32 idx;
+	s32 i;
+
+	checks++;
+
+	if(num < 0) {
+		check_fail(name, "selection failed");
+		return;
+	}
+
+	memset(seen, 0, key_num);
+
+	for(i = 0; i < num; i++) {
+		if((idx = check_idx(data[i])) < 0 || !match[idx]) {
+			check_fail(name, "returned a key not matching");
+			return;
+		}
+
+		if(seen[idx]++) {
+			check_fail(name, "returned a key twice");
+			return;
+		}
+	}
+
+	for(i = 0; i < key_num; i++)
+		exp += match[i];
+
+	if(num != exp)
+		check_fail(name, "missed a matching key");
+}
+
+
+/*
+ * Set a random condition for a layer of the filter and write the condition
+ * to the reference too. The bytes of the keys are spread out, so the ranges
+ * and bits pick different parts of them.
+ */
+static void check_cond(struct dbs_chrisfilter *flt, s32 off,
+		struct dbs_chrisbyte *ref)
+{
+	u8 b = keys[rand() % key_num][off];
+	u8 lo;
+	u8 hi;
+
+	ref->lo = 0x00;
+	ref->hi = 0xff;
+	ref->msk = 0;
+	ref->val = 0;
+
+	switch(rand() % 5) {
+		case 0:
+			dbs_chrisfilter_set_any(flt, off);
+			return;
+
+		case 1:
+			dbs_chrisfilter_set_exact(flt, off, &b, 1);
+			ref->lo = ref->hi = b;
+			return;
+
+		case 2:
+			lo = rand() % 256;
+			hi = lo + rand() % (256 - lo);
+			dbs_chrisfilter_set_range(flt, off, lo, hi);
+			ref->lo = lo;
+			ref->hi = hi;
+			return;
+
+		case 3:
+			ref->msk = rand() % 256;
+			ref->val = b & ref->msk;
+			dbs_chrisfilter_set_bits(flt, off, ref->msk, ref->val);
+			return;
+
+		default:
+			lo = b - rand() % (b + 1);
+			hi = b + rand() % (256 - b);
+			ref->msk = rand() % 256;
+			ref->val = rand() % 256 & ref->msk;
+			dbs_chrisfilter_set_range(flt, off, lo, hi);
+			dbs_chrisfilter_set_bits(flt, off, ref->msk, ref->val);
+			ref->lo = lo;
+			ref->hi = hi;
+			return;
+	}
+}
+
+
+/*
+ * Filter the tree and its frozen copy with random filters, and select keys
+ * with random masks.
+ */
+static void check_filter(struct dbs_christree *tree,
+		struct dbs_chrisfrozen *frz)
+{
+	struct dbs_chrisbyte ref[CHECK_LAYERS];
+	struct dbs_chrisfilter *flt;
+	struct dbs_chrismask mask;
+	u8 match[CHECK_KEYS];
+	u8 *b;
+	s32 len;
+	s32 r;
+	s32 i;
+	s32 j;
+
+	for(r = 0; r < CHECK_ROUNDS; r++) {
+		len = 1 + rand() % CHECK_LAYERS;
+		if(!(flt = dbs_chrisfilter_init(len))) {
+			check_fail("filter", "no filter");
+			return;
+		}
+
+		for(j = 0; j < len; j++)
+			check_cond(flt, j, &ref[j]);
+
+		for(i = 0; i < key_num; i++) {
+			match[i] = 1;
+
+			for(j = 0; j < len; j++) {
+				b = &keys[i][j];
+				if(*b < ref[j].lo || *b > ref[j].hi ||
+						(*b & ref[j].msk) != ref[j].val)
+					match[i] = 0;
+			}
+		}
+
+		check_set("filter", dbs_christree_filter(tree, flt, data,
+					key_num), match);
+		check_set("frozen filter", dbs_chrisfrozen_filter(frz, flt,
+					data, key_num), match);
+
+		dbs_chrisfilter_close(flt);
+
+		/*
+		 * Select the keys sharing a run of bytes with a random key.
+		 */
+		mask.off = rand() % CHECK_LAYERS;
+		mask.len = 1 + rand() % (CHECK_LAYERS - mask.off);
+		if(mask.len > 2)
+			mask.len = 2;
+
+		mask.data = keys[rand() % key_num] + mask.off;
+
+		for(i = 0; i < key_num; i++)
+			match[i] = !memcmp(keys[i] + mask.off, mask.data,
+					mask.len);
+
+		check_set("sel", dbs_christree_sel(tree, &mask, data, key_num),
+				match);
+		check_set("frozen sel", dbs_chrisfrozen_sel(frz, &mask, data,
+					key_num), match);
+	}
+}
+
+
+/*
+ * Get the index of the first key equal to or bigger than the given string,
+ * or the first key bigger than it, if gt is set.
+ */
+static s32 check_bound(u8 *str, s32 gt)
+{
+	s32 lo = 0;
+	s32 hi = key_num;
+	s32 mid;
+	int cmp;
+
+	while(lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		cmp = memcmp(keys[mid], str, CHECK_LAYERS);
+
+		if(cmp < 0 || (gt && cmp == 0))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+
+/*
+ * Get a random string to look up, which is either a key of the tree or a
+ * key with one byte changed, so it falls between the keys.
+ */
+static void check_str(u8 *str)
+{
+	memcpy(str, keys[rand() % key_num], CHECK_LAYERS);
+
+	if(rand() % 2)
+		str[rand() % CHECK_LAYERS] += rand() % 2 ? 1 : -1;
+}
+
+
+/*
+ * Compare the key and data pointer returned by a bound with the key at the
+ * given index, which is past the last key, if nothing may be found.
+ */
+static void check_hit(const char *name, s32 ret, s32 idx, u8 *key, void *ptr)
+{
+	checks++;
+
+	if(ret != (idx < key_num))
+		check_fail(name, ret < 0 ? "bound failed" :
+				"returned the wrong result");
+	else if(ret && (ptr != &vals[idx] ||
+				memcmp(key, keys[idx], CHECK_LAYERS)))
+		check_fail(name, "returned the wrong key");
+}
+
+
+/*
+ * Compare the keys and data pointers returned by a range with the sorted keys
+ * starting at the given index. The first num keys have to be returned in
+ * order.
+ */
+static void check_run(const char *name, s32 ret, s32 first, s32 num,
+		u8 (*out)[CHECK_LAYERS])
+{
+	s32 i;
+
+	checks++;
+
+	if(ret != num) {
+		check_fail(name, ret < 0 ? "range failed" :
+				"returned the wrong number of keys");
+		return;
+	}
+
+	for(i = 0; i < num; i++) {
+		if(data[i] != &vals[first + i] ||
+				memcmp(out[i], keys[first + i], CHECK_LAYERS)) {
+			check_fail(name, "returned the wrong key");
+			return;
+		}
+	}
+}
+
+
+/*
+ * Look up the bounds of random strings, and get the keys of random ranges at
+ * once, in steps and from the frozen copy.
+ */
+static void check_range(struct dbs_christree *tree,
+		struct dbs_chrisfrozen *frz)
+{
+	struct dbs_christree_scan *scan;
+	u8 lo[CHECK_LAYERS];
+	u8 hi[CHECK_LAYERS];
+	u8 key[CHECK_LAYERS];
+	void *ptr;
+	s32 first;
+	s32 last;
+	s32 lim;
+	s32 num;
+	s32 ret;
+	s32 r;
+
+	for(r = 0; r < CHECK_ROUNDS; r++) {
+		check_str(lo);
+		check_str(hi);
+
+		/*
+		 * Both bounds have to return the first fitting key or nothing.
+		 */
+		first = check_bound(lo, 0);
+		ret = dbs_christree_lower_bound(tree, lo, key, &ptr);
+		check_hit("lower bound", ret, first, key, ptr);
+
+		first = check_bound(lo, 1);
+		ret = dbs_christree_upper_bound(tree, lo, key, &ptr);
+		check_hit("upper bound", ret, first, key, ptr);
+
+		/*
+		 * Leave out either bound now and then, and cut some of the
+		 * ranges short with a limit.
+		 */
+		first = rand() % 8 ? check_bound(lo, 0) : 0;
+		last = rand() % 8 ? check_bound(hi, 0) : key_num;
+		num = last > first ? last - first : 0;
+		lim = rand() % 4 ? key_num : 1 + rand() % CHECK_STEP;
+
+		ret = dbs_christree_range(tree, first ? lo : NULL,
+				last < key_num ? hi : NULL, buf[0], data, lim);
+		check_run("range", ret, first, num < lim ? num : lim, buf);
+
+		ret = dbs_chrisfrozen_range(frz, first ? lo : NULL,
+				last < key_num ? hi : NULL, buf[0], data, lim);
+		check_run("frozen range", ret, first, num < lim ? num : lim,
+				buf);
+
+		/*
+		 * Go through the same range in steps of random size, until the
+		 * scan runs out of keys.
+		 */
+		scan = dbs_christree_range_open(tree, first ? lo : NULL,
+				last < key_num ? hi : NULL);
+		if(!scan) {
+			check_fail("scan", "no scan");
+			continue;
+		}
+
+		while(num >= 0) {
+			lim = 1 + rand() % CHECK_STEP;
+			ret = dbs_christree_range_next(scan, buf[0], data, lim);
+			check_run("scan", ret, first, num < lim ? num : lim,
+					buf);
+
+			if(ret <= 0)
+				break;
+
+			first += ret;
+			num -= ret;
+		}
+
+		dbs_christree_range_close(scan);
+	}
+}
+
+
+/*
+ * Write all strings starting with the given one to the list, each one before
+ * the strings it is the beginning of.
+ */
+static void check_gen(u8 *str, s32 len)
+{
+	s32 i;
+
+	if(len == CHECK_LAYERS)
+		return;
+
+	for(i = 0; i < CHECK_BYTES; i++) {
+		str[len] = i * 37 + len;
+
+		memcpy(strs[str_num], str, len + 1);
+		str_len[str_num++] = len + 1;
+
+		check_gen(str, len + 1);
+	}
+}
+
+
+/*
+ * Look up every string in the tree, and get all keys of the tree in order,
+ * which have to be the strings holding data in the reference, each padded
+ * with zero bytes.
+ */
+static void check_sweep(const char *name, struct dbs_christree *tree)
+{
+	u8 pad[CHECK_LAYERS];
+	s32 ret;
+	s32 num;
+	s32 i;
+
+	for(i = 0; i < str_num; i++) {
+		checks++;
+
+		if(dbs_christree_get_n(tree, strs[i], str_len[i]) !=
+				str_data[i])
+			check_fail(name, "get returned the wrong data");
+
+		if(dbs_christree_contains_n(tree, strs[i], str_len[i]) !=
+				(str_data[i] != NULL))
+			check_fail(name, "contains returned the wrong result");
+	}
+
+	ret = dbs_christree_range(tree, NULL, NULL, buf[0], data, str_num);
+
+	checks++;
+
+	for(num = 0, i = 0; ret >= 0 && i < str_num; i++) {
+		if(!str_data[i])
+			continue;
+
+		memset(pad, 0, CHECK_LAYERS);
+		memcpy(pad, strs[i], str_len[i]);
+
+		if(num >= ret || data[num] != str_data[i] ||
+				memcmp(buf[num], pad, CHECK_LAYERS)) {
+			check_fail(name, "range returned the wrong key");
+			return;
+		}
+
+		num++;
+	}
+
+	if(ret != num)
+		check_fail(name, "range returned the wrong number of keys");
+}
+
+
+/*
+ * Add and remove strings of every length in random order, so the data of
+ * shorter strings is linked to nodes inside the branches of longer ones, and
+ * look them up now and then. Finally the frozen copy has to hold the same
+ * strings.
+ */
+static void check_len(u32 flags)
+{
+	struct dbs_christree *tree;
+	struct dbs_chrisfrozen *frz;
+	s32 r;
+	s32 i;
+
+	if(!(tree = dbs_christree_init_flags(CHECK_LAYERS, flags))) {
+		check_fail("len", "no tree");
+		return;
+	}
+
+	memset(str_data, 0, sizeof(str_data));
+
+	for(r = 0; r < CHECK_OPS; r++) {
+		i = rand() % str_num;
+
+		/*
+		 * Add more often than remove, and replace the data of strings
+		 * already in the tree now and then.
+		 */
+		if(rand() % 3) {
+			str_data[i] = &str_vals[i][rand() % 2];
+			if(dbs_christree_add_n(tree, strs[i], str_len[i],
+						str_data[i]) < 0)
+				check_fail("len", "add failed");
+		}
+		else {
+			dbs_christree_rmv_n(tree, strs[i], str_len[i]);
+			str_data[i] = NULL;
+		}
+
+		if((r + 1) % (CHECK_OPS / CHECK_SWEEPS))
+			continue;
+
+		check_sweep("len", tree);
+
+		if(dbs_christree_compact(tree) < 0)
+			check_fail("len", "compact failed");
+
+		check_sweep("len compacted", tree);
+	}
+
+	if(!(frz = dbs_christree_freeze(tree))) {
+		check_fail("len", "no frozen tree");
+		dbs_christree_close(tree);
+		return;
+	}
+
+	for(i = 0; i < str_num; i++) {
+		checks++;
+
+		if(dbs_chrisfrozen_get_n(frz, strs[i], str_len[i]) !=
+				str_data[i])
+			check_fail("frozen len", "get returned the wrong data");
+
+		if(dbs_chrisfrozen_contains_n(frz, strs[i], str_len[i]) !=
+				(str_data[i] != NULL))
+			check_fail("frozen len",
+					"contains returned the wrong result");
+	}
+
+	dbs_chrisfrozen_close(frz);
+	dbs_christree_close(tree);
+}
+
+
+int main(void)
+{
+	u32 flags[3];
+	struct dbs_christree *tree;
+	struct dbs_chrisfrozen *frz;
+	u8 str[CHECK_LAYERS];
+	s32 i;
+	s32 j;
+	s32 f;
+
+	flags[0] = 0;
+	flags[1] = DBS_CHRISTREE_LEAN;
+	flags[2] = DBS_CHRISTREE_CROSS;
+
+	/*
+	 * Use few distinct bytes spread over the whole range, so the keys share
+	 * prefixes and the conditions cut through the children of the nodes.
+	 */
+	srand(1);
+	for(i = 0; i < CHECK_KEYS; i++) {
+		for(j = 0; j < CHECK_LAYERS; j++)
+			keys[i][j] = (rand() % (j < 2 ? 16 : 4)) * 37 + j;
+	}
+
+	qsort(keys, CHECK_KEYS, CHECK_LAYERS, check_cmp);
+	for(key_num = 1, i = 1; i < CHECK_KEYS; i++) {
+		if(memcmp(keys[i], keys[key_num - 1], CHECK_LAYERS))
+			memcpy(keys[key_num++], keys[i], CHECK_LAYERS);
+	}
+
+	check_gen(str, 0);
+
+	for(f = 0; f < 3; f++) {
+		if(!(tree = dbs_christree_init_flags(CHECK_LAYERS, flags[f])))
+			return 1;
+
+		for(i = 0; i < key_num; i++) {
+			vals[i] = i;
+			if(dbs_christree_add(tree, keys[i], &vals[i]) < 0)
+				return 1;
+		}
+
+		if(!(frz = dbs_christree_freeze(tree)))
+			return 1;
+
+		check_filter(tree, frz);
+		check_range(tree, frz);
+
+		dbs_chrisfrozen_close(frz);
+		dbs_christree_close(tree);
+
+		check_len(flags[f]);
+	}
+
+	printf("keys %d, strings %d, checks %ld, failed %ld\n", key_num,
+			str_num, checks, failed);
+	return failed > 0;
+}
@@ -0,0 +1,83 @@
+/*
+ * Compare the startup time of rebuilding a tree by adding every key against
+ * mapping a saved tree.
+ */
+
+#include "dumbstruct.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define BENCH_LAYERS     16
+#define BENCH_KEYS       1000000
+#define BENCH_FILE       "bench_file.dbs"
+
+
+static u8 keys[BENCH_KEYS][BENCH_LAYERS];
+
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+int main(void)
+{
+	struct dbs_christree *tree;
+	struct dbs_chrisfrozen *frz;
+	double t_add;
+	double t_map;
+	double t_save;
+	double t;
+	s32 found = 0;
+	s32 i;
+	s32 j;
+
+	srand(1);
+	for(i = 0; i < BENCH_KEYS; i++) {
+		for(j = 0; j < BENCH_LAYERS; j++)
+			keys[i][j] = j < 4 ? rand() % 16 : rand() % 256;
+	}
+
+	/*
+	 * The key itself is used as the value.
+	 */
+	t = bench_now();
+	if(!(tree = dbs_christree_init(BENCH_LAYERS)))
+		return 1;
+
+	for(i = 0; i < BENCH_KEYS; i++)
+		dbs_christree_add(tree, keys[i], keys[i]);
+	t_add = bench_now() - t;
+
+	t = bench_now();
+	if(dbs_christree_save(tree, BENCH_FILE, BENCH_LAYERS) < 0)
+		return 1;
+	t_save = bench_now() - t;
+
+	dbs_christree_close(tree);
+
+	t = bench_now();
+	if(!(frz = dbs_chrisfrozen_map(BENCH_FILE)))
+		return 1;
+	t_map = bench_now() - t;
+
+	for(i = 0; i < BENCH_KEYS; i++)
+		found += dbs_chrisfrozen_get(frz, keys[i]) != NULL;
+
+	printf("variant,keys,ms\n");
+	printf("add,%d,%.2f\n", BENCH_KEYS, t_add / 1e6);
+	printf("save,%d,%.2f\n", BENCH_KEYS, t_save / 1e6);
+	printf("map,%d,%.2f\n", found, t_map / 1e6);
+
+	dbs_chrisfrozen_close(frz);
+	remove(BENCH_FILE);
+	return 0;
+}
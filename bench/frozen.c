@@ -0,0 +1,96 @@
+/*
+ * Compare the memory use and the lookup speed of a tree with its frozen
+ * copy.
+ */
+
+#include "dumbstruct.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define BENCH_LAYERS     16
+#define BENCH_KEYS       1000000
+#define BENCH_ROUNDS     4
+
+
+static u8 keys[BENCH_KEYS][BENCH_LAYERS];
+
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+static double bench_slab_size(struct dbs_slab *slab)
+{
+	return (double)slab->chunk_num * (sizeof(struct dbs_slab_chunk) +
+			slab->per_chunk * slab->size);
+}
+
+
+int main(void)
+{
+	struct dbs_christree *tree;
+	struct dbs_chrisfrozen *frz;
+	double t_tree = 0;
+	double t_frz = 0;
+	double m_tree;
+	double t;
+	s32 n_tree = 0;
+	s32 n_frz = 0;
+	s32 i;
+	s32 j;
+
+	if(!(tree = dbs_christree_init(BENCH_LAYERS)))
+		return 1;
+
+	/*
+	 * Dense upper layers and random lower layers, like addresses.
+	 */
+	srand(1);
+	for(i = 0; i < BENCH_KEYS; i++) {
+		for(j = 0; j < BENCH_LAYERS; j++)
+			keys[i][j] = j < 4 ? rand() % 16 : rand() % 256;
+
+		dbs_christree_add(tree, keys[i], keys[i]);
+	}
+
+	if(!(frz = dbs_christree_freeze(tree)))
+		return 1;
+
+	m_tree = bench_slab_size(&tree->node_slab);
+	for(i = 0; i < 4; i++)
+		m_tree += bench_slab_size(&tree->next_slab[i]);
+
+	/*
+	 * Look the keys up in a different order than they were added in.
+	 */
+	for(i = 0; i < BENCH_ROUNDS; i++) {
+		t = bench_now();
+		for(j = 0; j < BENCH_KEYS; j++)
+			n_tree += dbs_christree_get(tree, keys[((u64)j * 7919) % BENCH_KEYS]) != NULL;
+		t_tree += bench_now() - t;
+
+		t = bench_now();
+		for(j = 0; j < BENCH_KEYS; j++)
+			n_frz += dbs_chrisfrozen_get(frz, keys[((u64)j * 7919) % BENCH_KEYS]) != NULL;
+		t_frz += bench_now() - t;
+	}
+
+	printf("variant,found,ns_per_get,bytes_per_key\n");
+	printf("tree,%d,%.2f,%.2f\n", n_tree, t_tree / n_tree,
+			m_tree / BENCH_KEYS);
+	printf("frozen,%d,%.2f,%.2f\n", n_frz, t_frz / n_frz,
+			(double)frz->size / BENCH_KEYS);
+
+	dbs_chrisfrozen_close(frz);
+	dbs_christree_close(tree);
+	return 0;
+}
@@ -0,0 +1,262 @@
+/*
+ * Compare the old byte-wise hash with the seeded 64-bit hash. The throughput
+ * is measured on keys of different lengths. The distribution is measured on
+ * structured keys, like consecutive IPv4 addresses or counters with a shared
+ * prefix, by spreading them into buckets with the lowest bits of the hash,
+ * as a hash map does, and by flipping single bits of the keys. The fixed
+ * length fast paths are checked against the general hash.
+ */
+
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define BENCH_BYTES      (1 << 26)
+#define BENCH_BUCKETS    (1 << 16)
+#define BENCH_KEYS       (1 << 20)
+#define BENCH_FLIPS      10000
+#define BENCH_MAXLEN     64
+
+
+enum bench_hash {
+	BENCH_DJB2,
+	BENCH_HASH64,
+	BENCH_FAST
+};
+
+
+static const char *names[] = {"djb2", "hash64", "fast"};
+static u8 buf[BENCH_BYTES];
+static u32 cnt[BENCH_BUCKETS];
+static volatile u64 sink;
+
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/*
+ * Hash a key with one of the hashes. The fast paths are used for the lengths
+ * they exist for and the general hash otherwise.
+ */
+static u64 bench_hash(enum bench_hash h, u8 *key, s32 len)
+{
+	if(h == BENCH_DJB2)
+		return dbs_hash(key, len);
+
+	if(h == BENCH_FAST) {
+		if(len == 4)
+			return dbs_hash64_4(key, 1);
+
+		if(len == 8)
+			return dbs_hash64_8(key, 1);
+
+		if(len == 16)
+			return dbs_hash64_16(key, 1);
+	}
+
+	return dbs_hash64(key, len, 1);
+}
+
+
+/*
+ * Hash all keys of a length in the buffer.
+ *
+ * Returns: The throughput in million keys per second
+ */
+static double bench_speed(enum bench_hash h, s32 len)
+{
+	u64 acc = 0;
+	double t;
+	s32 i;
+
+	t = bench_now();
+	for(i = 0; i + len <= BENCH_BYTES; i += len)
+		acc += bench_hash(h, buf + i, len);
+	t = bench_now() - t;
+
+	sink = acc;
+	return (BENCH_BYTES / len) / (t / 1e3);
+}
+
+
+/*
+ * Write the key with the given number, which is either a big endian IPv4
+ * address, an IPv6 address with a fixed /64 prefix or a short decimal string.
+ *
+ * Returns: The length of the key
+ */
+static s32 bench_key(s32 type, u32 num, u8 *key)
+{
+	s32 i;
+
+	switch(type) {
+		case 0:
+			key[0] = 10;
+			key[1] = num >> 16;
+			key[2] = num >> 8;
+			key[3] = num;
+			return 4;
+
+		case 1:
+			memset(key, 0, 16);
+			key[0] = 0x20;
+			key[1] = 0x01;
+			key[2] = 0x0d;
+			key[3] = 0xb8;
+			for(i = 0; i < 4; i++)
+				key[15 - i] = num >> (i * 8);
+			return 16;
+
+		default:
+			return sprintf((char *)key, "key%u", num);
+	}
+}
+
+
+/*
+ * Put all keys of a type into buckets by the lowest bits of their hashes.
+ *
+ * Returns: The chi-squared value divided by the number of buckets, which
+ *          is close to 1 for a uniform distribution
+ */
+static double bench_chi(enum bench_hash h, s32 type, u32 *max)
+{
+	u8 key[BENCH_MAXLEN];
+	double exp = (double)BENCH_KEYS / BENCH_BUCKETS;
+	double chi = 0;
+	s32 len;
+	s32 i;
+
+	memset(cnt, 0, sizeof(cnt));
+	for(i = 0; i < BENCH_KEYS; i++) {
+		len = bench_key(type, i, key);
+		cnt[bench_hash(h, key, len) & (BENCH_BUCKETS - 1)]++;
+	}
+
+	*max = 0;
+	for(i = 0; i < BENCH_BUCKETS; i++) {
+		chi += (cnt[i] - exp) * (cnt[i] - exp) / exp;
+
+		if(cnt[i] > *max)
+			*max = cnt[i];
+	}
+
+	return chi / BENCH_BUCKETS;
+}
+
+
+/*
+ * Flip every bit of random keys of a type and count how often every bit of
+ * the hash changes, which should be half of the time.
+ *
+ * Returns: The largest difference of a bit from flipping half of the time
+ */
+static double bench_avalanche(enum bench_hash h, s32 type)
+{
+	static u32 flip[64];
+	u8 key[BENCH_MAXLEN];
+	double bias = 0;
+	double tmp;
+	u64 org;
+	u64 dif;
+	s32 len;
+	s32 num = 0;
+	s32 i;
+	s32 j;
+	s32 b;
+
+	memset(flip, 0, sizeof(flip));
+	for(i = 0; i < BENCH_FLIPS; i++) {
+		len = bench_key(type, rand(), key);
+		org = bench_hash(h, key, len);
+
+		for(j = 0; j < len * 8; j++) {
+			key[j / 8] ^= 1 << (j % 8);
+			dif = org ^ bench_hash(h, key, len);
+			key[j / 8] ^= 1 << (j % 8);
+
+			for(b = 0; b < 64; b++)
+				flip[b] += (dif >> b) & 1;
+
+			num++;
+		}
+	}
+
+	for(b = 0; b < 64; b++) {
+		tmp = (double)flip[b] / num - 0.5;
+		if(tmp < 0)
+			tmp = -tmp;
+
+		if(tmp > bias)
+			bias = tmp;
+	}
+
+	return bias;
+}
+
+
+int main(void)
+{
+	struct dbs_hash64_state st;
+	double chi;
+	u32 max;
+	s32 bad = 0;
+	s32 i;
+	s32 h;
+	s32 t;
+
+	static const s32 lens[] = {4, 8, 16, 64, 1024};
+	static const char *types[] = {"ipv4", "ipv6", "text"};
+
+	srand(1);
+	for(i = 0; i < BENCH_BYTES; i++)
+		buf[i] = rand();
+
+	/*
+	 * The fast paths and the incremental hash have to match the general
+	 * hash.
+	 */
+	for(i = 0; i < 1024; i++) {
+		dbs_hash64_init(&st, i);
+		dbs_hash64_update(&st, buf, i / 2);
+		dbs_hash64_update(&st, buf + i / 2, i - i / 2);
+
+		if(dbs_hash64_final(&st) != dbs_hash64(buf, i, i))
+			bad++;
+	}
+
+	bad += dbs_hash64_4(buf, 7) != dbs_hash64(buf, 4, 7);
+	bad += dbs_hash64_8(buf, 7) != dbs_hash64(buf, 8, 7);
+	bad += dbs_hash64_16(buf, 7) != dbs_hash64(buf, 16, 7);
+
+	printf("hash,test,param,value,max,bad\n");
+	for(h = BENCH_DJB2; h <= BENCH_FAST; h++) {
+		for(i = 0; i < (s32)(sizeof(lens) / sizeof(lens[0])); i++) {
+			printf("%s,mops,%d,%.2f,0,%d\n", names[h], lens[i],
+					bench_speed(h, lens[i]), bad);
+		}
+
+		for(t = 0; t < 3; t++) {
+			chi = bench_chi(h, t, &max);
+			printf("%s,chi,%s,%.3f,%u,%d\n", names[h], types[t], chi,
+					max, bad);
+		}
+
+		for(t = 0; t < 3; t++) {
+			printf("%s,avalanche,%s,%.4f,0,%d\n", names[h], types[t],
+					bench_avalanche(h, t), bad);
+		}
+	}
+
+	return bad ? 1 : 0;
+}
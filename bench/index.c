@@ -0,0 +1,105 @@
+/*
+ * Compare exact lookups walking down the tree with lookups in the hash index.
+ * The keys are looked up in random order and half of them are not in the
+ * tree, so both hits and misses are measured.
+ */
+
+#include "christree.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define BENCH_LAYERS     16
+#define BENCH_KEYS       2000000
+#define BENCH_LOOKUPS    4000000
+
+
+static u8 keys[BENCH_KEYS][BENCH_LAYERS];
+static u8 *str[BENCH_LOOKUPS];
+static void *res[BENCH_LOOKUPS];
+
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/*
+ * Look up the keys and count the lookups returning the wrong data pointer.
+ *
+ * Returns: The throughput in million keys per second
+ */
+static double bench_get(struct dbs_christree *tree, s32 *bad)
+{
+	double t;
+	s32 i;
+
+	t = bench_now();
+	for(i = 0; i < BENCH_LOOKUPS; i++)
+		res[i] = dbs_christree_get(tree, str[i]);
+	t = bench_now() - t;
+
+	*bad = 0;
+	for(i = 0; i < BENCH_LOOKUPS; i++) {
+		if(res[i] != (str[i] < keys[BENCH_KEYS / 2] ? str[i] : NULL))
+			(*bad)++;
+	}
+
+	return BENCH_LOOKUPS / (t / 1e3);
+}
+
+
+int main(void)
+{
+	struct dbs_christree *tree;
+	double mops;
+	double t;
+	s32 ret = 0;
+	s32 bad;
+	s32 i;
+	s32 j;
+
+	if(!(tree = dbs_christree_init(BENCH_LAYERS)))
+		return 1;
+
+	srand(1);
+	for(i = 0; i < BENCH_KEYS; i++) {
+		for(j = 0; j < BENCH_LAYERS; j++)
+			keys[i][j] = rand() % 256;
+
+		if(i < BENCH_KEYS / 2)
+			dbs_christree_add(tree, keys[i], keys[i]);
+	}
+
+	for(i = 0; i < BENCH_LOOKUPS; i++)
+		str[i] = keys[rand() % BENCH_KEYS];
+
+	printf("variant,op,mops,bad\n");
+
+	mops = bench_get(tree, &bad);
+	printf("tree,get,%.2f,%d\n", mops, bad);
+	ret |= bad;
+
+	/*
+	 * Build the index from the existing tree, which is timed as well.
+	 */
+	t = bench_now();
+	if(dbs_christree_index(tree) < 0)
+		return 1;
+	t = bench_now() - t;
+	printf("index,build,%.2f,0\n", BENCH_KEYS / 2 / (t / 1e3));
+
+	mops = bench_get(tree, &bad);
+	printf("index,get,%.2f,%d\n", mops, bad);
+	ret |= bad;
+
+	dbs_christree_close(tree);
+	return ret ? 1 : 0;
+}
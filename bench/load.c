@@ -0,0 +1,83 @@
+/*
+ * Compare building a tree with one dbs_christree_add() call per key against
+ * the bulk load from a sorted array.
+ */
+
+#include "christree.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define BENCH_LAYERS     16
+#define BENCH_KEYS       1000000
+
+
+static u8 keys[BENCH_KEYS][BENCH_LAYERS];
+static void *data[BENCH_KEYS];
+
+
+static int bench_cmp(const void *a, const void *b)
+{
+	return memcmp(a, b, BENCH_LAYERS);
+}
+
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+int main(void)
+{
+	struct dbs_christree *tree;
+	double t_add;
+	double t_load;
+	double t;
+	s32 i;
+	s32 j;
+
+	/*
+	 * Dense upper layers and random lower layers, like addresses.
+	 */
+	srand(1);
+	for(i = 0; i < BENCH_KEYS; i++) {
+		for(j = 0; j < BENCH_LAYERS; j++)
+			keys[i][j] = j < 4 ? rand() % 16 : rand() % 256;
+
+		data[i] = keys[i];
+	}
+
+	qsort(keys, BENCH_KEYS, BENCH_LAYERS, bench_cmp);
+
+	if(!(tree = dbs_christree_init(BENCH_LAYERS)))
+		return 1;
+
+	t = bench_now();
+	for(i = 0; i < BENCH_KEYS; i++)
+		dbs_christree_add(tree, keys[i], data[i]);
+	t_add = bench_now() - t;
+
+	dbs_christree_close(tree);
+
+	if(!(tree = dbs_christree_init(BENCH_LAYERS)))
+		return 1;
+
+	t = bench_now();
+	if(dbs_christree_load_array(tree, keys[0], data, BENCH_KEYS) < 0)
+		return 1;
+	t_load = bench_now() - t;
+
+	dbs_christree_close(tree);
+
+	printf("variant,keys,ns_per_key\n");
+	printf("add,%d,%.2f\n", BENCH_KEYS, t_add / BENCH_KEYS);
+	printf("load,%d,%.2f\n", BENCH_KEYS, t_load / BENCH_KEYS);
+	return 0;
+}
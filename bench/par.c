@@ -0,0 +1,138 @@
+/*
+ * Compare the mask selection on a single thread with the parallel selection
+ * on pools with a growing number of workers. The masks are broad, so a large
+ * part of the tree is selected. Every parallel result is checked against the
+ * result of the single thread, ignoring the order.
+ */
+
+#include "christree.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define BENCH_LAYERS     16
+#define BENCH_KEYS       1000000
+#define BENCH_WORKERS    32
+#define BENCH_ROUNDS     5
+
+
+static u8 keys[BENCH_KEYS][BENCH_LAYERS];
+static void *res[BENCH_KEYS];
+static void *ref[BENCH_KEYS];
+
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+static int bench_cmp(const void *a, const void *b)
+{
+	char *x = *(char **)a;
+	char *y = *(char **)b;
+
+	return x < y ? -1 : x > y;
+}
+
+
+/*
+ * Run a selection a few times, either on the calling thread or on a pool, and
+ * keep the sorted result of the last round.
+ *
+ * Returns: The average time of a round in milliseconds
+ */
+static double bench_sel(struct dbs_christree *tree, struct dbs_pool *pool,
+		struct dbs_chrismask *mask, void **data, s32 *num)
+{
+	double t;
+	s32 i;
+
+	t = bench_now();
+	for(i = 0; i < BENCH_ROUNDS; i++) {
+		if(pool)
+			*num = dbs_christree_sel_par(tree, pool, mask, data,
+					BENCH_KEYS);
+		else
+			*num = dbs_christree_sel(tree, mask, data, BENCH_KEYS);
+	}
+	t = bench_now() - t;
+
+	if(*num > 0)
+		qsort(data, *num, sizeof(void *), bench_cmp);
+
+	return t / BENCH_ROUNDS / 1e6;
+}
+
+
+int main(int argc, char **argv)
+{
+	struct dbs_christree *tree;
+	struct dbs_chrismask mask;
+	struct dbs_pool *pool;
+	s32 max = argc > 1 ? atoi(argv[1]) : 8;
+	s32 ref_num;
+	s32 num;
+	s32 bad;
+	s32 ret = 0;
+	s32 i;
+	s32 j;
+	s32 m;
+	double t;
+	u8 chr = 1;
+
+	/*
+	 * The masks start either at the first layer, so the whole tree is
+	 * walked from the root, or further down, so the branches are found in
+	 * the layer lists.
+	 */
+	static const s32 offs[] = {0, 2, 6};
+
+	if(max < 1 || max > BENCH_WORKERS)
+		max = BENCH_WORKERS;
+
+	if(!(tree = dbs_christree_init(BENCH_LAYERS)))
+		return 1;
+
+	srand(1);
+	for(i = 0; i < BENCH_KEYS; i++) {
+		for(j = 0; j < BENCH_LAYERS; j++)
+			keys[i][j] = j < 8 ? rand() % 4 : rand() % 256;
+
+		dbs_christree_add(tree, keys[i], keys[i]);
+	}
+
+	mask.len = 1;
+	mask.data = &chr;
+
+	printf("variant,workers,off,results,ms,bad\n");
+	for(m = 0; m < (s32)(sizeof(offs) / sizeof(offs[0])); m++) {
+		mask.off = offs[m];
+
+		t = bench_sel(tree, NULL, &mask, ref, &ref_num);
+		printf("sel,1,%d,%d,%.2f,0\n", mask.off, ref_num, t);
+
+		for(i = 1; i <= max; i *= 2) {
+			if(!(pool = dbs_pool_init(i)))
+				return 1;
+
+			t = bench_sel(tree, pool, &mask, res, &num);
+
+			bad = num != ref_num ||
+				memcmp(res, ref, num * sizeof(void *)) != 0;
+			ret |= bad;
+
+			printf("par,%d,%d,%d,%.2f,%d\n", i, mask.off, num, t, bad);
+			dbs_pool_close(pool);
+		}
+	}
+
+	dbs_christree_close(tree);
+	return ret ? 1 : 0;
+}
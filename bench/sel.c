@@ -0,0 +1,180 @@
+/*
+ * Compare the iterative mask selection with the recursive walk it replaced.
+ *
+ * The recursive version is kept here as a reference. It collects the data
+ * pointers of the same branches, but goes through the children with one
+ * function call per node.
+ *
+ * Both are run on a deep tree, where most keys end in a compressed leaf, and
+ * on a dense tree, where most keys are kept in the v_next lists above the
+ * last layer.
+ */
+
+#include "christree.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define BENCH_LAYERS     32
+#define BENCH_KEYS       200000
+#define BENCH_ROUNDS     20
+#define BENCH_DENSE      4
+
+
+static u8 keys[BENCH_KEYS][BENCH_LAYERS];
+static void *res[BENCH_KEYS];
+
+
+struct bench_pass {
+	struct dbs_christree   *tree;
+	s32                    c;
+	s32                    lim;
+	void                   **data;
+};
+
+
+static void bench_rec(struct dbs_christree_node *n, struct bench_pass *pass)
+{
+	struct dbs_christree_node *n_ptr;
+	void *val;
+	s32 i = 0;
+
+	if(n->data != NULL && pass->c < pass->lim)
+		pass->data[pass->c++] = n->data;
+
+	if(pass->c >= pass->lim)
+		return;
+
+	if(dbs_christree_has_vals(pass->tree, n) == 1) {
+		while(pass->c < pass->lim &&
+				(val = dbs_christree_ceil_val(pass->tree, n, &i))) {
+			pass->data[pass->c++] = val;
+			i++;
+		}
+
+		return;
+	}
+
+	n_ptr = dbs_christree_ceil_v_next(n, 0);
+	while(n_ptr) {
+		bench_rec(n_ptr, pass);
+
+		n_ptr = dbs_christree_ceil_v_next(n, n_ptr->dif + 1);
+	}
+}
+
+
+static s32 bench_sel_rec(struct dbs_christree *tree, struct dbs_chrismask *mask,
+		void **data, s32 lim)
+{
+	struct dbs_christree_node *lst[64];
+	struct bench_pass pass;
+	s32 num;
+	s32 i;
+
+	num = dbs_christree_get_layer(tree, mask->off, mask->data[0], lst, 64);
+
+	pass.tree = tree;
+	pass.c = 0;
+	pass.lim = lim;
+	pass.data = data;
+
+	for(i = 0; i < num; i++)
+		bench_rec(lst[i], &pass);
+
+	return pass.c;
+}
+
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/*
+ * Fill a tree with the keys and compare both selections on it, with a mask
+ * for every value of the first byte.
+ */
+static s8 bench_run(const char *name, s32 layers, s32 difs)
+{
+	struct dbs_christree *tree;
+	struct dbs_chrismask mask;
+	double t_rec = 0;
+	double t_iter = 0;
+	double t;
+	s32 n_rec = 0;
+	s32 n_iter = 0;
+	s32 i;
+	u8 dif;
+
+	if(!(tree = dbs_christree_init(layers)))
+		return -1;
+
+	for(i = 0; i < BENCH_KEYS; i++)
+		dbs_christree_add(tree, keys[i], keys[i]);
+
+	mask.off = 0;
+	mask.len = 1;
+	mask.data = &dif;
+
+	for(i = 0; i < BENCH_ROUNDS; i++) {
+		dif = i % difs;
+
+		t = bench_now();
+		n_rec += bench_sel_rec(tree, &mask, res, BENCH_KEYS);
+		t_rec += bench_now() - t;
+
+		t = bench_now();
+		n_iter += dbs_christree_sel(tree, &mask, res, BENCH_KEYS);
+		t_iter += bench_now() - t;
+	}
+
+	printf("%s,recursive,%d,%.2f\n", name, n_rec, t_rec / n_rec);
+	printf("%s,iterative,%d,%.2f\n", name, n_iter, t_iter / n_iter);
+
+	dbs_christree_close(tree);
+	return 0;
+}
+
+
+int main(void)
+{
+	s32 i;
+	s32 j;
+
+	printf("tree,variant,results,ns_per_result\n");
+
+	/*
+	 * Use only a few different characters in the upper layers, so the
+	 * branches get deep before they are compressed.
+	 */
+	srand(1);
+	for(i = 0; i < BENCH_KEYS; i++) {
+		for(j = 0; j < BENCH_LAYERS; j++)
+			keys[i][j] = j < 16 ? rand() % 3 : rand() % 256;
+	}
+
+	if(bench_run("deep", BENCH_LAYERS, 3) < 0)
+		return 1;
+
+	/*
+	 * With few different characters above the last layer, the last bytes
+	 * of most keys share a v_next list.
+	 */
+	for(i = 0; i < BENCH_KEYS; i++) {
+		for(j = 0; j < BENCH_DENSE; j++)
+			keys[i][j] = j < BENCH_DENSE - 1 ? rand() % 16 : rand();
+	}
+
+	if(bench_run("dense", BENCH_DENSE, 16) < 0)
+		return 1;
+
+	return 0;
+}
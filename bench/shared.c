@@ -0,0 +1,174 @@
+/*
+ * Compare the lookup throughput of readers sharing a tree with a writer, when
+ * every call is serialized by a global mutex against lock-free readers.
+ */
+
+#include "christree.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define BENCH_LAYERS     16
+#define BENCH_KEYS       1000000
+#define BENCH_READERS    32
+#define BENCH_BATCH      64
+#define BENCH_MS         500
+
+
+static u8 keys[BENCH_KEYS][BENCH_LAYERS];
+
+static struct dbs_christree *tree;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static s32 use_lock;
+static s32 stop;
+
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+static void *bench_reader(void *arg)
+{
+	struct dbs_epoch_reader *rd = NULL;
+	unsigned int seed = (unsigned int)(long)arg;
+	long *num;
+	s32 i;
+
+	if(!(num = malloc(sizeof(long))))
+		return NULL;
+
+	*num = 0;
+
+	if(!use_lock && !(rd = dbs_christree_reader_open(tree)))
+		return num;
+
+	while(!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+		if(use_lock)
+			pthread_mutex_lock(&lock);
+		else
+			dbs_epoch_enter(rd);
+
+		for(i = 0; i < BENCH_BATCH; i++)
+			dbs_christree_get(tree, keys[rand_r(&seed) % BENCH_KEYS]);
+
+		if(use_lock)
+			pthread_mutex_unlock(&lock);
+		else
+			dbs_epoch_leave(rd);
+
+		*num += BENCH_BATCH;
+	}
+
+	if(rd)
+		dbs_epoch_reader_close(rd);
+
+	return num;
+}
+
+
+/*
+ * Keep removing and adding back keys, so the readers compete with a writer.
+ */
+static void *bench_writer(void *arg)
+{
+	unsigned int seed = (unsigned int)(long)arg;
+	u8 *key;
+
+	while(!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+		key = keys[rand_r(&seed) % BENCH_KEYS];
+
+		if(use_lock)
+			pthread_mutex_lock(&lock);
+
+		dbs_christree_rmv(tree, key);
+		dbs_christree_add(tree, key, key);
+
+		if(use_lock)
+			pthread_mutex_unlock(&lock);
+	}
+
+	return NULL;
+}
+
+
+static double bench_run(s32 readers)
+{
+	pthread_t th[BENCH_READERS + 1];
+	struct timespec ts;
+	double t;
+	long sum = 0;
+	void *num;
+	s32 i;
+
+	stop = 0;
+	t = bench_now();
+
+	pthread_create(&th[0], NULL, bench_writer, (void *)1L);
+	for(i = 1; i <= readers; i++)
+		pthread_create(&th[i], NULL, bench_reader, (void *)(long)(i + 1));
+
+	ts.tv_sec = BENCH_MS / 1000;
+	ts.tv_nsec = (BENCH_MS % 1000) * 1000000L;
+	nanosleep(&ts, NULL);
+
+	__atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+
+	pthread_join(th[0], NULL);
+	for(i = 1; i <= readers; i++) {
+		pthread_join(th[i], &num);
+		if(num) {
+			sum += *(long *)num;
+			free(num);
+		}
+	}
+
+	t = bench_now() - t;
+	return sum / (t / 1e3);
+}
+
+
+int main(int argc, char **argv)
+{
+	s32 max = argc > 1 ? atoi(argv[1]) : 8;
+	s32 i;
+	s32 j;
+
+	if(max < 1 || max > BENCH_READERS)
+		max = BENCH_READERS;
+
+	srand(1);
+	for(i = 0; i < BENCH_KEYS; i++) {
+		for(j = 0; j < BENCH_LAYERS; j++)
+			keys[i][j] = j < 4 ? rand() % 16 : rand() % 256;
+	}
+
+	if(!(tree = dbs_christree_init(BENCH_LAYERS)))
+		return 1;
+
+	if(dbs_christree_share(tree, BENCH_READERS) < 0)
+		return 1;
+
+	for(i = 0; i < BENCH_KEYS; i++)
+		dbs_christree_add(tree, keys[i], keys[i]);
+
+	printf("variant,readers,mops\n");
+	for(i = 1; i <= max; i *= 2) {
+		use_lock = 1;
+		printf("mutex,%d,%.2f\n", i, bench_run(i));
+
+		use_lock = 0;
+		printf("epoch,%d,%.2f\n", i, bench_run(i));
+	}
+
+	dbs_christree_close(tree);
+	return 0;
+}
@@ -0,0 +1,349 @@
+/*
+ * Check a shared tree for correctness, while writers keep adding and removing
+ * churn keys and readers look up, select and scan keys inside of their read
+ * sections. A quarter of the keys is stable and added before the threads are
+ * started, so every read must find every stable key in its place, and any
+ * other result must belong to the key it is returned for. Exits with 1 if
+ * any check failed. Run with a third argument of 1 to check a tree with cross
+ * lists.
+ *
+ * Run with make bench SAN=thread to check the tree under ThreadSanitizer. The
+ * epoch reclamation relies on fences, which ThreadSanitizer doesn't model, so
+ * it may report races between returning an object to its slab and a reader
+ * that left its read section before.
+ */
+
+#include "christree.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define STRESS_LAYERS    8
+#define STRESS_KEYS      20000
+#define STRESS_READERS   3
+#define STRESS_WRITERS   4
+#define STRESS_GETS      64
+#define STRESS_RANGE     256
+
+
+static u8 keys[STRESS_KEYS][STRESS_LAYERS];
+static u32 vals[STRESS_KEYS];
+static s32 key_num;
+
+/*
+ * Which keys are stable and how many stable keys come before every key, and
+ * whether every churn key is in the tree, as last set by its writer.
+ */
+static u8 stable[STRESS_KEYS];
+static s32 stable_sum[STRESS_KEYS + 1];
+static u8 state[STRESS_KEYS];
+
+static struct dbs_christree *tree;
+static s32 writer_num;
+static s32 stop;
+static long failed;
+
+
+static int stress_cmp(const void *a, const void *b)
+{
+	return memcmp(a, b, STRESS_LAYERS);
+}
+
+
+static void stress_fail(const char *msg)
+{
+	if(__atomic_fetch_add(&failed, 1, __ATOMIC_RELAXED) < 10)
+		fprintf(stderr, "check failed: %s\n", msg);
+}
+
+
+/*
+ * Get the index of the key a data pointer belongs to or -1 if the pointer is
+ * invalid.
+ */
+static s32 stress_idx(void *data)
+{
+	long idx = (u32 *)data - vals;
+
+	if(!data || idx < 0 || idx >= key_num)
+		return -1;
+
+	return idx;
+}
+
+
+static void stress_get(unsigned int *seed)
+{
+	void *data;
+	s32 i;
+	s32 k;
+
+	for(i = 0; i < STRESS_GETS; i++) {
+		k = rand_r(seed) % key_num;
+		data = dbs_christree_get(tree, keys[k]);
+
+		if(stable[k] && data != &vals[k])
+			stress_fail("get missed a stable key");
+		else if(data && data != &vals[k])
+			stress_fail("get returned the wrong data");
+	}
+}
+
+
+/*
+ * Select all keys with a random byte at a random offset. While a compressed
+ * node is split, its branch may be returned twice, so every stable key is
+ * only counted the first time it is seen.
+ */
+static void stress_sel(unsigned int *seed, void **data, u8 *seen)
+{
+	struct dbs_chrismask mask;
+	u8 c;
+	s32 num;
+	s32 exp = 0;
+	s32 cnt = 0;
+	s32 idx;
+	s32 i;
+
+	mask.off = rand_r(seed) % STRESS_LAYERS;
+	mask.len = 1;
+	c = keys[rand_r(seed) % key_num][mask.off];
+	mask.data = &c;
+
+	if((num = dbs_christree_sel(tree, &mask, data, key_num)) < 0) {
+		stress_fail("sel failed");
+		return;
+	}
+
+	memset(seen, 0, key_num);
+
+	for(i = 0; i < num; i++) {
+		if((idx = stress_idx(data[i])) < 0 ||
+				keys[idx][mask.off] != c) {
+			stress_fail("sel returned the wrong data");
+			return;
+		}
+
+		cnt += stable[idx] && !seen[idx];
+		seen[idx] = 1;
+	}
+
+	for(i = 0; i < key_num; i++)
+		exp += stable[i] && keys[i][mask.off] == c;
+
+	if(cnt != exp)
+		stress_fail("sel missed a stable key");
+}
+
+
+/*
+ * Scan the keys between two random keys, which has to return every stable key
+ * in between.
+ */
+static void stress_range(unsigned int *seed, void **data, u8 *buf)
+{
+	s32 lo = rand_r(seed) % key_num;
+	s32 hi = lo + 1 + rand_r(seed) % STRESS_RANGE;
+	s32 num;
+	s32 cnt = 0;
+	s32 last = lo - 1;
+	s32 idx;
+	s32 i;
+
+	if(hi > key_num)
+		hi = key_num;
+
+	num = dbs_christree_range(tree, keys[lo],
+			hi < key_num ? keys[hi] : NULL, buf, data, STRESS_RANGE);
+	if(num < 0) {
+		stress_fail("range failed");
+		return;
+	}
+
+	for(i = 0; i < num; i++) {
+		if((idx = stress_idx(data[i])) <= last || idx >= hi ||
+				memcmp(buf + i * STRESS_LAYERS, keys[idx],
+					STRESS_LAYERS)) {
+			stress_fail("range returned the wrong key");
+			return;
+		}
+
+		cnt += stable[idx];
+		last = idx;
+	}
+
+	if(cnt != stable_sum[hi] - stable_sum[lo])
+		stress_fail("range missed a stable key");
+}
+
+
+static void *stress_reader(void *arg)
+{
+	struct dbs_epoch_reader *rd;
+	unsigned int seed = (unsigned int)(long)arg;
+	void **data;
+	u8 *seen;
+	u8 *buf;
+
+	if(!(rd = dbs_christree_reader_open(tree))) {
+		stress_fail("no reader slot");
+		return NULL;
+	}
+
+	data = malloc(key_num * sizeof(void *));
+	seen = malloc(key_num);
+	buf = malloc(STRESS_RANGE * STRESS_LAYERS);
+	if(!data || !seen || !buf)
+		stress_fail("out of memory");
+
+	while(data && seen && buf && !__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+		dbs_epoch_enter(rd);
+
+		switch(rand_r(&seed) % 16) {
+			case 0:
+				stress_sel(&seed, data, seen);
+				break;
+
+			case 1:
+			case 2:
+				stress_range(&seed, data, buf);
+				break;
+
+			default:
+				stress_get(&seed);
+				break;
+		}
+
+		dbs_epoch_leave(rd);
+	}
+
+	free(data);
+	free(seen);
+	free(buf);
+	dbs_epoch_reader_close(rd);
+	return NULL;
+}
+
+
+/*
+ * Every writer owns the churn keys with its index modulo the number of
+ * writers, so the final state of every key is known.
+ */
+static void *stress_writer(void *arg)
+{
+	struct dbs_christree *wr = tree;
+	s32 w = (s32)(long)arg;
+	unsigned int seed = w * 7919 + 1;
+	s32 k;
+
+	if(w && !(wr = dbs_christree_writer_open(tree))) {
+		stress_fail("no writer handle");
+		return NULL;
+	}
+
+	while(!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+		k = rand_r(&seed) % key_num;
+		if(stable[k] || k % writer_num != w)
+			continue;
+
+		if(rand_r(&seed) % 2) {
+			if(dbs_christree_add(wr, keys[k], &vals[k]) < 0)
+				stress_fail("add failed");
+
+			state[k] = 1;
+		}
+		else {
+			dbs_christree_rmv(wr, keys[k]);
+			state[k] = 0;
+		}
+	}
+
+	if(w)
+		dbs_christree_writer_close(wr);
+
+	return NULL;
+}
+
+
+int main(int argc, char **argv)
+{
+	pthread_t th[STRESS_READERS + STRESS_WRITERS];
+	struct timespec ts;
+	s32 ms = argc > 1 ? atoi(argv[1]) : 2000;
+	u32 flags = argc > 3 && atoi(argv[3]) ? DBS_CHRISTREE_CROSS : 0;
+	void *data;
+	s32 i;
+	s32 j;
+
+	writer_num = argc > 2 ? atoi(argv[2]) : 1;
+	if(writer_num < 1 || writer_num > STRESS_WRITERS)
+		writer_num = 1;
+
+	/*
+	 * Use few distinct bytes, so the keys share long prefixes and the
+	 * writers keep splitting and merging nodes.
+	 */
+	srand(1);
+	for(i = 0; i < STRESS_KEYS; i++) {
+		for(j = 0; j < STRESS_LAYERS; j++)
+			keys[i][j] = rand() % (j < 2 ? 64 : 4);
+	}
+
+	qsort(keys, STRESS_KEYS, STRESS_LAYERS, stress_cmp);
+	for(key_num = 1, i = 1; i < STRESS_KEYS; i++) {
+		if(memcmp(keys[i], keys[key_num - 1], STRESS_LAYERS))
+			memcpy(keys[key_num++], keys[i], STRESS_LAYERS);
+	}
+
+	if(!(tree = dbs_christree_init_flags(STRESS_LAYERS, flags)))
+		return 1;
+
+	if(dbs_christree_share(tree, STRESS_READERS + writer_num) < 0)
+		return 1;
+
+	for(i = 0; i < key_num; i++) {
+		vals[i] = i;
+		stable[i] = rand() % 4 == 0;
+		stable_sum[i + 1] = stable_sum[i] + stable[i];
+
+		if(stable[i] && dbs_christree_add(tree, keys[i], &vals[i]) < 0)
+			return 1;
+	}
+
+	for(i = 0; i < writer_num; i++)
+		pthread_create(&th[i], NULL, stress_writer, (void *)(long)i);
+
+	for(i = 0; i < STRESS_READERS; i++)
+		pthread_create(&th[writer_num + i], NULL, stress_reader,
+				(void *)(long)(i + 1));
+
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000L;
+	nanosleep(&ts, NULL);
+
+	__atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+
+	for(i = 0; i < writer_num + STRESS_READERS; i++)
+		pthread_join(th[i], NULL);
+
+	/*
+	 * Once all threads are done, the tree has to hold exactly the stable
+	 * keys and the churn keys last added.
+	 */
+	for(i = 0; i < key_num; i++) {
+		data = dbs_christree_get(tree, keys[i]);
+		if((stable[i] || state[i]) != (data == &vals[i]) ||
+				(data && data != &vals[i]))
+			stress_fail("final state wrong");
+	}
+
+	printf("keys %d, writers %d, readers %d, failed %ld\n", key_num,
+			writer_num, STRESS_READERS, failed);
+
+	dbs_christree_close(tree);
+	return failed > 0;
+}
@@ -0,0 +1,591 @@
+/*
+ * Run a fixed set of workloads against the tree and print one line of CSV per
+ * measurement, so results can be compared between versions of the library.
+ *
+ * Every workload generates its keys from a seeded random generator, so the
+ * keys are the same on every run and every machine. The keys are made unique
+ * and shuffled, then each workload measures:
+ *
+ *  - add_ns: Inserting every key once, in random order
+ *  - bytes_per_key: The memory taken from the allocator, divided by the
+ *    number of keys
+ *  - get_ns: Exact lookups of existing keys, either uniformly or following
+ *    a Zipf distribution
+ *  - sel_pct, sel_query_ns, sel_key_ns: Selections with filters built to
+ *    select about 0.1%, 1% and 10% of the keys, which are the parameter.
+ *    They give the share of keys actually selected, and the time per query
+ *    and per selected key
+ *  - rmv_ns: Removing every key again, in random order
+ *  - build_ms: Filling an empty tree from the sorted keys with a bulk load
+ *
+ * The lean workloads repeat some of the others with trees created without the
+ * layer lists, and the cross workloads with trees created with cross lists.
+ *
+ * If built with the instrumentation, the latency percentiles and counters of
+ * the library are printed for every workload as well.
+ *
+ * The last column counts wrong results and the program exits with 1 if any
+ * are found. The number of keys can be given as the first argument.
+ */
+
+#include "christree.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define BENCH_MAXLEN     16
+#define BENCH_KEYS       1000000
+#define BENCH_ROUNDS     5
+#define BENCH_ZIPF       0.99
+
+
+struct bench_workload {
+	const char                   *name;
+	s32                          layers;
+	s8                           zipf;
+	u32                          flags;
+
+	void                         (*gen)(u8 *key, s32 layers, s32 i);
+};
+
+
+static u64 state;
+static s32 len;
+
+
+/*
+ * A small xorshift generator, which gives the same numbers with every libc.
+ */
+static u64 bench_rand(void)
+{
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return state * 0x2545F4914F6CDD1DUL;
+}
+
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+static int bench_cmp(const void *a, const void *b)
+{
+	return memcmp(a, b, len);
+}
+
+
+/*
+ * Uniformly random bytes in every layer.
+ */
+static void bench_gen_random(u8 *key, s32 layers, s32 i)
+{
+	s32 j;
+
+	(void)i;
+
+	for(j = 0; j < layers; j++)
+		key[j] = bench_rand();
+}
+
+
+/*
+ * The number of the key in big endian order, so the keys are dense in the
+ * last layers and share the first layers.
+ */
+static void bench_gen_seq(u8 *key, s32 layers, s32 i)
+{
+	s32 j;
+
+	for(j = layers - 1; j >= 0; j--) {
+		key[j] = i;
+		i >>= 8;
+	}
+}
+
+
+/*
+ * Addresses from 64 subnets of 10.0.0.0/10, each with room for 65536 hosts.
+ */
+static void bench_gen_ipv4(u8 *key, s32 layers, s32 i)
+{
+	u64 r = bench_rand();
+
+	(void)layers;
+	(void)i;
+
+	key[0] = 10;
+	key[1] = r % 64;
+	key[2] = r >> 8;
+	key[3] = r >> 16;
+}
+
+
+/*
+ * Addresses from 256 /48 prefixes of 2001:db8::/32, with 16 subnets each and
+ * random interface identifiers.
+ */
+static void bench_gen_ipv6(u8 *key, s32 layers, s32 i)
+{
+	u64 r = bench_rand();
+	s32 j;
+
+	(void)layers;
+	(void)i;
+
+	key[0] = 0x20;
+	key[1] = 0x01;
+	key[2] = 0x0d;
+	key[3] = 0xb8;
+	key[4] = 0x00;
+	key[5] = r;
+	key[6] = 0x00;
+	key[7] = (r >> 8) % 16;
+
+	r = bench_rand();
+	for(j = 8; j < 16; j++) {
+		key[j] = r;
+		r >>= 8;
+	}
+}
+
+
+static const struct bench_workload workloads[] = {
+	{"random",       4,  0, 0, bench_gen_random},
+	{"random",       8,  0, 0, bench_gen_random},
+	{"random",       16, 0, 0, bench_gen_random},
+	{"seq",          4,  0, 0, bench_gen_seq},
+	{"seq",          8,  0, 0, bench_gen_seq},
+	{"seq",          16, 0, 0, bench_gen_seq},
+	{"ipv4",         4,  0, 0, bench_gen_ipv4},
+	{"ipv6",         16, 0, 0, bench_gen_ipv6},
+	{"zipf",         8,  1, 0, bench_gen_random},
+	{"zipf",         16, 1, 0, bench_gen_random},
+	{"random-lean",  8,  0, DBS_CHRISTREE_LEAN, bench_gen_random},
+	{"random-lean",  16, 0, DBS_CHRISTREE_LEAN, bench_gen_random},
+	{"ipv6-lean",    16, 0, DBS_CHRISTREE_LEAN, bench_gen_ipv6},
+	{"random-cross", 8,  0, DBS_CHRISTREE_CROSS, bench_gen_random},
+	{"random-cross", 16, 0, DBS_CHRISTREE_CROSS, bench_gen_random},
+	{"ipv6-cross",   16, 0, DBS_CHRISTREE_CROSS, bench_gen_ipv6}
+};
+
+
+/*
+ * Generate the keys of a workload, sort them and drop the duplicates.
+ *
+ * Returns: The number of unique keys
+ */
+static s32 bench_keys(const struct bench_workload *w, u8 *sorted, s32 num)
+{
+	s32 i;
+	s32 j;
+
+	for(i = 0; i < num; i++)
+		w->gen(sorted + i * w->layers, w->layers, i);
+
+	len = w->layers;
+	qsort(sorted, num, len, bench_cmp);
+
+	for(i = 0, j = 0; i < num; i++) {
+		if(j > 0 && memcmp(sorted + (j - 1) * len, sorted + i * len,
+					len) == 0)
+			continue;
+
+		memmove(sorted + j * len, sorted + i * len, len);
+		j++;
+	}
+
+	return j;
+}
+
+
+/*
+ * Draw the lookups, either uniformly from all keys or following a Zipf
+ * distribution. As the keys are shuffled, the most popular keys lie
+ * anywhere in the key space.
+ */
+static void bench_draw(s8 zipf, s32 *idx, s32 num, double *cdf)
+{
+	double sum = 0;
+	double u;
+	s32 l;
+	s32 r;
+	s32 m;
+	s32 i;
+
+	if(!zipf) {
+		for(i = 0; i < num; i++)
+			idx[i] = bench_rand() % num;
+
+		return;
+	}
+
+	for(i = 0; i < num; i++) {
+		sum += 1.0 / pow(i + 1, BENCH_ZIPF);
+		cdf[i] = sum;
+	}
+
+	for(i = 0; i < num; i++) {
+		u = (bench_rand() >> 11) / 9007199254740992.0 * sum;
+
+		l = 0;
+		r = num - 1;
+		while(l < r) {
+			m = (l + r) / 2;
+
+			if(cdf[m] < u)
+				l = m + 1;
+			else
+				r = m;
+		}
+
+		idx[i] = l;
+	}
+}
+
+
+/*
+ * Get the memory the tree has taken from the allocator per key.
+ */
+static double bench_bytes(struct dbs_christree *tree)
+{
+	struct dbs_christree_stats *stats;
+	double ret;
+
+	if(!(stats = dbs_christree_stats_init(tree)))
+		return 0;
+
+	ret = stats->bytes_per_key;
+	dbs_christree_stats_close(stats);
+	return ret;
+}
+
+
+static void bench_print(const struct bench_workload *w, s32 num,
+		const char *metric, const char *param, double value, s32 bad)
+{
+	printf("%s,%d,%d,%s,%s,%.2f,%d\n", w->name, w->layers, num, metric,
+			param, value, bad);
+}
+
+
+/*
+ * A filter for a selection, with the bytes of a key from off on and a range
+ * for the byte after them.
+ */
+struct bench_cut {
+	s32                          off;
+	s32                          len;
+	s32                          lo;
+	s32                          hi;
+	s32                          exp;
+};
+
+
+/*
+ * Find the filter closest to selecting the given share of the keys. For every
+ * offset, the filter either only has a range on the byte at the offset, or
+ * the byte of the key at the offset and a range on the byte after it. The
+ * range starts with the byte of the key and is grown towards the more common
+ * neighbour, so every filter selects at least the key itself.
+ */
+static void bench_cut(u8 *sorted, s32 num, u8 *key, double pct,
+		struct bench_cut *cut)
+{
+	s32 hist[256];
+	double want = pct * num / 100;
+	double err;
+	double best = -1;
+	u8 *str;
+	s32 off;
+	s32 k;
+	s32 lo;
+	s32 hi;
+	s32 sum;
+	s32 i;
+
+	for(off = 0; off < len; off++) {
+		for(k = 0; k < 2 && off + k < len; k++) {
+			memset(hist, 0, sizeof(hist));
+			for(i = 0; i < num; i++) {
+				str = sorted + i * len;
+				if(k == 0 || str[off] == key[off])
+					hist[str[off + k]]++;
+			}
+
+			lo = hi = key[off + k];
+			sum = hist[lo];
+
+			while(1) {
+				err = fabs(log(sum / want));
+				if(best < 0 || err < best) {
+					best = err;
+					cut->off = off;
+					cut->len = k;
+					cut->lo = lo;
+					cut->hi = hi;
+					cut->exp = sum;
+				}
+
+				if(sum >= want || (lo == 0 && hi == 255))
+					break;
+
+				if(hi == 255 || (lo > 0 &&
+							hist[lo - 1] > hist[hi + 1]))
+					sum += hist[--lo];
+				else
+					sum += hist[++hi];
+			}
+		}
+	}
+}
+
+
+/*
+ * Run the selections of a workload with filters for about 0.1%, 1% and 10%
+ * of the keys, built from a random key. Every selection prints the share of
+ * keys it actually selected, and the time per query and per selected key.
+ *
+ * Returns: The number of wrong results
+ */
+static s32 bench_sel(const struct bench_workload *w, struct dbs_christree *tree,
+		u8 *sorted, s32 num, void **res)
+{
+	static const double pct[] = {0.1, 1, 10};
+	struct dbs_chrisfilter *flt;
+	struct bench_cut cut;
+	char param[16];
+	double t;
+	u8 *key;
+	s32 got = 0;
+	s32 ret = 0;
+	s32 m;
+	s32 i;
+
+	key = sorted + (bench_rand() % num) * len;
+
+	for(m = 0; m < 3; m++) {
+		bench_cut(sorted, num, key, pct[m], &cut);
+
+		if(!(flt = dbs_chrisfilter_init(cut.off + cut.len + 1)))
+			return ret + 1;
+
+		dbs_chrisfilter_set_exact(flt, cut.off, key + cut.off, cut.len);
+		dbs_chrisfilter_set_range(flt, cut.off + cut.len, cut.lo,
+				cut.hi);
+
+		t = bench_now();
+		for(i = 0; i < BENCH_ROUNDS; i++)
+			got = dbs_christree_filter(tree, flt, res, num);
+		t = (bench_now() - t) / BENCH_ROUNDS;
+
+		dbs_chrisfilter_close(flt);
+
+		sprintf(param, "%g", pct[m]);
+		bench_print(w, num, "sel_pct", param, 100.0 * cut.exp / num,
+				0);
+		bench_print(w, num, "sel_query_ns", param, t, got != cut.exp);
+		bench_print(w, num, "sel_key_ns", param, t / cut.exp, 0);
+		ret += got != cut.exp;
+	}
+
+	return ret;
+}
+
+
+#ifdef DBS_INSTR
+/*
+ * Print the latency percentiles and the visited nodes of every operation, as
+ * well as the event counters, since the last reset.
+ */
+static void bench_instr(const struct bench_workload *w, s32 num)
+{
+	static struct dbs_instr snap;
+	static const char *ops[] = {"add", "rmv", "get", "sel"};
+	static const char *cnts[] = {"visit", "alloc", "grow", "layer", "cand"};
+	static const double pct[] = {50, 99, 99.9};
+	char param[32];
+	s32 i;
+	s32 j;
+
+	dbs_instr_snapshot(&snap);
+
+	for(i = 0; i < DBS_INSTR_OPS; i++) {
+		if(snap.op[i].num == 0)
+			continue;
+
+		for(j = 0; j < 3; j++) {
+			sprintf(param, "%s_p%g", ops[i], pct[j]);
+			bench_print(w, num, "instr_ns", param,
+					dbs_instr_percentile(&snap, i, pct[j]), 0);
+		}
+
+		sprintf(param, "%s_max", ops[i]);
+		bench_print(w, num, "instr_ns", param, snap.op[i].max, 0);
+
+		bench_print(w, num, "instr_visit", ops[i],
+				(double)snap.op[i].visit / snap.op[i].num, 0);
+	}
+
+	for(i = 0; i < DBS_INSTR_CNTS; i++)
+		bench_print(w, num, "instr_cnt", cnts[i], snap.cnt[i], 0);
+
+	dbs_instr_reset();
+}
+#endif
+
+
+/*
+ * Run all measurements of a workload.
+ *
+ * Returns: The number of wrong results
+ */
+static s32 bench_run(const struct bench_workload *w, s32 max, u8 *sorted,
+		u8 *keys, s32 *idx, double *cdf, void **res)
+{
+	struct dbs_christree *tree;
+	double t;
+	s32 num;
+	s32 bad;
+	s32 ret = 0;
+	s32 i;
+	s32 j;
+	u8 tmp[BENCH_MAXLEN];
+
+	num = bench_keys(w, sorted, max);
+
+	memcpy(keys, sorted, num * len);
+	for(i = num - 1; i > 0; i--) {
+		j = bench_rand() % (i + 1);
+
+		memcpy(tmp, keys + i * len, len);
+		memcpy(keys + i * len, keys + j * len, len);
+		memcpy(keys + j * len, tmp, len);
+	}
+
+	if(!(tree = dbs_christree_init_flags(len, w->flags)))
+		return 1;
+
+	bad = 0;
+	t = bench_now();
+	for(i = 0; i < num; i++) {
+		if(dbs_christree_add(tree, keys + i * len, keys + i * len) < 0)
+			bad++;
+	}
+	t = bench_now() - t;
+
+	bench_print(w, num, "add_ns", "", t / num, bad);
+	bench_print(w, num, "bytes_per_key", "add", bench_bytes(tree), 0);
+	ret += bad;
+
+	bench_draw(w->zipf, idx, num, cdf);
+
+	t = bench_now();
+	for(i = 0; i < num; i++)
+		res[i] = dbs_christree_get(tree, keys + idx[i] * len);
+	t = bench_now() - t;
+
+	bad = 0;
+	for(i = 0; i < num; i++) {
+		if(res[i] != keys + idx[i] * len)
+			bad++;
+	}
+
+	bench_print(w, num, "get_ns", w->zipf ? "zipf" : "uniform", t / num,
+			bad);
+	ret += bad;
+
+	ret += bench_sel(w, tree, sorted, num, res);
+
+	t = bench_now();
+	for(i = 0; i < num; i++)
+		dbs_christree_rmv(tree, keys + i * len);
+	t = bench_now() - t;
+
+	bad = 0;
+	for(i = 0; i < num; i++) {
+		if(dbs_christree_get(tree, keys + i * len))
+			bad++;
+	}
+
+	bench_print(w, num, "rmv_ns", "", t / num, bad);
+	ret += bad;
+
+	dbs_christree_close(tree);
+
+#ifdef DBS_INSTR
+	bench_instr(w, num);
+#endif
+
+	/*
+	 * Build a second tree from the sorted keys.
+	 */
+	if(!(tree = dbs_christree_init_flags(len, w->flags)))
+		return 1;
+
+	for(i = 0; i < num; i++)
+		res[i] = sorted + i * len;
+
+	t = bench_now();
+	bad = dbs_christree_load_array(tree, sorted, res, num) < 0;
+	t = bench_now() - t;
+
+	for(i = 0; i < num; i++) {
+		if(dbs_christree_get(tree, sorted + i * len) != sorted + i * len)
+			bad++;
+	}
+
+	bench_print(w, num, "build_ms", "load", t / 1e6, bad);
+	bench_print(w, num, "bytes_per_key", "load", bench_bytes(tree), 0);
+	ret += bad;
+
+	dbs_christree_close(tree);
+	return ret;
+}
+
+
+int main(int argc, char **argv)
+{
+	s32 max = argc > 1 ? atoi(argv[1]) : BENCH_KEYS;
+	double *cdf;
+	void **res;
+	u8 *sorted;
+	u8 *keys;
+	s32 *idx;
+	s32 ret = 0;
+	s32 i;
+
+	if(max < 1)
+		max = BENCH_KEYS;
+
+	sorted = malloc((size_t)max * BENCH_MAXLEN);
+	keys = malloc((size_t)max * BENCH_MAXLEN);
+	idx = malloc(max * sizeof(s32));
+	cdf = malloc(max * sizeof(double));
+	res = malloc(max * sizeof(void *));
+
+	if(!sorted || !keys || !idx || !cdf || !res)
+		return 1;
+
+	printf("workload,layers,keys,metric,param,value,bad\n");
+	for(i = 0; i < (s32)(sizeof(workloads) / sizeof(workloads[0])); i++) {
+		state = 0x9E3779B97F4A7C15UL + i;
+		ret += bench_run(&workloads[i], max, sorted, keys, idx, cdf, res);
+	}
+
+	free(sorted);
+	free(keys);
+	free(idx);
+	free(cdf);
+	free(res);
+	return ret ? 1 : 0;
+}
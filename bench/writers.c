@@ -0,0 +1,166 @@
+/*
+ * Compare the throughput of threads inserting disjoint keys into a shared
+ * tree, when every call is serialized by a global mutex against writers using
+ * handles of their own. Afterwards every thread removes half of its keys
+ * again while the others are still inserting, and the tree is checked.
+ */
+
+#include "christree.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define BENCH_LAYERS     16
+#define BENCH_KEYS       1000000
+#define BENCH_WRITERS    32
+
+
+static u8 keys[BENCH_KEYS][BENCH_LAYERS];
+
+static struct dbs_christree *tree;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static s32 use_lock;
+static s32 writers;
+
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/*
+ * Insert every key belonging to the thread, then remove every second one.
+ */
+static void *bench_writer(void *arg)
+{
+	struct dbs_christree *wr = tree;
+	s32 id = (s32)(long)arg;
+	s32 i;
+
+	if(!use_lock && id > 0 && !(wr = dbs_christree_writer_open(tree)))
+		return NULL;
+
+	for(i = id; i < BENCH_KEYS; i += writers) {
+		if(use_lock)
+			pthread_mutex_lock(&lock);
+
+		dbs_christree_add(wr, keys[i], keys[i]);
+
+		if(use_lock)
+			pthread_mutex_unlock(&lock);
+	}
+
+	for(i = id; i < BENCH_KEYS; i += 2 * writers) {
+		if(use_lock)
+			pthread_mutex_lock(&lock);
+
+		dbs_christree_rmv(wr, keys[i]);
+
+		if(use_lock)
+			pthread_mutex_unlock(&lock);
+	}
+
+	if(wr != tree)
+		dbs_christree_writer_close(wr);
+
+	return NULL;
+}
+
+
+/*
+ * Check that exactly the keys which haven't been removed are in the tree.
+ *
+ * Returns: The number of wrong keys
+ */
+static s32 bench_check(void)
+{
+	s32 bad = 0;
+	void *data;
+	s32 i;
+
+	for(i = 0; i < BENCH_KEYS; i++) {
+		data = dbs_christree_get(tree, keys[i]);
+
+		if((i / writers) % 2 == 0) {
+			if(data)
+				bad++;
+		}
+		else if(data != keys[i]) {
+			bad++;
+		}
+	}
+
+	return bad;
+}
+
+
+static double bench_run(s32 num, s32 *bad)
+{
+	pthread_t th[BENCH_WRITERS];
+	double t;
+	s32 i;
+
+	if(!(tree = dbs_christree_init(BENCH_LAYERS)))
+		exit(1);
+
+	if(dbs_christree_share(tree, BENCH_WRITERS) < 0)
+		exit(1);
+
+	writers = num;
+	t = bench_now();
+
+	for(i = 0; i < num; i++)
+		pthread_create(&th[i], NULL, bench_writer, (void *)(long)i);
+
+	for(i = 0; i < num; i++)
+		pthread_join(th[i], NULL);
+
+	t = bench_now() - t;
+
+	*bad = bench_check();
+
+	dbs_christree_close(tree);
+	return (BENCH_KEYS + BENCH_KEYS / 2) / (t / 1e3);
+}
+
+
+int main(int argc, char **argv)
+{
+	s32 max = argc > 1 ? atoi(argv[1]) : 8;
+	s32 ret = 0;
+	s32 bad;
+	s32 i;
+	s32 j;
+
+	if(max < 1 || max > BENCH_WRITERS)
+		max = BENCH_WRITERS;
+
+	srand(1);
+	for(i = 0; i < BENCH_KEYS; i++) {
+		for(j = 0; j < BENCH_LAYERS; j++)
+			keys[i][j] = j < 4 ? rand() % 16 : rand() % 256;
+	}
+
+	printf("variant,writers,mops,bad\n");
+	for(i = 1; i <= max; i *= 2) {
+		use_lock = 1;
+		printf("mutex,%d,%.2f,", i, bench_run(i, &bad));
+		printf("%d\n", bad);
+		ret |= bad;
+
+		use_lock = 0;
+		printf("olc,%d,%.2f,", i, bench_run(i, &bad));
+		printf("%d\n", bad);
+		ret |= bad;
+	}
+
+	return ret ? 1 : 0;
+}
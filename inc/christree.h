@@ -3,30 +3,166 @@
 
 #include "define.h"
 #include "imports.h"
+#include "slab.h"
+#include "epoch.h"
+#include "pool.h"
+#include "hashmap.h"
+#include "instr.h"
 
 /*
  * 
  */
 #define DBS_CHRISTREE_PREV_MIN  5
-#define DBS_CHRISTREE_NEXT_MIN  5
 
 
+/*
+ * The maximum number of bytes a node can hold in addition to the dif
+ * character. Longer chains of nodes with only a single child are split into
+ * multiple compressed nodes.
+ */
+#define DBS_CHRISTREE_PREF_MAX  14
+
+
+/*
+ * The number of stack entries dbs_christree_sel() keeps on the call stack. If
+ * the tree has more layers, the stack is allocated.
+ */
+#define DBS_CHRISTREE_STK_LEN   64
+
+
+/*
+ * The number of strings the batch functions walk down the tree together. The
+ * walks of a batch are interleaved, so while one walk waits for memory the
+ * others can go on.
+ */
+#define DBS_CHRISTREE_BATCH     16
+
+
+/*
+ * The steps of a single walk in a batch. Every step prefetches the memory the
+ * next step will use: a node, then its v_next list, then the slot for the
+ * dif character in the list.
+ */
+#define DBS_CHRISTREE_WALK_NODE 0
+#define DBS_CHRISTREE_WALK_LIST 1
+#define DBS_CHRISTREE_WALK_FIND 2
+#define DBS_CHRISTREE_WALK_DONE 3
+
+
+/*
+ * The different kinds of v_next lists. A node starts without a v_next list
+ * and is moved to the next bigger kind once the current one is full. If
+ * enough children are removed, the list is shrunk again.
+ */
+#define DBS_CHRISTREE_N0        0
+#define DBS_CHRISTREE_N4        1
+#define DBS_CHRISTREE_N16       2
+#define DBS_CHRISTREE_N48       3
+#define DBS_CHRISTREE_N256      4
+
+
+/*
+ * The bits of the version of a node. A writer holds the lock while changing
+ * the node, and a node removed from the tree is marked obsolete. Every unlock
+ * advances the version, so a writer can tell if a node has been changed since
+ * it read the version.
+ */
+#define DBS_CHRISTREE_LOCKED    1
+#define DBS_CHRISTREE_OBSOLETE  2
+#define DBS_CHRISTREE_VERS_INC  4
+
+
+/*
+ * The options of a tree. A lean tree keeps no layer lists, so its nodes are
+ * allocated without the cross pointers and inserting or removing a node
+ * never touches the layers. Selections starting below the first layer then
+ * walk the tree from the root instead. In tombstone mode, removing a string
+ * only clears its data pointer and leaves the nodes in place, until they
+ * are removed by dbs_christree_compact().
+ *
+ * With cross lists, a compressed node also gets an entry in a list for every
+ * layer its prefix covers, so selections starting on such a layer don't have
+ * to walk the tree from the root. The entries cost memory and time on every
+ * insert, so without them a selection only starts in the layer lists, until
+ * a compressed node covers the layer for the first time. A lean tree can't
+ * have cross lists.
+ */
+#define DBS_CHRISTREE_LEAN      1
+#define DBS_CHRISTREE_TOMB      2
+#define DBS_CHRISTREE_CROSS     4
+
+
+struct dbs_christree_node;
+struct dbs_christree_cross;
+
+/*
+ * Small v_next list, with the dif characters stored sorted next to the
+ * pointers, so searching them doesn't touch the children. The number of
+ * children is kept in the list as well, so a reader always gets the number
+ * matching the keys it searches.
+ *
+ * Every kind of list starts with its type and a flag, which is set if the
+ * list holds data pointers instead of nodes, so both can be read through
+ * any kind.
+ */
+struct dbs_christree_n4 {
+	u8                           type;
+	u8                           vals;
+	u8                           num;
+	u8                           key[4];
+	struct dbs_christree_node    *ptr[4];
+};
+
+struct dbs_christree_n16 {
+	u8                           type;
+	u8                           vals;
+	u8                           num;
+	u8                           key[16];
+	struct dbs_christree_node    *ptr[16];
+};
+
+/*
+ * Indexed v_next list. The index contains the slot number plus one for every
+ * dif character, or 0 if there's no child with that character.
+ */
+struct dbs_christree_n48 {
+	u8                           type;
+	u8                           vals;
+	u8                           idx[256];
+	struct dbs_christree_node    *ptr[48];
+};
+
+/*
+ * Direct v_next list, with one slot for every possible dif character.
+ */
+struct dbs_christree_n256 {
+	u8                           type;
+	u8                           vals;
+	struct dbs_christree_node    *ptr[256];
+};
+
+union dbs_christree_next {
+	u8                           type;
+	struct dbs_christree_n4      n4;
+	struct dbs_christree_n16     n16;
+	struct dbs_christree_n48     n48;
+	struct dbs_christree_n256    n256;
+};
+
 
 struct dbs_christree_node {
 	/*
-	 * A pointer to both the nodes above and the nodes below. 
+	 * A pointer to both the nodes above and the nodes below. The v_next
+	 * list is NULL as long as the node doesn't have any children, and
+	 * v_next_alloc is the number of slots of the current list kind. There
+	 * are no nodes on the last layer, so a node ending right above it
+	 * keeps the data pointers of the keys themselves in its v_next list.
 	 */
 	struct dbs_christree_node    *v_prev;
 
-	struct dbs_christree_node    **v_next;
+	union dbs_christree_next     *v_next;
 	s32                          v_next_used;
 	s32                          v_next_alloc;
-	
-	/*
-	 * The cross pointers for the layer.
-	 */
-	struct dbs_christree_node    *h_v_prev;
-	struct dbs_christree_node    *h_v_next;
 
 	/*
 	 * The layernumber the node is on. 
@@ -34,29 +170,94 @@ struct dbs_christree_node {
 	s32                          layer;
 
 	/*
-	 * The unique layer identifier.
+	 * The differenciating byte.
 	 */
-	s32                          layer_id;
+	u8                           dif;
 
 	/*
-	 * The differenciating byte.
+	 * If a chain of nodes with only a single child has been compressed,
+	 * these are the bytes following the dif character. The node then
+	 * covers the layers from layer to layer + pref_len and the children
+	 * start on the layer after that.
 	 */
-	u8                           dif;
+	u8                           pref_len;
+	u8                           pref[DBS_CHRISTREE_PREF_MAX];
+
+	/*
+	 * The version of the node, which is only used while the tree is
+	 * shared.
+	 */
+	u32                          vers;
 
 	/*
 	 * The data pointer.
 	 */
 	void                         *data;
+
+	/*
+	 * The cross pointers for the list of nodes with the same dif character
+	 * in the layer, and the entries of a compressed node in the cross
+	 * lists of the layers covered by its prefix. They have to stay last,
+	 * as the nodes of a lean tree are allocated without them, and the
+	 * nodes of a tree without cross lists without the entries.
+	 */
+	struct dbs_christree_node    *h_v_prev;
+	struct dbs_christree_node    *h_v_next;
+	struct dbs_christree_cross   *cross;
+};
+
+
+/*
+ * An entry of a compressed node in the cross list of a layer covered by its
+ * prefix. The entries of a node are chained from the first covered layer
+ * down, and when a node is split, they are handed over to the new nodes
+ * without leaving their place in the lists.
+ */
+struct dbs_christree_cross {
+	struct dbs_christree_node    *node;
+
+	struct dbs_christree_cross   *h_v_prev;
+	struct dbs_christree_cross   *h_v_next;
+
+	/*
+	 * The entry of the same node for the layer below.
+	 */
+	struct dbs_christree_cross   *link;
 };
 
 
 struct dbs_christree_layer {
 	s32                          layer_num;
 
-	struct dbs_christree_node    *node;
-	s32                          node_num;
+	/*
+	 * The nodes on the layer, with a separate list for every dif
+	 * character.
+	 */
+	struct dbs_christree_node    *node[256];
+
+	/*
+	 * The compressed nodes from the layers above, which cover this layer
+	 * with their prefix, with a separate list for every byte they have on
+	 * the layer. The last layer has no cross lists, as no selection
+	 * starts there.
+	 */
+	struct dbs_christree_cross   *cross[256];
 
-	s32                          count;
+	/*
+	 * Set once the first compressed node from the layers above covers this
+	 * layer with its prefix, and never cleared again.
+	 */
+	s32                          covered;
+
+	/*
+	 * While the tree is shared, both lists for a character are guarded by
+	 * a lock of their own, so writers only contend for a list if they
+	 * change nodes with the same character on the same layer. The locks
+	 * are kept apart from the list heads, so taking a lock doesn't evict
+	 * the heads from the caches of the readers.
+	 */
+	u8                           pad[DBS_EPOCH_LINE];
+	u8                           lock[256];
 };
 
 
@@ -67,10 +268,62 @@ struct dbs_christree {
 	struct dbs_christree_node    *root;
 
 	/*
-	 * Each layer is a cross linked like a linked list. 
+	 * Each layer is a cross linked like a linked list. The table has room
+	 * for the maximum number of layers, but a layer is only allocated once
+	 * a string reaches it, so layers are always used from the top down and
+	 * layer_used is the number of allocated layers. While the tree is
+	 * shared, layer_lock guards allocating new layers.
 	 */
-	struct dbs_christree_layer   *layer;
+	struct dbs_christree_layer   **layer;
 	s32                          layer_num;
+	s32                          layer_used;
+	u8                           layer_lock;
+
+	/*
+	 * The options the tree has been created with.
+	 */
+	u32                          flags;
+
+	/*
+	 * All nodes, v_next lists and cross list entries are taken from these
+	 * slabs, one for the nodes, one for each kind of v_next list and one
+	 * for the entries. Removed nodes are kept for reuse and everything is
+	 * released at once, when closing the tree.
+	 */
+	struct dbs_slab              node_slab;
+	struct dbs_slab              next_slab[4];
+	struct dbs_slab              cross_slab;
+
+	/*
+	 * If the tree is shared with concurrent readers and writers, removed
+	 * nodes and v_next lists are only returned to the slabs, once no
+	 * reader can reach them anymore. Otherwise this is NULL.
+	 */
+	struct dbs_epoch             *epoch;
+
+	/*
+	 * The objects retired by this writer and the reader slot it holds
+	 * while changing the tree.
+	 */
+	struct dbs_epoch_writer      ew;
+
+	/*
+	 * Every additional writer of a shared tree uses a handle, which is a
+	 * copy of the tree struct with slabs of its own, so writers never
+	 * contend for memory. The handles are kept in a list on the tree they
+	 * have been opened for and are only released together with it. For
+	 * the tree itself, main is NULL.
+	 */
+	struct dbs_christree         *main;
+	struct dbs_christree         *handle;
+	s32                          used;
+
+	/*
+	 * If the tree is indexed, every string in the tree is also kept in a
+	 * hash map together with its data pointer, which answers exact
+	 * lookups without walking down the tree. Otherwise this is NULL.
+	 */
+	struct dbs_hashmap           *index;
 };
 
 
@@ -82,9 +335,36 @@ struct dbs_chrismask {
 
 
 /*
- * Create and initialize a new christree struct.
+ * The condition for a single byte of a filter. A byte matches, if it lies in
+ * the range from lo to hi and the bits set in msk have the values in val.
+ * A condition with the range 0x00 to 0xff and no bits set in msk matches
+ * every byte.
+ */
+struct dbs_chrisbyte {
+	u8                           lo;
+	u8                           hi;
+	u8                           msk;
+	u8                           val;
+};
+
+
+/*
+ * A filter with one condition for each of the first len layers. All layers
+ * after that match every byte. Strings shorter than the filter never match.
+ */
+struct dbs_chrisfilter {
+	s32                          len;
+	struct dbs_chrisbyte         *byte;
+};
+
+
+/*
+ * Create and initialize a new christree struct. Strings can have any length up
+ * to the number of layers, and the layers are only allocated once a string
+ * reaches them. The functions without an explicit length take strings with
+ * one byte for each layer.
  *
- * @lim: The number of layers in the tree
+ * @lim: The maximum number of layers in the tree
  *
  * Returns: Either a pointer to the newly created tree struct or NULL if an
  *          error occurred
@@ -92,6 +372,20 @@ struct dbs_chrismask {
 DBS_API struct dbs_christree *dbs_christree_init(s32 lim);
 
 
+/*
+ * Create and initialize a new christree struct with the given options. This
+ * works like dbs_christree_init(), but fails if the options can't be
+ * combined.
+ *
+ * @lim: The maximum number of layers in the tree
+ * @flags: The options, like DBS_CHRISTREE_LEAN
+ *
+ * Returns: Either a pointer to the newly created tree struct or NULL if an
+ *          error occurred
+ */
+DBS_API struct dbs_christree *dbs_christree_init_flags(s32 lim, u32 flags);
+
+
 /*
  * Cleanup and destroy a christree.
  *
@@ -100,8 +394,100 @@ DBS_API struct dbs_christree *dbs_christree_init(s32 lim);
 DBS_API void dbs_christree_close(struct dbs_christree *tree);
 
 
+/*
+ * Share a tree between writers and concurrent readers. Afterwards the writers
+ * may add and remove strings, while the readers look up strings and select,
+ * filter or scan ranges without any locks. Readers are opened with
+ * dbs_christree_reader_open(), and every access of a reader has to be inside
+ * a read section between dbs_epoch_enter() and dbs_epoch_leave(). Cursors
+ * and scans may only be used inside the read section they were opened in.
+ * The tree itself is used by one writer, and every additional writer thread
+ * opens a handle with dbs_christree_writer_open(). Freezing, saving and
+ * loading the tree may only be done while there's a single writer.
+ *
+ * Nodes and v_next lists are never changed in a way that could confuse a
+ * reader: new ones are published with a single store, and removed ones are
+ * kept until no reader can reach them anymore. While a compressed node is
+ * split, a concurrent selection may return the data pointers of its branch
+ * twice. Compressed nodes are not merged again while the tree is shared.
+ *
+ * Writers lock single nodes and only while changing them. They walk down
+ * without any locks, and only lock the node they change if it hasn't been
+ * changed since they read it. Otherwise they try again.
+ *
+ * @tree: Pointer to the tree struct
+ * @reader_num: The maximum number of readers and additional writers
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+DBS_API s8 dbs_christree_share(struct dbs_christree *tree, s32 reader_num);
+
+
+/*
+ * Add a hash index to the tree, which holds every string in the tree and is
+ * kept up to date when adding and removing strings. Exact lookups are then
+ * answered by the index, while all other searches still walk the tree. The
+ * index is only supported for trees with a single writer, so a tree can't be
+ * both indexed and shared.
+ *
+ * @tree: Pointer to the tree struct
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+DBS_API s8 dbs_christree_index(struct dbs_christree *tree);
+
+
+/*
+ * Remove the hash index of a tree again.
+ *
+ * @tree: Pointer to the tree struct
+ */
+DBS_API void dbs_christree_unindex(struct dbs_christree *tree);
+
+
+/*
+ * Open a handle for an additional writer of a shared tree. This is safe to
+ * call from any thread. The handle is passed to dbs_christree_add() and
+ * dbs_christree_rmv() in place of the tree, and may only be used by one
+ * thread at a time. Lookups through the handle have to be done inside a read
+ * section of a reader, like on any other thread.
+ *
+ * @tree: Pointer to the tree struct
+ *
+ * Returns: Either a pointer to the handle or NULL if all readers are taken or
+ *          an error occurred
+ */
+DBS_API struct dbs_christree *dbs_christree_writer_open(
+		struct dbs_christree *tree);
+
+
+/*
+ * Close a writer handle. The handle is kept for the next writer, and its
+ * memory is released together with the tree.
+ *
+ * @wr: Pointer to the writer handle
+ */
+DBS_API void dbs_christree_writer_close(struct dbs_christree *wr);
+
+
+/*
+ * Open a new reader for a shared tree. This is safe to call from any thread.
+ * The reader is closed with dbs_epoch_reader_close().
+ *
+ * @tree: Pointer to the tree struct
+ *
+ * Returns: Either a pointer to the reader or NULL if all readers are taken or
+ *          an error occurred
+ */
+DBS_API struct dbs_epoch_reader *dbs_christree_reader_open(
+		struct dbs_christree *tree);
+
+
 /*
  * Search for a node with the specified dif character in the layer list.
+ * Compressed nodes are only listed in the layer of their dif character. A
+ * lean tree has no layer lists, so the tree is walked down to the layer
+ * instead. The last layer has no nodes, so nothing is found there.
  *
  * @tree: Pointer to the tree struct
  * @layer: The number of the layer to search in
@@ -116,24 +502,30 @@ DBS_API s32 dbs_christree_get_layer(struct dbs_christree *tree,
 
 
 /*
- * Create a new christree node, by allocating the necessary memory and setting
- * the base attributes. This function will not add the node to the tree.
+ * Create a new christree node, by taking the necessary memory from the slab
+ * of the tree and setting the base attributes. This function will not add the
+ * node to the tree.
  *
+ * @tree: Pointer to the tree struct
  * @layer: The number of the layer the node is on
  * @dif: The dif character for the node
  *
  * Returns: A pointer to the newly created node or NULL if an error occurred
  */
-DBS_API struct dbs_christree_node *dbs_christree_new(s32 layer, u8 dif);
+DBS_API struct dbs_christree_node *dbs_christree_new(struct dbs_christree *tree,
+		s32 layer, u8 dif);
 
 
 /*
- * Delete a node and free the allocated memory. This function will not unlink
- * the node from the tree.
+ * Delete a node and return the memory to the slab of the tree. This function
+ * will not unlink the node from the tree. If the tree is shared, the memory
+ * is only returned once no reader can reach the node anymore.
  *
+ * @tree: Pointer to the tree struct
  * @node: Pointer to the node to delete
  */
-DBS_API void dbs_christree_del(struct dbs_christree_node *node);
+DBS_API void dbs_christree_del(struct dbs_christree *tree,
+		struct dbs_christree_node *node);
 
 
 /*
@@ -157,30 +549,36 @@ DBS_API void dbs_christree_rmv_v_prev(struct dbs_christree_node *node);
 
 
 /*
- * Add an entry to the v_next list of a node.
+ * Add an entry to the v_next list of a node. This fails if the node ends
+ * right above the last layer, as its v_next list holds data pointers.
  *
+ * @tree: Pointer to the tree struct
  * @node: Pointer to the node with the v_next list
  * @v_next: Pointer to the node entry to add to the v_next list
  *
  * Returns: 0 on success or -1 if an error occurred
  */
-DBS_API s8 dbs_christree_add_v_next(struct dbs_christree_node *node,
-		struct dbs_christree_node *v_next);
+DBS_API s8 dbs_christree_add_v_next(struct dbs_christree *tree,
+		struct dbs_christree_node *node, struct dbs_christree_node *v_next);
 
 
 /*
- * Remove an entry from the v_next list of a node.
+ * Remove an entry from the v_next list of a node. Nothing is removed if the
+ * node ends right above the last layer.
  *
+ * @tree: Pointer to the tree struct
  * @node: Pointer to the node with the v_next list
  * @v_next: Pointer to the node entry to remove from the v_next list
  */
-DBS_API void dbs_christree_rmv_v_next(struct dbs_christree_node *node,
-		struct dbs_christree_node *v_next);
+DBS_API void dbs_christree_rmv_v_next(struct dbs_christree *tree,
+		struct dbs_christree_node *node, struct dbs_christree_node *v_next);
 
 
 /*
  * Go through the v_next list of the given node and search for a node with the
- * specified diff character.
+ * specified diff character. If the node ends right above the last layer, its
+ * v_next list holds data pointers, which can only be read with
+ * dbs_christree_get_val(), and NULL is returned.
  *
  * @n: Pointer to the node to start the v_next list
  * @dif: The dif character the node must have
@@ -193,7 +591,73 @@ DBS_API struct dbs_christree_node *dbs_christree_get_v_next(struct dbs_christree
 
 
 /*
- * Link a node in a layer list.
+ * Get the child with the smallest dif character, which is equal to or bigger
+ * than the given one. This can be used to walk through the v_next list of a
+ * node in ascending order. Like with dbs_christree_get_v_next(), NULL is
+ * returned if the node ends right above the last layer.
+ *
+ * @n: Pointer to the node to start the v_next list
+ * @dif: The smallest dif character the node may have, between 0 and 256
+ *
+ * Returns: Either a pointer to the node if found or NULL if no node was found
+ *          or an error occurred
+ */
+DBS_API struct dbs_christree_node *dbs_christree_ceil_v_next(struct dbs_christree_node *n,
+		s32 dif);
+
+
+/*
+ * Check if the v_next list of a node holds data pointers instead of nodes,
+ * which is the case if the node ends right above the last layer.
+ *
+ * @tree: Pointer to the tree struct
+ * @n: Pointer to the node
+ *
+ * Returns: 1 if the list holds data pointers, 0 if not or -1 if an error
+ *          occurred
+ */
+DBS_API s8 dbs_christree_has_vals(struct dbs_christree *tree,
+		struct dbs_christree_node *n);
+
+
+/*
+ * Get a data pointer from the v_next list of a node, which ends right above
+ * the last layer. The last byte of the key is used in place of the dif
+ * character.
+ *
+ * @tree: Pointer to the tree struct
+ * @n: Pointer to the node
+ * @dif: The last byte of the key
+ *
+ * Returns: Either the data pointer or NULL if there's none or the list of the
+ *          node doesn't hold data pointers
+ */
+DBS_API void *dbs_christree_get_val(struct dbs_christree *tree,
+		struct dbs_christree_node *n, u8 dif);
+
+
+/*
+ * Get the data pointer with the smallest last byte, which is equal to or
+ * bigger than the given one, from the v_next list of a node ending right
+ * above the last layer. The byte is written back, so this can be used to walk
+ * through the data pointers in ascending order.
+ *
+ * @tree: Pointer to the tree struct
+ * @n: Pointer to the node
+ * @dif: The smallest byte, between 0 and 256, and the byte found
+ *
+ * Returns: Either the data pointer or NULL if there's none or the list of the
+ *          node doesn't hold data pointers
+ */
+DBS_API void *dbs_christree_ceil_val(struct dbs_christree *tree,
+		struct dbs_christree_node *n, s32 *dif);
+
+
+/*
+ * Link a node in a layer list. This will put the node in front of the list for
+ * its dif character, and if the tree has cross lists, a compressed node in
+ * front of the cross lists for the bytes of its prefix on the layers it
+ * covers.
  *
  * @tree: Pointer to the tree struct
  * @node: Pointer to the node to crosslink in the layer
@@ -205,10 +669,10 @@ DBS_API s8 dbs_christree_link_hori(struct dbs_christree *tree,
 
 
 /*
- * Unlink a node from a layer list. 
+ * Unlink a node from a layer list and from the cross lists.
  *
  * @tree: Pointer to the tree struct
- * @id: The layer id of the node
+ * @node: Pointer to the node to unlink
  */
 DBS_API void dbs_christree_unlink_hori(struct dbs_christree *tree,
 		struct dbs_christree_node *node);
@@ -217,25 +681,27 @@ DBS_API void dbs_christree_unlink_hori(struct dbs_christree *tree,
 /*
  * Link two nodes vertically.
  *
+ * @tree: Pointer to the tree struct
  * @n: Pointer to the node to link to the v_previous one
  * @v_prev: Pointer to the v_previous node
  *
  * Returns: 0 on success or -1 if an error occurred
  */
-DBS_API s8 dbs_christree_link_verti(struct dbs_christree_node *n,
-		struct dbs_christree_node *v_prev);
+DBS_API s8 dbs_christree_link_verti(struct dbs_christree *tree,
+		struct dbs_christree_node *n, struct dbs_christree_node *v_prev);
 
 
 /*
  * Unlink two nodes vertically.
  *
+ * @tree: Pointer to the tree struct
  * @n: Pointer to the node to unlink from the v_previous one
  * @v_prev: Pointer to the v_previous node
  *
  * Returns: 0 on success or -1 if an error occurred
  */
-DBS_API s8 dbs_christree_unlink_verti(struct dbs_christree_node *n,
-		struct dbs_christree_node *v_prev);
+DBS_API s8 dbs_christree_unlink_verti(struct dbs_christree *tree,
+		struct dbs_christree_node *n, struct dbs_christree_node *v_prev);
 
 /*
  * This function will link a new node into the tree and the layer lists.
@@ -270,7 +736,7 @@ DBS_API void dbs_christree_unlink_node(struct dbs_christree *tree,
 /*
  * Add a new entry to the tree.
  *
- * @tree: Pointer to the tree struct
+ * @tree: Pointer to the tree struct or a writer handle
  * @str: The string to insert into the tree
  * @data: The data pointer to link to the string
  *
@@ -283,38 +749,738 @@ DBS_API s8 dbs_christree_add(struct dbs_christree *tree,
 /*
  * Remove an entry from the tree.
  *
- * @tree: Pointer to the tree struct
+ * @tree: Pointer to the tree struct or a writer handle
  * @str: The string to remove from the tree
  */
 DBS_API void dbs_christree_rmv(struct dbs_christree *tree,
 		u8 *str);
 
 
-struct dbs_christree_sel_pass {
-	s32                    c;
-	s32                    lim;
-	void                   **data;
-};
+/*
+ * Get the data pointer linked to a string. This will only walk down the tree
+ * once and doesn't allocate any memory.
+ *
+ * @tree: Pointer to the tree struct
+ * @str: The string to look up, containing one byte for each layer
+ *
+ * Returns: The data pointer linked to the string or NULL if the string is not
+ *          in the tree or an error occurred
+ */
+DBS_API void *dbs_christree_get(struct dbs_christree *tree, u8 *str);
+
+
+/*
+ * Check if a string is in the tree.
+ *
+ * @tree: Pointer to the tree struct
+ * @str: The string to look for, containing one byte for each layer
+ *
+ * Returns: 1 if the string is in the tree, 0 if not or -1 if an error occurred
+ */
+DBS_API s8 dbs_christree_contains(struct dbs_christree *tree, u8 *str);
+
+
+/*
+ * Add a new entry with a string of the given length to the tree. A string
+ * can be the beginning of other strings in the tree, in which case its data
+ * pointer is linked to a node inside the branch of the longer strings.
+ *
+ * @tree: Pointer to the tree struct or a writer handle
+ * @str: The string to insert into the tree
+ * @len: The length of the string, between 1 and the number of layers
+ * @data: The data pointer to link to the string
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+DBS_API s8 dbs_christree_add_n(struct dbs_christree *tree,
+		u8 *str, s32 len, void *data);
+
+
+/*
+ * Remove an entry with a string of the given length from the tree. Longer
+ * strings starting with the string stay in the tree.
+ *
+ * @tree: Pointer to the tree struct or a writer handle
+ * @str: The string to remove from the tree
+ * @len: The length of the string, between 1 and the number of layers
+ */
+DBS_API void dbs_christree_rmv_n(struct dbs_christree *tree,
+		u8 *str, s32 len);
 
 
-DBS_API void dbs_christree_sel_hlf(struct dbs_christree_node *nc, void *d);
+/*
+ * Remove all nodes left without data pointers and without children, and
+ * compress the remaining nodes again where possible. The tree is walked once,
+ * and the v_next list of every node losing children is rebuilt only once.
+ * A shared tree can be compacted while it's in use, but nodes are only
+ * merged while the tree isn't shared.
+ *
+ * @tree: Pointer to the tree struct or a writer handle
+ *
+ * Returns: The number of removed nodes or -1 if an error occurred
+ */
+DBS_API s32 dbs_christree_compact(struct dbs_christree *tree);
 
 
 /*
- * Get data pointers from the tree by filtering using the given mask.
+ * Get the data pointer linked to a string of the given length.
  *
  * @tree: Pointer to the tree struct
- * @mask: Pointer to the mask to use
- * @data: An array of pointers to write the resulting data pointers to
- * @lim: The limit of how many data pointers can be written to the array
+ * @str: The string to look up
+ * @len: The length of the string, between 1 and the number of layers
  *
- * Returns: The number of selected pointers or -1 if an error occurred
+ * Returns: The data pointer linked to the string or NULL if the string is not
+ *          in the tree or an error occurred
  */
-DBS_API s32 dbs_christree_sel(struct dbs_christree *tree,
-		struct dbs_chrismask *mask, void **data, s32 lim);
+DBS_API void *dbs_christree_get_n(struct dbs_christree *tree,
+		u8 *str, s32 len);
+
+
+/*
+ * Check if a string of the given length is in the tree.
+ *
+ * @tree: Pointer to the tree struct
+ * @str: The string to look for
+ * @len: The length of the string, between 1 and the number of layers
+ *
+ * Returns: 1 if the string is in the tree, 0 if not or -1 if an error occurred
+ */
+DBS_API s8 dbs_christree_contains_n(struct dbs_christree *tree,
+		u8 *str, s32 len);
+
+
+/*
+ * Add a batch of new entries to the tree. The strings are first walked down
+ * the tree together, which brings the nodes to change into the cache, and
+ * are then inserted one after another.
+ *
+ * @tree: Pointer to the tree struct or a writer handle
+ * @str: An array of the strings to insert into the tree
+ * @data: An array of the data pointers to link to the strings
+ * @num: The number of strings
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+DBS_API s8 dbs_christree_add_batch(struct dbs_christree *tree,
+		u8 **str, void **data, s32 num);
+
+
+/*
+ * Get the data pointers linked to a batch of strings. The strings are walked
+ * down the tree together, so the cache misses of the different walks overlap.
+ * This is faster than calling dbs_christree_get() for every string, as long
+ * as the tree doesn't fit into the cache.
+ *
+ * @tree: Pointer to the tree struct
+ * @str: An array of the strings to look up
+ * @data: An array to write the data pointers to, with NULL for every string
+ *        which is not in the tree
+ * @num: The number of strings
+ *
+ * Returns: The number of strings found or -1 if an error occurred
+ */
+DBS_API s32 dbs_christree_get_batch(struct dbs_christree *tree,
+		u8 **str, void **data, s32 num);
+
+
+/*
+ * Remove a batch of entries from the tree. The strings are first walked down
+ * the tree together like with dbs_christree_add_batch(), and are then
+ * removed one after another. In tombstone mode, only their data pointers are
+ * cleared, and the nodes are left for dbs_christree_compact(). If a string
+ * can't be removed, the others are still removed.
+ *
+ * @tree: Pointer to the tree struct or a writer handle
+ * @str: An array of the strings to remove from the tree
+ * @num: The number of strings
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+DBS_API s8 dbs_christree_rmv_batch(struct dbs_christree *tree,
+		u8 **str, s32 num);
+
+
+/*
+ * Get data pointers from the tree by filtering using the given mask. The
+ * branches are walked in ascending order and the selection stops, once the
+ * limit is reached.
+ *
+ * @tree: Pointer to the tree struct
+ * @mask: Pointer to the mask to use
+ * @data: An array of pointers to write the resulting data pointers to
+ * @lim: The limit of how many data pointers can be written to the array
+ *
+ * Returns: The number of selected pointers or -1 if an error occurred
+ */
+DBS_API s32 dbs_christree_sel(struct dbs_christree *tree,
+		struct dbs_chrismask *mask, void **data, s32 lim);
+
+
+/*
+ * Create a new filter, where all conditions match every byte.
+ *
+ * @len: The number of layers to have conditions for
+ *
+ * Returns: Either a pointer to the filter or NULL if an error occurred
+ */
+DBS_API struct dbs_chrisfilter *dbs_chrisfilter_init(s32 len);
+
+
+/*
+ * Destroy a filter and free the allocated memory.
+ *
+ * @flt: Pointer to the filter
+ */
+DBS_API void dbs_chrisfilter_close(struct dbs_chrisfilter *flt);
+
+
+/*
+ * Let the condition for a layer match every byte.
+ *
+ * @flt: Pointer to the filter
+ * @off: The layer of the condition
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+DBS_API s8 dbs_chrisfilter_set_any(struct dbs_chrisfilter *flt, s32 off);
+
+
+/*
+ * Let the conditions for a run of layers only match the given bytes.
+ *
+ * @flt: Pointer to the filter
+ * @off: The first layer of the run
+ * @data: The bytes to match
+ * @len: The number of bytes
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+DBS_API s8 dbs_chrisfilter_set_exact(struct dbs_chrisfilter *flt, s32 off,
+		u8 *data, s32 len);
+
+
+/*
+ * Require the bits set in msk to have the values in val for a layer. This
+ * replaces the bits of the condition, but keeps the range.
+ *
+ * @flt: Pointer to the filter
+ * @off: The layer of the condition
+ * @msk: The bits to check
+ * @val: The values of the bits
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+DBS_API s8 dbs_chrisfilter_set_bits(struct dbs_chrisfilter *flt, s32 off,
+		u8 msk, u8 val);
+
+
+/*
+ * Require the byte of a layer to lie in the given range. This replaces the
+ * range of the condition, but keeps the bits.
+ *
+ * @flt: Pointer to the filter
+ * @off: The layer of the condition
+ * @lo: The lowest byte to match
+ * @hi: The highest byte to match
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+DBS_API s8 dbs_chrisfilter_set_range(struct dbs_chrisfilter *flt, s32 off,
+		u8 lo, u8 hi);
+
+
+/*
+ * Get data pointers from the tree by filtering using the given filter.
+ * Children outside of the range of a condition are skipped without being
+ * looked at. The branches are walked in ascending order and the selection
+ * stops, once the limit is reached.
+ *
+ * @tree: Pointer to the tree struct
+ * @flt: Pointer to the filter to use
+ * @data: An array of pointers to write the resulting data pointers to
+ * @lim: The limit of how many data pointers can be written to the array
+ *
+ * Returns: The number of selected pointers or -1 if an error occurred
+ */
+DBS_API s32 dbs_christree_filter(struct dbs_christree *tree,
+		struct dbs_chrisfilter *flt, void **data, s32 lim);
+
+
+/*
+ * The different steps of a cursor, while searching for the branches to
+ * collect the data pointers from.
+ */
+#define DBS_CHRISTREE_CUR_ROOT     0
+#define DBS_CHRISTREE_CUR_LAYER    1
+#define DBS_CHRISTREE_CUR_CROSS    2
+#define DBS_CHRISTREE_CUR_DONE     3
+
+
+/*
+ * An entry on the stack of a cursor.
+ */
+struct dbs_christree_frame {
+	struct dbs_christree_node    *node;
+
+	/*
+	 * The position in the v_next list of the node, or -1 if the data
+	 * pointer of the node itself hasn't been collected yet.
+	 */
+	s32                          next;
+};
+
+
+/*
+ * A cursor to go through the results of a selection in multiple steps.
+ */
+struct dbs_christree_cursor {
+	struct dbs_christree         *tree;
+
+	/*
+	 * A copy of the filter to use, and the first layer with a condition
+	 * not matching every byte, or -1 if the whole tree is walked.
+	 */
+	struct dbs_chrisfilter       flt;
+	s32                          seed;
+
+	/*
+	 * The position in the cross lists and the layer lists of the first
+	 * restricted layer, while searching for the branches to collect the
+	 * data pointers from.
+	 */
+	s32                          step;
+	struct dbs_christree_node    *cand;
+	struct dbs_christree_cross   *cross;
+	s32                          cand_dif;
+
+	/*
+	 * The stack for walking through the current branch.
+	 */
+	struct dbs_christree_frame   *stk;
+	s32                          stk_num;
+};
+
+
+/*
+ * Open a cursor to get the data pointers selected by the given mask in
+ * multiple steps. The cursor keeps its own copy of the mask. Unless the tree
+ * is shared, it must not be modified while the cursor is open.
+ *
+ * @tree: Pointer to the tree struct
+ * @mask: Pointer to the mask to use
+ *
+ * Returns: Either a pointer to the cursor or NULL if an error occurred
+ */
+DBS_API struct dbs_christree_cursor *dbs_christree_sel_open(
+		struct dbs_christree *tree, struct dbs_chrismask *mask);
+
+
+/*
+ * Open a cursor to get the data pointers selected by the given filter in
+ * multiple steps. The cursor keeps its own copy of the filter. Unless the
+ * tree is shared, it must not be modified while the cursor is open.
+ *
+ * @tree: Pointer to the tree struct
+ * @flt: Pointer to the filter to use
+ *
+ * Returns: Either a pointer to the cursor or NULL if an error occurred
+ */
+DBS_API struct dbs_christree_cursor *dbs_christree_filter_open(
+		struct dbs_christree *tree, struct dbs_chrisfilter *flt);
+
+
+/*
+ * Close a cursor and free the allocated memory.
+ *
+ * @cur: Pointer to the cursor
+ */
+DBS_API void dbs_christree_sel_close(struct dbs_christree_cursor *cur);
+
+
+/*
+ * Get the next data pointers from a cursor. The cursor continues where the
+ * last call stopped.
+ *
+ * @cur: Pointer to the cursor
+ * @data: An array of pointers to write the resulting data pointers to
+ * @lim: The limit of how many data pointers can be written to the array
+ *
+ * Returns: The number of selected pointers, 0 if all pointers have been
+ *          returned or -1 if an error occurred
+ */
+DBS_API s32 dbs_christree_sel_next(struct dbs_christree_cursor *cur,
+		void **data, s32 lim);
+
+
+/*
+ * The kinds of tasks of a parallel selection. A node task walks the branch
+ * below a node, starting at the given position of the node. The other tasks
+ * go through a layer list or a cross list, looking for branches the same way
+ * a cursor does in the step of the same name.
+ */
+#define DBS_CHRISTREE_TASK_NODE    DBS_CHRISTREE_CUR_ROOT
+#define DBS_CHRISTREE_TASK_LAYER   DBS_CHRISTREE_CUR_LAYER
+#define DBS_CHRISTREE_TASK_CROSS   DBS_CHRISTREE_CUR_CROSS
+
+
+/*
+ * The number of data pointers a worker of a parallel selection collects,
+ * before it checks if the limit has been reached.
+ */
+#define DBS_CHRISTREE_PAR_BATCH    256
+
+
+/*
+ * The data pointers collected by a single worker of a parallel selection, and
+ * the stack it walks the branches with.
+ */
+struct dbs_christree_parbuf {
+	void                         **data;
+	s32                          num;
+	s32                          alloc;
+
+	struct dbs_christree_frame   *stk;
+};
+
+
+/*
+ * A selection spread over the workers of a pool. The cursor only holds the
+ * filter and the layer to search for branches, and is shared by all workers.
+ */
+struct dbs_christree_par {
+	struct dbs_christree_cursor  cur;
+	struct dbs_christree_parbuf  *buf;
+
+	/*
+	 * The limit, the number of data pointers the workers have reported so
+	 * far, and if a worker ran out of memory.
+	 */
+	s32                          lim;
+	s32                          num;
+	s8                           fail;
+};
+
+
+/*
+ * Get data pointers from the tree by filtering using the given mask, with the
+ * work spread over the workers of a pool. Every list a cursor would search
+ * for branches is a task of its own. If other workers are idle, the rest of a
+ * list or of a branch is split off as a new task, so big branches are walked
+ * by multiple workers. Each worker collects into a buffer of its own, and the
+ * buffers are merged at the end, so the data pointers are returned in no
+ * particular order. If the tree is shared, the calling thread has to be
+ * inside a read section, which covers the workers as well. A branch split by
+ * a concurrent writer may be missed.
+ *
+ * @tree: Pointer to the tree struct
+ * @pool: Pointer to the pool to run the selection on
+ * @mask: Pointer to the mask to use
+ * @data: An array of pointers to write the resulting data pointers to
+ * @lim: The limit of how many data pointers can be written to the array
+ *
+ * Returns: The number of selected pointers or -1 if an error occurred
+ */
+DBS_API s32 dbs_christree_sel_par(struct dbs_christree *tree,
+		struct dbs_pool *pool, struct dbs_chrismask *mask,
+		void **data, s32 lim);
+
+
+/*
+ * Get data pointers from the tree by filtering using the given filter, with
+ * the work spread over the workers of a pool, the same way as
+ * dbs_christree_sel_par().
+ *
+ * @tree: Pointer to the tree struct
+ * @pool: Pointer to the pool to run the selection on
+ * @flt: Pointer to the filter to use
+ * @data: An array of pointers to write the resulting data pointers to
+ * @lim: The limit of how many data pointers can be written to the array
+ *
+ * Returns: The number of selected pointers or -1 if an error occurred
+ */
+DBS_API s32 dbs_christree_filter_par(struct dbs_christree *tree,
+		struct dbs_pool *pool, struct dbs_chrisfilter *flt,
+		void **data, s32 lim);
+
+
+/*
+ * A scan to go through the keys of a range in ascending order in multiple
+ * steps.
+ */
+struct dbs_christree_scan {
+	struct dbs_christree         *tree;
+
+	/*
+	 * The exclusive upper bound or NULL, and the number of bytes the
+	 * current key has in common with it.
+	 */
+	u8                           *hi;
+	s32                          hi_eq;
+
+	/*
+	 * The key of the current branch, with one byte for each layer.
+	 */
+	u8                           *key;
+
+	/*
+	 * The stack for walking through the tree.
+	 */
+	struct dbs_christree_frame   *stk;
+	s32                          stk_num;
+};
+
+
+/*
+ * Get the smallest key in the tree, which is equal to or bigger than the
+ * given string.
+ *
+ * @tree: Pointer to the tree struct
+ * @str: The string to compare with, containing one byte for each layer
+ * @key: A buffer to write the key to, with one byte for each layer, or NULL
+ * @data: A pointer to write the data pointer of the key to or NULL
+ *
+ * Returns: 1 if a key has been found, 0 if not or -1 if an error occurred
+ */
+DBS_API s8 dbs_christree_lower_bound(struct dbs_christree *tree, u8 *str,
+		u8 *key, void **data);
+
+
+/*
+ * Get the smallest key in the tree, which is bigger than the given string.
+ *
+ * @tree: Pointer to the tree struct
+ * @str: The string to compare with, containing one byte for each layer
+ * @key: A buffer to write the key to, with one byte for each layer, or NULL
+ * @data: A pointer to write the data pointer of the key to or NULL
+ *
+ * Returns: 1 if a key has been found, 0 if not or -1 if an error occurred
+ */
+DBS_API s8 dbs_christree_upper_bound(struct dbs_christree *tree, u8 *str,
+		u8 *key, void **data);
+
+
+/*
+ * Get the keys from lo up to, but not including, hi together with their data
+ * pointers in ascending order. Branches outside of the range are skipped.
+ * The scan stops, once the limit is reached. A key shorter than the number of
+ * layers comes before the keys it is the beginning of, and is written padded
+ * with zero bytes.
+ *
+ * @tree: Pointer to the tree struct
+ * @lo: The lower bound or NULL to start with the smallest key
+ * @hi: The upper bound or NULL to go up to the biggest key
+ * @keys: An array to write the keys to, with one byte for each layer and key,
+ *        or NULL
+ * @data: An array of pointers to write the data pointers to
+ * @lim: The limit of how many keys can be written to the arrays
+ *
+ * Returns: The number of keys written to the arrays or -1 if an error
+ *          occurred
+ */
+DBS_API s32 dbs_christree_range(struct dbs_christree *tree, u8 *lo, u8 *hi,
+		u8 *keys, void **data, s32 lim);
+
+
+/*
+ * Open a scan to get the keys of a range in multiple steps. The scan keeps
+ * its own copy of the upper bound. Unless the tree is shared, it must not be
+ * modified while the scan is open.
+ *
+ * @tree: Pointer to the tree struct
+ * @lo: The lower bound or NULL to start with the smallest key
+ * @hi: The upper bound or NULL to go up to the biggest key
+ *
+ * Returns: Either a pointer to the scan or NULL if an error occurred
+ */
+DBS_API struct dbs_christree_scan *dbs_christree_range_open(
+		struct dbs_christree *tree, u8 *lo, u8 *hi);
+
+
+/*
+ * Close a scan and free the allocated memory.
+ *
+ * @scan: Pointer to the scan
+ */
+DBS_API void dbs_christree_range_close(struct dbs_christree_scan *scan);
+
+
+/*
+ * Get the next keys and data pointers from a scan. The scan continues where
+ * the last call stopped.
+ *
+ * @scan: Pointer to the scan
+ * @keys: An array to write the keys to, with one byte for each layer and key,
+ *        or NULL
+ * @data: An array of pointers to write the data pointers to
+ * @lim: The limit of how many keys can be written to the arrays
+ *
+ * Returns: The number of keys written to the arrays, 0 if all keys have been
+ *          returned or -1 if an error occurred
+ */
+DBS_API s32 dbs_christree_range_next(struct dbs_christree_scan *scan,
+		u8 *keys, void **data, s32 lim);
+
+
+/*
+ * The state of a bulk load. The open nodes are the ones on the path of the
+ * last key, which can still get more children. Until a node is closed, its
+ * children are collected in a shared list, starting at the position stored
+ * as the next field of its stack entry.
+ */
+struct dbs_christree_loader {
+	struct dbs_christree         *tree;
+
+	struct dbs_christree_frame   *stk;
+	s32                          stk_num;
+
+	/*
+	 * The children collected for the open nodes and their dif characters.
+	 * Below the last layer, the children are the data pointers.
+	 */
+	struct dbs_christree_node    **lst;
+	u8                           *key;
+	s32                          lst_num;
+	s32                          lst_alloc;
+
+	/*
+	 * The last key, with one byte for each layer.
+	 */
+	u8                           *prev;
+	s32                          key_num;
+};
+
+
+/*
+ * Fill an empty tree with the keys returned by a callback. The keys have to
+ * come in ascending order, and if a key is repeated, the last data pointer is
+ * used. The nodes are built bottom-up, so every v_next list is created only
+ * once with the exact size. If an error occurs, the tree is left empty.
+ *
+ * @tree: Pointer to the tree struct
+ * @src: The callback, which writes the next key and data pointer to str and
+ *       data and returns 1, or returns 0 at the end or -1 to abort the load
+ * @arg: An argument passed to the callback
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+DBS_API s8 dbs_christree_load(struct dbs_christree *tree,
+		s8 (*src)(void *arg, u8 **str, void **data), void *arg);
+
+
+/*
+ * Fill an empty tree with the keys from a sorted array. This works like
+ * dbs_christree_load().
+ *
+ * @tree: Pointer to the tree struct
+ * @keys: The keys in ascending order, with one byte for each layer and key
+ * @data: The data pointers for the keys
+ * @num: The number of keys
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+DBS_API s8 dbs_christree_load_array(struct dbs_christree *tree,
+		u8 *keys, void **data, s32 num);
+
+
+/*
+ * The number of buckets of the fan-out histogram. Bucket 0 counts the nodes
+ * without children, bucket 1 the nodes with a single child and every further
+ * bucket i the nodes with 2^(i-2)+1 to 2^(i-1) children.
+ */
+#define DBS_CHRISTREE_FANOUT    10
+
+
+/*
+ * The statistics of a single layer.
+ */
+struct dbs_christree_layer_stats {
+	/*
+	 * The number of nodes starting on the layer, the number of compressed
+	 * nodes from the layers above covering it and the number of strings
+	 * ending on it.
+	 */
+	s32                          node_num;
+	s32                          cross;
+	s32                          data_num;
+
+	/*
+	 * The number of children of all nodes starting on the layer.
+	 */
+	s32                          child_num;
+};
+
+
+/*
+ * The statistics of the structure of a tree.
+ */
+struct dbs_christree_stats {
+	/*
+	 * The number of nodes, not counting the root, and the number of
+	 * strings in the tree.
+	 */
+	s32                          node_num;
+	s32                          data_num;
+
+	/*
+	 * The statistics for every used layer.
+	 */
+	struct dbs_christree_layer_stats *layer;
+	s32                          layer_num;
+
+	/*
+	 * The number of nodes by the number of their children.
+	 */
+	s32                          fanout[DBS_CHRISTREE_FANOUT];
+
+	/*
+	 * The number of v_next lists of each kind, from the smallest to the
+	 * biggest, and the number of their slots without a child.
+	 */
+	s32                          next_num[4];
+	s32                          next_slack[4];
+
+	/*
+	 * The chains of nodes with a single child and no data pointer. The
+	 * length of a chain is the number of layers it covers.
+	 */
+	s32                          chain_num;
+	s32                          chain_max;
+	double                       chain_avg;
+
+	/*
+	 * The number of bytes taken from the allocator, including the slabs
+	 * of all writer handles and the index, and the number of bytes of
+	 * the nodes and v_next lists currently in use. The bytes per key are
+	 * the allocated bytes divided by the number of strings.
+	 */
+	u64                          bytes;
+	u64                          bytes_used;
+	double                       bytes_per_key;
+};
+
+
+/*
+ * Collect the statistics of a tree in a single walk over all nodes, without
+ * printing anything. The tree must not be changed meanwhile.
+ *
+ * @tree: Pointer to the tree struct
+ *
+ * Returns: Either a pointer to the statistics or NULL if an error occurred
+ */
+DBS_API struct dbs_christree_stats *dbs_christree_stats_init(
+		struct dbs_christree *tree);
+
+
+/*
+ * Free the statistics of a tree.
+ *
+ * @stats: Pointer to the statistics
+ */
+DBS_API void dbs_christree_stats_close(struct dbs_christree_stats *stats);
 
 
-DBS_API s32 dbs_christree_dump_rec(struct dbs_christree_node *n);
+DBS_API s32 dbs_christree_dump_rec(struct dbs_christree *tree,
+		struct dbs_christree_node *n);
 
 /*
  * Print the tree in the console.
@@ -3,4 +3,17 @@
 
 #define DBS_API                extern
 
+/*
+ * Load and store values shared between a writer and concurrent readers. A
+ * store makes everything written before it visible to a reader, which loads
+ * the stored value.
+ */
+#define DBS_LOAD(p)            __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+#define DBS_STORE(p, v)        __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+/*
+ * Start loading the cache line of an address, which will be read soon.
+ */
+#define DBS_PREFETCH(p)        __builtin_prefetch(p)
+
 #endif /* _DBS_DEFINE_H */
@@ -3,5 +3,6 @@
 
 #include "define.h"
 #include "christree.h"
+#include "frozen.h"
 
 #endif /* _DBS_DUMBSTRUCT_H */
@@ -0,0 +1,187 @@
+#ifndef _DBS_EPOCH_H
+#define _DBS_EPOCH_H
+
+#include "define.h"
+#include "imports.h"
+#include "slab.h"
+
+/*
+ * The size of a cache line. Every reader gets a line of its own, so readers
+ * never write to memory shared with other readers.
+ */
+#define DBS_EPOCH_LINE          64
+
+
+/*
+ * The number of objects a writer retires, after which it tries to advance the
+ * epoch.
+ */
+#define DBS_EPOCH_BATCH         256
+
+
+struct dbs_epoch;
+
+/*
+ * A reader of a structure shared with writers. While the reader is inside a
+ * read section, epoch is the global epoch seen when entering it and 0
+ * otherwise.
+ */
+struct dbs_epoch_reader {
+	u64                          epoch;
+	struct dbs_epoch             *ep;
+	s32                          used;
+};
+
+union dbs_epoch_slot {
+	struct dbs_epoch_reader      rd;
+	u8                           pad[DBS_EPOCH_LINE];
+};
+
+
+/*
+ * An object removed by a writer, which is returned to its slab once no
+ * reader can reach it anymore.
+ */
+struct dbs_epoch_item {
+	struct dbs_slab              *slab;
+	void                         *ptr;
+};
+
+/*
+ * The objects a writer retired in the given epoch.
+ */
+struct dbs_epoch_limbo {
+	u64                          epoch;
+	struct dbs_epoch_item        *item;
+	s32                          num;
+	s32                          alloc;
+};
+
+
+/*
+ * Epoch based reclamation for a fixed number of readers and writers. Writers
+ * retire removed objects in the current epoch. The epoch only advances once
+ * every reader inside a read section has seen it, so when the epoch advances,
+ * the objects retired two epochs before can't be reached by any reader
+ * anymore.
+ */
+struct dbs_epoch {
+	u64                          epoch;
+
+	/*
+	 * The slots of the readers, aligned to the cache lines, and the
+	 * allocated memory containing them.
+	 */
+	union dbs_epoch_slot         *slot;
+	s32                          slot_num;
+	void                         *slot_mem;
+};
+
+
+/*
+ * A writer keeps the objects it retired itself, so writers never share a
+ * list. The lists for the last three epochs are indexed by the epoch modulo
+ * 3. As a writer reads the structure as well, it also holds a reader slot.
+ */
+struct dbs_epoch_writer {
+	struct dbs_epoch             *ep;
+	struct dbs_epoch_reader      *rd;
+	struct dbs_epoch_limbo       limbo[3];
+};
+
+
+DBS_API struct dbs_epoch *dbs_epoch_init(s32 slot_num);
+
+
+/*
+ * Destroy the epoch struct. The writers have to be released before.
+ *
+ * @ep: Pointer to the epoch struct
+ */
+DBS_API void dbs_epoch_close(struct dbs_epoch *ep);
+
+
+/*
+ * Open a new reader. This is safe to call from any thread.
+ *
+ * @ep: Pointer to the epoch struct
+ *
+ * Returns: Either a pointer to the reader or NULL if all slots are taken or an
+ *          error occurred
+ */
+DBS_API struct dbs_epoch_reader *dbs_epoch_reader_open(struct dbs_epoch *ep);
+
+
+/*
+ * Close a reader, which must not be inside a read section.
+ *
+ * @rd: Pointer to the reader
+ */
+DBS_API void dbs_epoch_reader_close(struct dbs_epoch_reader *rd);
+
+
+/*
+ * Enter a read section. No object reachable while inside the section is
+ * returned to its slab before the section is left.
+ *
+ * @rd: Pointer to the reader
+ */
+DBS_API void dbs_epoch_enter(struct dbs_epoch_reader *rd);
+
+
+/*
+ * Leave a read section. Pointers to objects of the shared structure must not
+ * be used anymore afterwards.
+ *
+ * @rd: Pointer to the reader
+ */
+DBS_API void dbs_epoch_leave(struct dbs_epoch_reader *rd);
+
+
+/*
+ * Initialize a writer, which takes one of the reader slots. This is safe to
+ * call from any thread.
+ *
+ * @wr: Pointer to the writer
+ * @ep: Pointer to the epoch struct
+ *
+ * Returns: 0 on success or -1 if all slots are taken or an error occurred
+ */
+DBS_API s8 dbs_epoch_writer_init(struct dbs_epoch_writer *wr,
+		struct dbs_epoch *ep);
+
+
+/*
+ * Return all objects retired by a writer to their slabs and give up its
+ * reader slot. No reader may be inside a read section anymore.
+ *
+ * @wr: Pointer to the writer
+ */
+DBS_API void dbs_epoch_writer_release(struct dbs_epoch_writer *wr);
+
+
+/*
+ * Retire an object, which has been removed from the shared structure. The
+ * object is returned to its slab, once no reader can reach it anymore. Each
+ * writer may only be used by one thread at a time.
+ *
+ * @wr: Pointer to the writer
+ * @slab: Pointer to the slab the object has been taken from
+ * @ptr: Pointer to the object
+ */
+DBS_API void dbs_epoch_retire(struct dbs_epoch_writer *wr,
+		struct dbs_slab *slab, void *ptr);
+
+
+/*
+ * Try to advance the epoch and return the objects retired by the writer,
+ * which no reader can reach anymore, to their slabs.
+ *
+ * @wr: Pointer to the writer
+ *
+ * Returns: 1 if the epoch has been advanced and 0 if a reader is still in a
+ *          read section of an older epoch
+ */
+DBS_API s8 dbs_epoch_collect(struct dbs_epoch_writer *wr);
+
+#endif /* _DBS_EPOCH_H */
@@ -0,0 +1,311 @@
+#ifndef _DBS_FROZEN_H
+#define _DBS_FROZEN_H
+
+#include "define.h"
+#include "imports.h"
+#include "christree.h"
+
+/*
+ * A node of a frozen tree. The children of a node are stored next to each
+ * other in ascending order, so only the index of the first one is needed.
+ */
+struct dbs_chrisfrozen_node {
+	/*
+	 * The index of the first child and the number of children.
+	 */
+	u32                          child;
+	u16                          child_num;
+
+	/*
+	 * The number of prefix bytes and the offset of the first one in the
+	 * prefix array.
+	 */
+	u8                           pref_len;
+	u32                          pref;
+
+	/*
+	 * The index of the data pointer plus one, or 0 if there is none.
+	 */
+	u32                          data;
+};
+
+
+/*
+ * An immutable copy of a tree. All nodes are kept in a single array with the
+ * root first, and the children of every node next to each other. The dif
+ * characters are kept in their own array with the same indices, so the
+ * children of a node can be searched without touching the nodes.
+ */
+struct dbs_chrisfrozen {
+	s32                          layer_num;
+
+	struct dbs_chrisfrozen_node  *node;
+	u8                           *key;
+	u32                          node_num;
+
+	u8                           *pref;
+	u32                          pref_num;
+
+	void                         **data;
+	u32                          data_num;
+
+	/*
+	 * For a mapped file, the data pointers are replaced by values of a
+	 * fixed size, and the lookups return pointers to the values.
+	 */
+	u8                           *val;
+	u32                          val_size;
+
+	/*
+	 * The total number of bytes used by the frozen tree, and the mapping
+	 * of the file if the tree has been mapped.
+	 */
+	u64                          size;
+	void                         *map;
+};
+
+
+/*
+ * An entry on the stack, while walking through a frozen tree.
+ */
+struct dbs_chrisfrozen_frame {
+	u32                          node;
+
+	/*
+	 * The number of layers covered by the path down to the node.
+	 */
+	s32                          depth;
+
+	/*
+	 * The position in the children of the node, or -1 if the data pointer
+	 * of the node itself hasn't been collected yet.
+	 */
+	s32                          next;
+};
+
+
+/*
+ * The state of a range scan over a frozen tree.
+ */
+struct dbs_chrisfrozen_scan {
+	struct dbs_chrisfrozen       *frz;
+
+	/*
+	 * The exclusive upper bound or NULL, and the number of bytes the
+	 * current key has in common with it.
+	 */
+	u8                           *hi;
+	s32                          hi_eq;
+
+	/*
+	 * The key of the current branch, with one byte for each layer.
+	 */
+	u8                           *key;
+
+	struct dbs_chrisfrozen_frame *stk;
+	s32                          stk_num;
+};
+
+
+/*
+ * The file format of a saved tree. The file starts with the header, followed
+ * by the nodes, the dif characters, the values and the prefix bytes, each
+ * at the offset given in the header. All numbers are stored in the byte order
+ * of the machine writing the file. Files with a different version, byte order
+ * or node size are rejected when mapping them.
+ */
+#define DBS_CHRISFILE_MAGIC      "DBSCHRS"
+#define DBS_CHRISFILE_VERSION    1
+#define DBS_CHRISFILE_ORDER      0x01020304
+
+struct dbs_chrisfile_hdr {
+	u8                           magic[8];
+	u32                          version;
+	u32                          order;
+	u32                          node_size;
+
+	s32                          layer_num;
+	u32                          node_num;
+	u32                          pref_num;
+	u32                          data_num;
+	u32                          val_size;
+
+	u64                          node_off;
+	u64                          key_off;
+	u64                          val_off;
+	u64                          pref_off;
+	u64                          size;
+};
+
+
+/*
+ * The number of bytes buffered for every region of a file, while writing it.
+ */
+#define DBS_CHRISFILE_BUF_LEN    4096
+
+
+/*
+ * A write buffer for a region of a file, which is filled from front to back.
+ */
+struct dbs_chrisfile_buf {
+	u64                          off;
+	s32                          len;
+	u8                           data[DBS_CHRISFILE_BUF_LEN];
+};
+
+
+/*
+ * Create an immutable copy of a tree, which needs a lot less memory. The
+ * frozen tree doesn't depend on the tree, so the tree can be closed
+ * afterwards.
+ *
+ * @tree: Pointer to the tree struct
+ *
+ * Returns: Either a pointer to the frozen tree or NULL if an error occurred
+ */
+DBS_API struct dbs_chrisfrozen *dbs_christree_freeze(struct dbs_christree *tree);
+
+
+/*
+ * Destroy a frozen tree and free the allocated memory. If the tree has been
+ * mapped from a file, the mapping is removed.
+ *
+ * @frz: Pointer to the frozen tree
+ */
+DBS_API void dbs_chrisfrozen_close(struct dbs_chrisfrozen *frz);
+
+
+/*
+ * Save a tree to a file, which can be mapped with dbs_chrisfrozen_map(). The
+ * nodes are written while walking through the tree, so only a small buffer
+ * for every layer is needed. Instead of the data pointers, the values they
+ * point to are written to the file. The file is written next to the old one
+ * and only replaces it once it is complete and flushed to disk, so a failed
+ * save leaves the old file in place, and trees mapped from it stay valid.
+ *
+ * @tree: Pointer to the tree struct
+ * @pth: The path of the file to write
+ * @val_size: The number of bytes of every value
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+DBS_API s8 dbs_christree_save(struct dbs_christree *tree, char *pth,
+		u32 val_size);
+
+
+/*
+ * Map a saved tree into memory. The file is used directly without reading or
+ * converting it, and the lookups return pointers to the values in the
+ * mapping. The nodes are checked once while mapping, so a file with a
+ * corrupted or truncated body is rejected.
+ *
+ * @pth: The path of the file to map
+ *
+ * Returns: Either a pointer to the frozen tree or NULL if an error occurred
+ */
+DBS_API struct dbs_chrisfrozen *dbs_chrisfrozen_map(char *pth);
+
+
+/*
+ * Get the data pointer of a string from a frozen tree.
+ *
+ * @frz: Pointer to the frozen tree
+ * @str: The string to look for, containing one byte for each layer
+ *
+ * Returns: The data pointer or NULL if the string is not in the tree or an
+ *          error occurred
+ */
+DBS_API void *dbs_chrisfrozen_get(struct dbs_chrisfrozen *frz, u8 *str);
+
+
+/*
+ * Check if a frozen tree contains a string.
+ *
+ * @frz: Pointer to the frozen tree
+ * @str: The string to look for, containing one byte for each layer
+ *
+ * Returns: 1 if the string is in the tree, 0 if not or -1 if an error occurred
+ */
+DBS_API s8 dbs_chrisfrozen_contains(struct dbs_chrisfrozen *frz, u8 *str);
+
+
+/*
+ * Get the data pointer of a string of the given length from a frozen tree.
+ *
+ * @frz: Pointer to the frozen tree
+ * @str: The string to look for
+ * @len: The length of the string, between 1 and the number of layers
+ *
+ * Returns: The data pointer or NULL if the string is not in the tree or an
+ *          error occurred
+ */
+DBS_API void *dbs_chrisfrozen_get_n(struct dbs_chrisfrozen *frz, u8 *str,
+		s32 len);
+
+
+/*
+ * Check if a frozen tree contains a string of the given length.
+ *
+ * @frz: Pointer to the frozen tree
+ * @str: The string to look for
+ * @len: The length of the string, between 1 and the number of layers
+ *
+ * Returns: 1 if the string is in the tree, 0 if not or -1 if an error occurred
+ */
+DBS_API s8 dbs_chrisfrozen_contains_n(struct dbs_chrisfrozen *frz, u8 *str,
+		s32 len);
+
+
+/*
+ * Get data pointers from a frozen tree by filtering using the given mask.
+ * The branches are walked in ascending order and the selection stops, once
+ * the limit is reached.
+ *
+ * @frz: Pointer to the frozen tree
+ * @mask: Pointer to the mask to use
+ * @data: An array of pointers to write the resulting data pointers to
+ * @lim: The limit of how many data pointers can be written to the array
+ *
+ * Returns: The number of selected pointers or -1 if an error occurred
+ */
+DBS_API s32 dbs_chrisfrozen_sel(struct dbs_chrisfrozen *frz,
+		struct dbs_chrismask *mask, void **data, s32 lim);
+
+
+/*
+ * Get data pointers from a frozen tree by filtering using the given filter.
+ * Children outside of the range of a condition are skipped without being
+ * looked at. The branches are walked in ascending order and the selection
+ * stops, once the limit is reached.
+ *
+ * @frz: Pointer to the frozen tree
+ * @flt: Pointer to the filter to use
+ * @data: An array of pointers to write the resulting data pointers to
+ * @lim: The limit of how many data pointers can be written to the array
+ *
+ * Returns: The number of selected pointers or -1 if an error occurred
+ */
+DBS_API s32 dbs_chrisfrozen_filter(struct dbs_chrisfrozen *frz,
+		struct dbs_chrisfilter *flt, void **data, s32 lim);
+
+
+/*
+ * Get the keys from lo up to, but not including, hi together with their data
+ * pointers from a frozen tree in ascending order. Branches outside of the
+ * range are skipped. The scan stops, once the limit is reached.
+ *
+ * @frz: Pointer to the frozen tree
+ * @lo: The lower bound or NULL to start with the smallest key
+ * @hi: The upper bound or NULL to go up to the biggest key
+ * @keys: An array to write the keys to, with one byte for each layer and key,
+ *        or NULL
+ * @data: An array of pointers to write the data pointers to
+ * @lim: The limit of how many keys can be written to the arrays
+ *
+ * Returns: The number of keys written to the arrays or -1 if an error
+ *          occurred
+ */
+DBS_API s32 dbs_chrisfrozen_range(struct dbs_chrisfrozen *frz, u8 *lo, u8 *hi,
+		u8 *keys, void **data, s32 lim);
+
+#endif
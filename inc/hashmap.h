@@ -0,0 +1,111 @@
+#ifndef _DBS_HASHMAP_H
+#define _DBS_HASHMAP_H
+
+#include "define.h"
+#include "imports.h"
+
+/*
+ * The number of bytes of a string kept in the entry itself. Longer strings
+ * are copied into memory of their own.
+ */
+#define DBS_HASHMAP_INLINE      16
+
+
+/*
+ * The number of entries a new hash map starts with.
+ */
+#define DBS_HASHMAP_MIN         64
+
+
+/*
+ * An entry of a hash map, which is empty if it has no data pointer.
+ */
+struct dbs_hashmap_entry {
+	u64                          hash;
+	void                         *data;
+	s32                          len;
+
+	union {
+		u8                           buf[DBS_HASHMAP_INLINE];
+		u8                           *ptr;
+	} key;
+};
+
+
+/*
+ * A hash map from strings to data pointers with open addressing. The entries
+ * are probed one after another, starting with the one the hash points to. A
+ * removed entry is filled by moving later entries of the same run back, so
+ * there are never any deleted entries in the way. The table is grown once it
+ * is half full, which keeps the runs short. Every hash map hashes with a seed
+ * of its own, so colliding strings can't be prepared in advance.
+ */
+struct dbs_hashmap {
+	struct dbs_hashmap_entry     *entry;
+	s32                          num;
+	s32                          alloc;
+	u64                          seed;
+};
+
+
+/*
+ * Create a new empty hash map.
+ *
+ * Returns: Either a pointer to the hash map or NULL if an error occurred
+ */
+DBS_API struct dbs_hashmap *dbs_hashmap_init(void);
+
+
+/*
+ * Destroy a hash map and free the copies of the strings.
+ *
+ * @map: Pointer to the hash map
+ */
+DBS_API void dbs_hashmap_close(struct dbs_hashmap *map);
+
+
+/*
+ * Link a data pointer to a string, replacing the data pointer linked to it
+ * before.
+ *
+ * @map: Pointer to the hash map
+ * @str: The string
+ * @len: The length of the string
+ * @data: The data pointer
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+DBS_API s8 dbs_hashmap_set(struct dbs_hashmap *map, u8 *str, s32 len,
+		void *data);
+
+
+/*
+ * Get the data pointer linked to a string.
+ *
+ * @map: Pointer to the hash map
+ * @str: The string
+ * @len: The length of the string
+ *
+ * Returns: The data pointer or NULL if the string is not in the hash map
+ */
+DBS_API void *dbs_hashmap_get(struct dbs_hashmap *map, u8 *str, s32 len);
+
+
+/*
+ * Remove a string from the hash map.
+ *
+ * @map: Pointer to the hash map
+ * @str: The string
+ * @len: The length of the string
+ */
+DBS_API void dbs_hashmap_del(struct dbs_hashmap *map, u8 *str, s32 len);
+
+
+/*
+ * Remove all strings from the hash map, keeping the table.
+ *
+ * @map: Pointer to the hash map
+ */
+DBS_API void dbs_hashmap_clear(struct dbs_hashmap *map);
+
+#endif /* _DBS_HASHMAP_H */
@@ -0,0 +1,158 @@
+#ifndef _DBS_INSTR_H
+#define _DBS_INSTR_H
+
+#include "define.h"
+#include "imports.h"
+
+/*
+ * The operations with a latency histogram of their own. Selections with a
+ * filter are counted as selections as well.
+ */
+#define DBS_INSTR_OP_ADD        0
+#define DBS_INSTR_OP_RMV        1
+#define DBS_INSTR_OP_GET        2
+#define DBS_INSTR_OP_SEL        3
+#define DBS_INSTR_OPS           4
+
+
+/*
+ * The event counters. Visited nodes are the nodes a walk down the tree or a
+ * selection steps onto, allocated nodes the nodes taken from the slabs and
+ * grown lists the v_next lists replaced by dbs_christree_add_v_next(). The
+ * candidates are the nodes found in the layer lists, either by
+ * dbs_christree_get_layer() or by a selection starting further down.
+ */
+#define DBS_INSTR_VISIT         0
+#define DBS_INSTR_ALLOC         1
+#define DBS_INSTR_GROW          2
+#define DBS_INSTR_LAYER         3
+#define DBS_INSTR_CAND          4
+#define DBS_INSTR_CNTS          5
+
+
+/*
+ * The latencies are kept in a log-linear histogram. Values below 16ns have a
+ * bucket each, and every power of two above is split into 8 buckets, so a
+ * value is off by at most 12.5 percent.
+ */
+#define DBS_INSTR_SUB           8
+#define DBS_INSTR_BUCKETS       (16 + 60 * DBS_INSTR_SUB)
+
+
+/*
+ * The numbers for a single operation. The visited nodes are the ones stepped
+ * onto while running the operation. The maximum is only set in snapshots and
+ * is the upper bound of the highest bucket of the histogram in use.
+ */
+struct dbs_instr_op {
+	u64                          num;
+	u64                          ns;
+	u64                          max;
+	u64                          visit;
+	u64                          hist[DBS_INSTR_BUCKETS];
+};
+
+
+/*
+ * A snapshot of all counters.
+ */
+struct dbs_instr {
+	struct dbs_instr_op          op[DBS_INSTR_OPS];
+	u64                          cnt[DBS_INSTR_CNTS];
+};
+
+
+/*
+ * The counters of a single thread. They are only ever written by the thread
+ * itself and read by the snapshots, so threads never contend for them. The
+ * blocks of all threads are kept in a list, which is only freed when the
+ * program ends, so the counts of finished threads stay in the snapshots.
+ */
+struct dbs_instr_thread {
+	struct dbs_instr             cnt;
+
+	/*
+	 * The number of visited nodes when the running operation started.
+	 */
+	u64                          mark;
+
+	struct dbs_instr_thread      *next;
+};
+
+
+/*
+ * The instrumentation is only compiled in if DBS_INSTR is defined, otherwise
+ * the macros used by the library are empty. DBS_INSTR_VAR declares the start
+ * time of an operation and has to be put with the declarations, without a
+ * semicolon.
+ */
+#ifdef DBS_INSTR
+#define DBS_INSTR_VAR(v)        u64 v;
+#define DBS_INSTR_BEGIN(v)      ((v) = dbs_instr_begin())
+#define DBS_INSTR_END(op, v)    dbs_instr_end(op, v)
+#define DBS_INSTR_COUNT(c, n)   dbs_instr_count(c, n)
+#else
+#define DBS_INSTR_VAR(v)
+#define DBS_INSTR_BEGIN(v)      ((void)0)
+#define DBS_INSTR_END(op, v)    ((void)0)
+#define DBS_INSTR_COUNT(c, n)   ((void)0)
+#endif
+
+
+/*
+ * Start timing an operation on the calling thread.
+ *
+ * Returns: The start time in nanoseconds
+ */
+DBS_API u64 dbs_instr_begin(void);
+
+
+/*
+ * Finish timing an operation on the calling thread and add the time and the
+ * visited nodes to the numbers of the operation.
+ *
+ * @op: The operation
+ * @start: The start time returned by dbs_instr_begin()
+ */
+DBS_API void dbs_instr_end(s32 op, u64 start);
+
+
+/*
+ * Add to an event counter of the calling thread.
+ *
+ * @c: The counter
+ * @n: The number to add
+ */
+DBS_API void dbs_instr_count(s32 c, u64 n);
+
+
+/*
+ * Sum up the counters of all threads since the last reset. Counters of other
+ * threads may be read while they are changed, so the snapshot isn't atomic,
+ * but every single counter is read as a whole.
+ *
+ * @snap: Pointer to write the snapshot to
+ */
+DBS_API void dbs_instr_snapshot(struct dbs_instr *snap);
+
+
+/*
+ * Start counting from zero again. The counters of the threads are left
+ * alone, instead the current sums are subtracted from later snapshots.
+ */
+DBS_API void dbs_instr_reset(void);
+
+
+/*
+ * Get a percentile of the latencies of an operation in a snapshot.
+ *
+ * @snap: Pointer to the snapshot
+ * @op: The operation
+ * @p: The percentile, between 0 and 100
+ *
+ * Returns: The upper bound of the bucket containing the percentile in
+ *          nanoseconds, or 0 if the operation hasn't been run
+ */
+DBS_API u64 dbs_instr_percentile(struct dbs_instr *snap, s32 op, double p);
+
+#endif /* _DBS_INSTR_H */
@@ -0,0 +1,139 @@
+#ifndef _DBS_POOL_H
+#define _DBS_POOL_H
+
+#include "define.h"
+#include "imports.h"
+
+#include <pthread.h>
+
+
+struct dbs_pool;
+
+/*
+ * A task for the workers of a pool. What the fields mean is up to the job
+ * running on the pool.
+ */
+struct dbs_pool_task {
+	void                         *ptr;
+	s32                          arg[2];
+};
+
+
+/*
+ * The tasks of a single worker in a ring buffer. The worker takes its own
+ * tasks from the back, while other workers steal from the front, where the
+ * oldest and usually the biggest tasks are.
+ */
+struct dbs_pool_deque {
+	pthread_mutex_t              lock;
+	struct dbs_pool_task         *task;
+	s32                          head;
+	s32                          num;
+	s32                          alloc;
+};
+
+
+struct dbs_pool_worker {
+	struct dbs_pool              *pool;
+	s32                          id;
+	pthread_t                    thread;
+	struct dbs_pool_deque        dq;
+};
+
+
+/*
+ * A fixed number of worker threads, which run one job at a time. The thread
+ * running the job takes part as the first worker.
+ */
+struct dbs_pool {
+	struct dbs_pool_worker       *wrk;
+	s32                          wrk_num;
+
+	/*
+	 * Every job gets a new generation, which wakes up the workers.
+	 */
+	pthread_mutex_t              lock;
+	pthread_cond_t               cond;
+	u32                          gen;
+	s8                           stop;
+
+	/*
+	 * The function running a single task of the current job.
+	 */
+	void                         (*fn)(struct dbs_pool_worker *wrk,
+			struct dbs_pool_task *task, void *ctx);
+	void                         *ctx;
+
+	/*
+	 * The number of tasks pushed but not done yet, the number of workers
+	 * looking for tasks to steal, and the number of threads still inside
+	 * the current job.
+	 */
+	s32                          pending;
+	s32                          idle;
+	s32                          busy;
+};
+
+
+/*
+ * Create a new pool and start the worker threads.
+ *
+ * @wrk_num: The number of workers, including the thread running the jobs
+ *
+ * Returns: Either a pointer to the pool or NULL if an error occurred
+ */
+DBS_API struct dbs_pool *dbs_pool_init(s32 wrk_num);
+
+
+/*
+ * Stop the worker threads and destroy the pool.
+ *
+ * @pool: Pointer to the pool
+ */
+DBS_API void dbs_pool_close(struct dbs_pool *pool);
+
+
+/*
+ * Run a job on the pool and wait until all of its tasks are done. The first
+ * tasks are spread over the workers, and every task may push more tasks. Only
+ * one job can run on a pool at a time.
+ *
+ * @pool: Pointer to the pool
+ * @fn: The function to run a single task with
+ * @ctx: The context passed to every call of the function
+ * @task: The first tasks of the job
+ * @task_num: The number of first tasks
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+DBS_API s8 dbs_pool_run(struct dbs_pool *pool,
+		void (*fn)(struct dbs_pool_worker *wrk,
+			struct dbs_pool_task *task, void *ctx),
+		void *ctx, struct dbs_pool_task *task, s32 task_num);
+
+
+/*
+ * Push a new task from inside a running task, to be done by the same worker
+ * later or to be stolen by another one.
+ *
+ * @wrk: Pointer to the worker running the current task
+ * @task: Pointer to the task, which is copied
+ *
+ * Returns: 0 on success or -1 if an error occurred, in which case the task
+ *          has to be done by the caller
+ */
+DBS_API s8 dbs_pool_push(struct dbs_pool_worker *wrk,
+		struct dbs_pool_task *task);
+
+
+/*
+ * Check if other workers are waiting for tasks. A long task should then push
+ * some of its work as a new task.
+ *
+ * @wrk: Pointer to the worker running the current task
+ *
+ * Returns: 1 if there are idle workers and 0 if not
+ */
+DBS_API s8 dbs_pool_idle(struct dbs_pool_worker *wrk);
+
+#endif /* _DBS_POOL_H */
@@ -0,0 +1,103 @@
+#ifndef _DBS_SLAB_H
+#define _DBS_SLAB_H
+
+#include "define.h"
+#include "imports.h"
+
+/*
+ * The number of bytes a new chunk should have at least.
+ */
+#define DBS_SLAB_CHUNK_SIZE     65536
+
+
+/*
+ * A chunk of memory, containing the objects right after the header.
+ */
+struct dbs_slab_chunk {
+	union {
+		struct dbs_slab_chunk        *next;
+
+		/*
+		 * Keep the objects behind the header aligned.
+		 */
+		void                         *p;
+		double                       d;
+		long                         l;
+	} hdr;
+};
+
+
+/*
+ * A slab allocator for objects of a fixed size. Objects are carved from big
+ * chunks and freed objects are kept in a free list to be reused. All chunks
+ * are released at once, when the slab is released.
+ */
+struct dbs_slab {
+	/*
+	 * The size of a single object and the number of objects in a chunk.
+	 */
+	s32                          size;
+	s32                          per_chunk;
+
+	/*
+	 * The list of all chunks, with the newest one first.
+	 */
+	struct dbs_slab_chunk        *chunk;
+	s32                          chunk_num;
+
+	/*
+	 * The not yet used objects in the newest chunk.
+	 */
+	u8                           *cur;
+	s32                          left;
+
+	/*
+	 * The list of freed objects, linked through their first bytes.
+	 */
+	void                         *free;
+
+	/*
+	 * The number of objects currently handed out.
+	 */
+	s32                          used;
+};
+
+
+/*
+ * Initialize a slab. This will not allocate any memory yet, the first chunk is
+ * allocated with the first object.
+ *
+ * @slab: Pointer to the slab struct
+ * @size: The size of a single object in bytes
+ */
+DBS_API void dbs_slab_init(struct dbs_slab *slab, s32 size);
+
+
+/*
+ * Release all chunks of a slab at once. All objects taken from the slab are
+ * invalid afterwards, but the slab can be used again.
+ *
+ * @slab: Pointer to the slab struct
+ */
+DBS_API void dbs_slab_release(struct dbs_slab *slab);
+
+
+/*
+ * Take an object from the slab. The memory will not be initialized.
+ *
+ * @slab: Pointer to the slab struct
+ *
+ * Returns: Either a pointer to the object or NULL if an error occurred
+ */
+DBS_API void *dbs_slab_alloc(struct dbs_slab *slab);
+
+
+/*
+ * Return an object to the slab, so it can be reused.
+ *
+ * @slab: Pointer to the slab struct
+ * @ptr: Pointer to the object
+ */
+DBS_API void dbs_slab_free(struct dbs_slab *slab, void *ptr);
+
+#endif /* _DBS_SLAB_H */
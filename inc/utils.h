@@ -4,6 +4,26 @@
 #include "define.h"
 #include "imports.h"
 
+/*
+ * The number of bytes processed by a single step of the 64-bit hash.
+ */
+#define DBS_HASH64_BLOCK       32
+
+
+/*
+ * The state of an incremental 64-bit hash. Every step mixes four 8-byte
+ * lanes into four independent accumulators, which are merged at the end.
+ * Bytes which don't fill a whole block yet are kept in the buffer.
+ */
+struct dbs_hash64_state {
+	u64                          acc[4];
+	u64                          seed;
+	u64                          total;
+	u8                           buf[DBS_HASH64_BLOCK];
+	s32                          buf_len;
+};
+
+
 /*
  * Hash a buffer.
  *
@@ -14,4 +34,73 @@
  */
 DBS_API u64 dbs_hash(u8 *buf, s32 len);
 
+
+/*
+ * Get a seed for the 64-bit hash, which differs between calls and between
+ * runs of the program. It is not suitable for cryptography, but keeps the
+ * hash values from being predicted easily.
+ *
+ * Returns: The seed
+ */
+DBS_API u64 dbs_hash_seed(void);
+
+
+/*
+ * Hash a buffer with a seed, using 8 bytes of the buffer at a time. The same
+ * buffer and seed always result in the same hash value, independent of the
+ * byte order of the machine.
+ *
+ * @buf: A buffer containing the data
+ * @len: The number of bytes to hash from the buffer
+ * @seed: The seed
+ *
+ * Returns: The hash value
+ */
+DBS_API u64 dbs_hash64(u8 *buf, u64 len, u64 seed);
+
+
+/*
+ * Hash exactly 4, 8 or 16 bytes with a seed. These return the same hash value
+ * as dbs_hash64() with the same length, but without any loop or branch.
+ *
+ * @buf: A buffer containing the data
+ * @seed: The seed
+ *
+ * Returns: The hash value
+ */
+DBS_API u64 dbs_hash64_4(u8 *buf, u64 seed);
+DBS_API u64 dbs_hash64_8(u8 *buf, u64 seed);
+DBS_API u64 dbs_hash64_16(u8 *buf, u64 seed);
+
+
+/*
+ * Start an incremental hash. Hashing the parts of a buffer one after another
+ * results in the same hash value as dbs_hash64() on the whole buffer.
+ *
+ * @st: Pointer to the state
+ * @seed: The seed
+ */
+DBS_API void dbs_hash64_init(struct dbs_hash64_state *st, u64 seed);
+
+
+/*
+ * Add bytes to an incremental hash.
+ *
+ * @st: Pointer to the state
+ * @buf: A buffer containing the data
+ * @len: The number of bytes to hash from the buffer
+ */
+DBS_API void dbs_hash64_update(struct dbs_hash64_state *st, u8 *buf, u64 len);
+
+
+/*
+ * Get the hash value of all bytes added to an incremental hash. The state is
+ * left unchanged, so more bytes can still be added afterwards.
+ *
+ * @st: Pointer to the state
+ *
+ * Returns: The hash value
+ */
+DBS_API u64 dbs_hash64_final(struct dbs_hash64_state *st);
+
 #endif
@@ -2,50 +2,95 @@
 
 #include "../../alarm/inc/alarm.h"
 
+#include <sched.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 
+/*
+ * Get the size of the nodes of a tree, which is smaller for a lean tree, as
+ * the cross pointers are left out, and for a tree without cross lists, as
+ * the entries are left out.
+ */
+static s32 dbs_christree_node_size(struct dbs_christree *tree)
+{
+	if(tree->flags & DBS_CHRISTREE_LEAN)
+		return offsetof(struct dbs_christree_node, h_v_prev);
+
+	if(!(tree->flags & DBS_CHRISTREE_CROSS))
+		return offsetof(struct dbs_christree_node, cross);
+
+	return sizeof(struct dbs_christree_node);
+}
+
+
 DBS_API struct dbs_christree *dbs_christree_init(s32 lim)
+{
+	return dbs_christree_init_flags(lim, 0);
+}
+
+
+DBS_API struct dbs_christree *dbs_christree_init_flags(s32 lim, u32 flags)
 {
 	struct dbs_christree *tree;
 	s32 tmp;
 	s32 i;
 
+	if((flags & DBS_CHRISTREE_LEAN) && (flags & DBS_CHRISTREE_CROSS)) {
+		ALARM(ALARM_WARN, "lean tree can't have cross lists");
+		goto err_return;
+	}
+
 	/*
 	 * Allocate memory for the tree.
 	 */
 	if(!(tree = smalloc(sizeof(struct dbs_christree))))
 		goto err_return;
 
+	tree->flags = flags;
+
 	/*
-	 * Allocate memory for the root node and initialize it.
-	 * Also psreallocate memory for the first few few branch nodes.
+	 * Initialize the slabs for the nodes, the different kinds of v_next
+	 * lists and the cross list entries.
 	 */
+	dbs_slab_init(&tree->node_slab, dbs_christree_node_size(tree));
+	dbs_slab_init(&tree->next_slab[0], sizeof(struct dbs_christree_n4));
+	dbs_slab_init(&tree->next_slab[1], sizeof(struct dbs_christree_n16));
+	dbs_slab_init(&tree->next_slab[2], sizeof(struct dbs_christree_n48));
+	dbs_slab_init(&tree->next_slab[3], sizeof(struct dbs_christree_n256));
+	dbs_slab_init(&tree->cross_slab, sizeof(struct dbs_christree_cross));
+
+	tree->epoch = NULL;
+	tree->main = NULL;
+	tree->handle = NULL;
+	tree->used = 1;
+	tree->index = NULL;
 
-	if(!(tree->root = dbs_christree_new(-1, 0)))
+	/*
+	 * Allocate memory for the root node and initialize it.
+	 */
+	if(!(tree->root = dbs_christree_new(tree, -1, 0)))
 		goto err_free_tree;
 
 	/*
-	 * Create and initialize the layers.
+	 * Create the table of layers, which are allocated once they are used.
 	 */
 	tree->layer_num = lim;
-	tmp = tree->layer_num * sizeof(struct dbs_christree_layer);
+	tree->layer_used = 0;
+	tree->layer_lock = 0;
+	tmp = tree->layer_num * sizeof(struct dbs_christree_layer *);
 	if(!(tree->layer = smalloc(tmp)))
 		goto err_del_root;
 
-	for(i = 0; i < tree->layer_num; i++) {
-		tree->layer[i].layer_num = i;
-		tree->layer[i].node = NULL;
-		tree->layer[i].node_num = 0;
-		tree->layer[i].count = 0;
-	}
+	for(i = 0; i < tree->layer_num; i++)
+		tree->layer[i] = NULL;
 
 	return tree;
 
 err_del_root:
-	dbs_christree_del(tree->root);
+	dbs_slab_release(&tree->node_slab);
 
 err_free_tree:
 	sfree(tree);
@@ -56,27 +101,69 @@ err_return:
 }
 
 
+/*
+ * Release the slabs of a tree, which frees all nodes, v_next lists and cross
+ * list entries at once.
+ */
+static void dbs_christree_release(struct dbs_christree *tree)
+{
+	s32 i;
+
+	dbs_slab_release(&tree->node_slab);
+
+	for(i = 0; i < 4; i++)
+		dbs_slab_release(&tree->next_slab[i]);
+
+	dbs_slab_release(&tree->cross_slab);
+}
+
+
 DBS_API void dbs_christree_close(struct dbs_christree *tree)
 {
-	if(!tree) {
-		ALARM(ALARM_WARN, "tree undefined");
+	struct dbs_christree *wr;
+	struct dbs_christree *next;
+	s32 i;
+
+	if(!tree || tree->main) {
+		ALARM(ALARM_WARN, "tree undefined or a writer handle");
 		return;
 	}
 
 	/*
-	 * Remove all nodes from the tree, except the root node. 
+	 * Free the layers list.
 	 */
+	for(i = 0; i < tree->layer_used; i++)
+		sfree(tree->layer[i]);
 
+	sfree(tree->layer);
 
 	/*
-	 * Free the layers list.
+	 * Retired objects may have been returned to the slab of any writer,
+	 * so all of them are flushed before the first slab is released.
 	 */
-	sfree(tree->layer);
+	if(tree->epoch) {
+		dbs_epoch_writer_release(&tree->ew);
+		for(wr = tree->handle; wr; wr = wr->handle)
+			dbs_epoch_writer_release(&wr->ew);
+
+		dbs_epoch_close(tree->epoch);
+	}
+
+	wr = tree->handle;
+	while(wr) {
+		next = wr->handle;
+		dbs_christree_release(wr);
+		sfree(wr);
+		wr = next;
+	}
 
 	/*
-	 * Delete the root node.
+	 * Release all nodes and v_next lists at once.
 	 */
-	dbs_christree_del(tree->root);
+	dbs_christree_release(tree);
+
+	if(tree->index)
+		dbs_hashmap_close(tree->index);
 
 	/*
 	 * Free the table struct.
@@ -85,615 +172,5087 @@ DBS_API void dbs_christree_close(struct dbs_christree *tree)
 }
 
 
-DBS_API struct dbs_christree_node *dbs_christree_new(s32 layer, u8 dif)
+DBS_API s8 dbs_christree_share(struct dbs_christree *tree, s32 reader_num)
 {
-	struct dbs_christree_node *node;
-	s32 tmp;
-	s32 i;
+	if(!tree || reader_num < 1) {
+		ALARM(ALARM_WARN, "tree undefined or reader_num invalid");
+		return -1;
+	}
+
+	if(tree->epoch || tree->main) {
+		ALARM(ALARM_WARN, "tree already shared");
+		return -1;
+	}
+
+	if(tree->index) {
+		ALARM(ALARM_WARN, "tree indexed");
+		return -1;
+	}
 
 	/*
-	 * Allocate memory for the new node.
+	 * The tree itself takes one more slot for its writer.
 	 */
-	if(!(node = smalloc(sizeof(struct dbs_christree_node))))
+	if(!(tree->epoch = dbs_epoch_init(reader_num + 1)))
 		goto err_return;
 
-	node->layer = layer;
-	node->dif = dif;
-	node->data = NULL;
+	if(dbs_epoch_writer_init(&tree->ew, tree->epoch) < 0)
+		goto err_close_epoch;
 
-	node->h_v_prev = NULL;
-	node->h_v_next = NULL;
+	return 0;
 
-	node->v_prev = NULL;
+err_close_epoch:
+	dbs_epoch_close(tree->epoch);
+	tree->epoch = NULL;
 
-	node->v_next_used = 0;
-	node->v_next_alloc = DBS_CHRISTREE_NEXT_MIN;
+err_return:
+	ALARM(ALARM_ERR, "Failed to share tree");
+	return -1;
+}
+
+
+DBS_API struct dbs_christree *dbs_christree_writer_open(
+		struct dbs_christree *tree)
+{
+	struct dbs_christree *wr;
+	s32 exp;
+
+	if(!tree || !tree->epoch || tree->main) {
+		ALARM(ALARM_WARN, "tree undefined or not shared");
+		return NULL;
+	}
 
 	/*
-	 * Preallocate memory for the v_next nodes and reset the pointers.
+	 * Reuse a closed handle if there is one.
 	 */
+	for(wr = DBS_LOAD(tree->handle); wr; wr = wr->handle) {
+		exp = 0;
+		if(__atomic_compare_exchange_n(&wr->used, &exp, 1, 0,
+					__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			return wr;
+	}
 
-	tmp = node->v_next_alloc * sizeof(struct dbs_christree_node *);
-	if(!(node->v_next = smalloc(tmp)))
-		goto err_free_node;
+	if(!(wr = smalloc(sizeof(struct dbs_christree))))
+		goto err_return;
 
-	for(i = 0; i < node->v_next_alloc; i++)
-		node->v_next[i] = NULL;
+	/*
+	 * The handle shares the nodes and layers with the tree, but takes new
+	 * nodes, v_next lists and cross list entries from slabs of its own.
+	 */
+	wr->root = tree->root;
+	wr->layer = tree->layer;
+	wr->layer_num = tree->layer_num;
+	wr->flags = tree->flags;
+	wr->epoch = tree->epoch;
+	wr->index = NULL;
 
-	return node;
+	/*
+	 * The used layers are only counted on the tree itself.
+	 */
+	wr->layer_used = 0;
+	wr->layer_lock = 0;
+
+	dbs_slab_init(&wr->node_slab, dbs_christree_node_size(wr));
+	dbs_slab_init(&wr->next_slab[0], sizeof(struct dbs_christree_n4));
+	dbs_slab_init(&wr->next_slab[1], sizeof(struct dbs_christree_n16));
+	dbs_slab_init(&wr->next_slab[2], sizeof(struct dbs_christree_n48));
+	dbs_slab_init(&wr->next_slab[3], sizeof(struct dbs_christree_n256));
+	dbs_slab_init(&wr->cross_slab, sizeof(struct dbs_christree_cross));
+
+	if(dbs_epoch_writer_init(&wr->ew, wr->epoch) < 0)
+		goto err_free_wr;
+
+	wr->main = tree;
+	wr->used = 1;
+
+	/*
+	 * Push the handle to the list of the tree.
+	 */
+	wr->handle = DBS_LOAD(tree->handle);
+	while(!__atomic_compare_exchange_n(&tree->handle, &wr->handle, wr, 0,
+				__ATOMIC_RELEASE, __ATOMIC_RELAXED));
 
+	return wr;
 
-err_free_node:
-	sfree(node);
+err_free_wr:
+	sfree(wr);
 
 err_return:
-	ALARM(ALARM_ERR, "Failed to create stress tree node");
+	ALARM(ALARM_ERR, "Failed to open writer");
 	return NULL;
 }
 
 
-DBS_API void dbs_christree_del(struct dbs_christree_node *node)
+DBS_API void dbs_christree_writer_close(struct dbs_christree *wr)
 {
-	if(!node) {
-		ALARM(ALARM_WARN, "node undefined");
+	if(!wr || !wr->main) {
+		ALARM(ALARM_WARN, "wr undefined or not a writer handle");
 		return;
 	}
 
-	sfree(node->v_prev);
+	DBS_STORE(wr->used, 0);
+}
+
 
-	sfree(node->v_next);
+DBS_API struct dbs_epoch_reader *dbs_christree_reader_open(
+		struct dbs_christree *tree)
+{
+	if(!tree || !tree->epoch) {
+		ALARM(ALARM_WARN, "tree undefined or not shared");
+		return NULL;
+	}
 
-	sfree(node);
+	return dbs_epoch_reader_open(tree->epoch);
 }
 
 
-DBS_API s32 dbs_christree_get_layer(struct dbs_christree *tree,
-		s32 layer, u8 dif, struct dbs_christree_node **lst, s32 lim)
+/*
+ * Return an object to one of the slabs of the tree. If the tree is shared,
+ * the object is retired instead, as readers may still be using it.
+ */
+static void dbs_christree_free(struct dbs_christree *tree,
+		struct dbs_slab *slab, void *ptr)
 {
-	struct dbs_christree_node *n_ptr;
-	s32 c = 0;
+	if(tree->epoch)
+		dbs_epoch_retire(&tree->ew, slab, ptr);
+	else
+		dbs_slab_free(slab, ptr);
+}
 
-	if(!tree || !lst || lim < 1) {
-		ALARM(ALARM_WARN, "layer or lst undefined or lim invalid");
-		return -1;
-	}
 
-	n_ptr = tree->layer[layer].node;
-	while(n_ptr) {
-		if(n_ptr->dif == dif) {
-			lst[c] = n_ptr;
-			c++;
-		}
+/*
+ * Read the version of a node. A writer walking through a node only needs its
+ * version, if it locks the node later on. While the tree isn't shared, the
+ * version is always 0.
+ */
+static u32 dbs_christree_vers(struct dbs_christree *tree,
+		struct dbs_christree_node *n)
+{
+	if(!tree->epoch)
+		return 0;
 
-		if(c >= lim)
-			break;
+	return DBS_LOAD(n->vers);
+}
 
-		n_ptr = n_ptr->h_v_next;
-	}
 
-	return c;
+/*
+ * Lock a node, if it still has the version read before.
+ *
+ * Returns: 0 if the node has been locked or -1 if it has been changed or
+ *          removed in the meantime, or another writer holds the lock
+ */
+static s8 dbs_christree_lock(struct dbs_christree *tree,
+		struct dbs_christree_node *n, u32 v)
+{
+	if(!tree->epoch)
+		return 0;
+
+	if(v & (DBS_CHRISTREE_LOCKED | DBS_CHRISTREE_OBSOLETE))
+		return -1;
+
+	if(!__atomic_compare_exchange_n(&n->vers, &v, v | DBS_CHRISTREE_LOCKED,
+				0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return -1;
+
+	return 0;
 }
 
 
-DBS_API s8 dbs_christree_add_v_prev(struct dbs_christree_node *node,
-		struct dbs_christree_node *v_prev)
+/*
+ * Wait until a node can be locked.
+ *
+ * Returns: 0 if the node has been locked or -1 if it has been removed
+ */
+static s8 dbs_christree_lock_wait(struct dbs_christree *tree,
+		struct dbs_christree_node *n)
 {
-	if(!node || !v_prev) {
-		ALARM(ALARM_WARN, "node or v_prev undefined");
-		return -1;
+	u32 v;
+
+	while(1) {
+		v = dbs_christree_vers(tree, n);
+		if(v & DBS_CHRISTREE_OBSOLETE)
+			return -1;
+
+		if(dbs_christree_lock(tree, n, v) == 0)
+			return 0;
+
+		sched_yield();
 	}
+}
 
-	node->v_prev = v_prev;
 
-	return 0;
+/*
+ * Unlock a node and advance its version. A node which has been removed from
+ * the tree is marked obsolete.
+ */
+static void dbs_christree_unlock(struct dbs_christree *tree,
+		struct dbs_christree_node *n, s8 obsolete)
+{
+	u32 v;
+
+	if(!tree->epoch)
+		return;
+
+	v = (DBS_LOAD(n->vers) & ~DBS_CHRISTREE_LOCKED) + DBS_CHRISTREE_VERS_INC;
+	if(obsolete)
+		v |= DBS_CHRISTREE_OBSOLETE;
+
+	DBS_STORE(n->vers, v);
 }
 
 
-DBS_API void dbs_christree_rmv_v_prev(struct dbs_christree_node *node)
+/*
+ * Lock and unlock the lists of a character on a layer, while the tree is
+ * shared. The lock is only held while relinking a list, so no other lock is
+ * ever taken while holding it.
+ */
+static void dbs_christree_lock_list(struct dbs_christree *tree, s32 layer,
+		u8 c)
 {
-	if(!node) {
-		ALARM(ALARM_WARN, "node undefined");
+	u8 *lock = &tree->layer[layer]->lock[c];
+
+	if(!tree->epoch)
 		return;
-	}
 
-	node->v_prev = NULL;
+	while(__atomic_test_and_set(lock, __ATOMIC_ACQUIRE))
+		sched_yield();
+}
+
+static void dbs_christree_unlock_list(struct dbs_christree *tree, s32 layer,
+		u8 c)
+{
+	if(tree->epoch)
+		__atomic_clear(&tree->layer[layer]->lock[c], __ATOMIC_RELEASE);
 }
 
 
-DBS_API s8 dbs_christree_add_v_next(struct dbs_christree_node *node,
-		struct dbs_christree_node *v_next)
+/*
+ * Allocate the layers down to the given depth, if they don't exist yet. A new
+ * layer is published with a single store after it has been initialized, so
+ * readers either see all of it or nothing.
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+static s8 dbs_christree_grow(struct dbs_christree *tree, s32 depth)
 {
-	struct dbs_christree_node **p;
-	s32 alloc;
-	s32 tmp;
+	struct dbs_christree_layer *layer;
 	s32 i;
 	s32 j;
 
-	if(!node || !v_next) {
-		ALARM(ALARM_WARN, "node or v_next undefined");
-		return -1;
-	}
-
 	/*
-	 * Check if there's space left in the v_next list, and if not, allocate
-	 * more.
+	 * The used layers are counted on the tree a handle belongs to.
 	 */
-	if(node->v_next_used + 1 >= node->v_next_alloc) {
-		alloc = node->v_next_alloc * 2;
-		tmp = alloc * sizeof(struct dbs_christree_node *);
-		if(!(p = srealloc(node->v_next, tmp)))
-			goto err_return;
+	if(tree->main)
+		tree = tree->main;
 
-		for(i = node->v_next_alloc; i < alloc; i++)
-			p[i] = NULL;
+	if(depth <= DBS_LOAD(tree->layer_used))
+		return 0;
 
-		node->v_next = p;
-		node->v_next_alloc = alloc;
+	if(tree->epoch) {
+		while(__atomic_test_and_set(&tree->layer_lock, __ATOMIC_ACQUIRE))
+			sched_yield();
 	}
 
-	for(i = 0; i < node->v_next_alloc; i++) {
-		/*
-		 * If there's a free slot, use it.
-		 */
-		if(node->v_next[i] == NULL) {
+	for(i = tree->layer_used; i < depth; i++) {
+		if(!(layer = smalloc(sizeof(struct dbs_christree_layer))))
+			break;
 
-			node->v_next[i] = v_next;
-			node->v_next_used++;
-			return 0;
+		layer->layer_num = i;
+		for(j = 0; j < 256; j++) {
+			layer->node[j] = NULL;
+			layer->cross[j] = NULL;
+			layer->lock[j] = 0;
 		}
 
-		/*
-		 * If the v_next element is bigger than the one we want to insert,
-		 * then move all the following ones a slot back and overwrite
-		 * the slot with the given node.
-		 */
-		if(node->v_next[i]->dif > v_next->dif) {
-			for(j = node->v_next_used; j > i ; j--)
-				node->v_next[j] = node->v_next[j - 1];
-
-			node->v_next[i] = v_next;
-			node->v_next_used++;
+		layer->covered = 0;
 
-			return 0;
-		}
+		DBS_STORE(tree->layer[i], layer);
+		DBS_STORE(tree->layer_used, i + 1);
 	}
 
-err_return:
-	ALARM(ALARM_ERR, "Failed to link v_next element");
-	return -1;
+	if(tree->epoch)
+		__atomic_clear(&tree->layer_lock, __ATOMIC_RELEASE);
+
+	return i < depth ? -1 : 0;
 }
 
 
-DBS_API void dbs_christree_rmv_v_next(struct dbs_christree_node *node,
-		struct dbs_christree_node *v_next)
+/*
+ * Get the first node of a layer list, while other writers may be changing the
+ * tree. Layers, which haven't been allocated yet, are empty.
+ */
+static struct dbs_christree_node *dbs_christree_list(
+		struct dbs_christree *tree, s32 layer, s32 dif)
 {
-	s32 i;
-	s32 j;
+	struct dbs_christree_layer *l = DBS_LOAD(tree->layer[layer]);
 
-	if(!node || !v_next) {
-		ALARM(ALARM_WARN, "node or v_next undefined");
-		return;
-	}
+	return l ? DBS_LOAD(l->node[dif]) : NULL;
+}
 
-	for(i = 0; i < node->v_next_used; i++) {
-		if(node->v_next[i]->dif == v_next->dif) {
-			/*
-			 * Move all pointers on slot up.
-			 */
-			for(j = i + 1; j < node->v_next_used; j++)
-				node->v_next[j - 1] = node->v_next[j];
 
-			node->v_next[node->v_next_used - 1] = NULL;
+/*
+ * Get the first entry of a cross list, like dbs_christree_list().
+ */
+static struct dbs_christree_cross *dbs_christree_cross_list(
+		struct dbs_christree *tree, s32 layer, s32 c)
+{
+	struct dbs_christree_layer *l = DBS_LOAD(tree->layer[layer]);
 
-			/*
-			 * Decrement number of pointers.
-			 */
-			node->v_next_used--;
-			return;
-		}
-	}
+	return l ? DBS_LOAD(l->cross[c]) : NULL;
 }
 
 
-DBS_API struct dbs_christree_node *dbs_christree_get_v_next(struct dbs_christree_node *n,
-		u8 dif)
+DBS_API struct dbs_christree_node *dbs_christree_new(struct dbs_christree *tree,
+		s32 layer, u8 dif)
 {
-	s32 i;
+	struct dbs_christree_node *node;
 
-	if(!n) {
-		ALARM(ALARM_WARN, "n undefined");
-		return NULL;
-	}
+	/*
+	 * Take the memory for the new node from the slab.
+	 */
+	if(!(node = dbs_slab_alloc(&tree->node_slab)))
+		goto err_return;
 
-	for(i = 0; i < n->v_next_used; i++) {
-		if(!n->v_next[i])
-			continue;
+	DBS_INSTR_COUNT(DBS_INSTR_ALLOC, 1);
+
+	node->layer = layer;
+	node->dif = dif;
+	node->pref_len = 0;
+	node->vers = 0;
+	node->data = NULL;
 
-		if(n->v_next[i]->dif == dif)
-			return n->v_next[i];
+	if(!(tree->flags & DBS_CHRISTREE_LEAN)) {
+		node->h_v_prev = NULL;
+		node->h_v_next = NULL;
 	}
 
+	if(tree->flags & DBS_CHRISTREE_CROSS)
+		node->cross = NULL;
+
+	node->v_prev = NULL;
+
+	/*
+	 * The v_next list will only be allocated once the first child is
+	 * added.
+	 */
+	node->v_next = NULL;
+	node->v_next_used = 0;
+	node->v_next_alloc = 0;
+
+	return node;
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to create stress tree node");
 	return NULL;
 }
 
 
-DBS_API s8 dbs_christree_link_hori(struct dbs_christree *tree,
+DBS_API void dbs_christree_del(struct dbs_christree *tree,
 		struct dbs_christree_node *node)
 {
-	struct dbs_christree_layer *layer;
-	struct dbs_christree_node *n_ptr;
-	struct dbs_christree_node *n_h_v_prev;
-
-	if(!tree || !node || node->layer < 0) {
+	if(!tree || !node) {
 		ALARM(ALARM_WARN, "tree or node undefined");
-		return -1;
+		return;
 	}
 
-	layer = &tree->layer[node->layer];
-
-	node->layer_id = layer->count;
-	layer->count++;
-
 	/*
-	 * Check if there are nodes cross linked on the layer.
+	 * Return the v_next list and the node to the slabs.
 	 */
-	if(layer->node == NULL) {
-		layer->node = node;
+	if(node->v_next)
+		dbs_christree_free(tree, &tree->next_slab[node->v_next->type - 1],
+				node->v_next);
 
-		layer->node_num++;
-		return 0;
-	}
-	else {
-		/*
-		 * Otherwise, link it to the other nodes.
-		 */
-		n_ptr = layer->node;
-		n_h_v_prev = NULL;
-		while(n_ptr) {
-			if(n_ptr->dif > node->dif) {
-				if(n_ptr->h_v_prev == NULL) {
-					layer->node = node;
-
-					node->h_v_next = n_ptr;
-					n_ptr->h_v_prev = node;
-
-					layer->node_num++;
-					return 0;
-				}
-				else {
-					node->h_v_prev = n_ptr->h_v_prev;
-					node->h_v_next = n_ptr;
+	dbs_christree_free(tree, &tree->node_slab, node);
+}
 
-					(n_ptr->h_v_prev)->h_v_next = node;
-					n_ptr->h_v_prev = node;
 
-					layer->node_num++;
-					return 0;
-				}
-			}
+/*
+ * Get the number of layers covered by the path from the root down to and
+ * including the given node.
+ */
+static s32 dbs_christree_depth(struct dbs_christree_node *n)
+{
+	return n->layer + 1 + n->pref_len;
+}
 
-			n_h_v_prev = n_ptr;
-			n_ptr = n_ptr->h_v_next;
-		}
 
-		n_h_v_prev->h_v_next = node;
-		node->h_v_prev = n_h_v_prev;
+/*
+ * Check if the children of a node start on the last layer. These children
+ * could only ever be leaves holding nothing but a data pointer, so instead of
+ * nodes the v_next list of the node holds the data pointers themselves.
+ */
+static s8 dbs_christree_vals(struct dbs_christree *tree,
+		struct dbs_christree_node *n)
+{
+	return dbs_christree_depth(n) == tree->layer_num - 1;
+}
 
-		layer->node_num++;
-		return 0;
+
+DBS_API s8 dbs_christree_has_vals(struct dbs_christree *tree,
+		struct dbs_christree_node *n)
+{
+	if(!tree || !n) {
+		ALARM(ALARM_WARN, "tree or n undefined");
+		return -1;
 	}
 
-	return -1;
+	return dbs_christree_vals(tree, n);
 }
 
 
-DBS_API void dbs_christree_unlink_hori(struct dbs_christree *tree,
-		struct dbs_christree_node *node)
+/*
+ * Search a v_next list, which may be NULL, for the child with the given dif
+ * character.
+ */
+static struct dbs_christree_node *dbs_christree_find_list(
+		union dbs_christree_next *nxt, u8 dif)
 {
-	struct dbs_christree_layer *layer;
-	struct dbs_christree_node *n_ptr;
-
-	if(!tree || !node) {
-		ALARM(ALARM_WARN, "tree or node undefined");
-		return;
-	}
+	s32 l;
+	s32 r;
+	s32 m;
 
-	layer = &tree->layer[node->layer];
-	n_ptr = layer->node;
+	if(!nxt)
+		return NULL;
 
-	while(n_ptr) {
-		if(n_ptr->layer_id == node->layer_id) {
-			/*
-			 * Relink nodes.
-			 */
-			if(n_ptr->h_v_next) {
-				n_ptr->h_v_next->h_v_prev = n_ptr->h_v_prev;
+	switch(nxt->type) {
+		case DBS_CHRISTREE_N4:
+			for(l = 0; l < nxt->n4.num; l++) {
+				if(nxt->n4.key[l] == dif)
+					return DBS_LOAD(nxt->n4.ptr[l]);
 			}
+			return NULL;
 
-			if(n_ptr->h_v_prev == NULL) {
-				layer->node = n_ptr->h_v_next;
-			}
-			else {
-				n_ptr->h_v_prev->h_v_next = n_ptr->h_v_next;
+		case DBS_CHRISTREE_N16:
+			l = 0;
+			r = nxt->n16.num - 1;
+			while(l <= r) {
+				m = (l + r) / 2;
+
+				if(nxt->n16.key[m] == dif)
+					return DBS_LOAD(nxt->n16.ptr[m]);
+
+				if(nxt->n16.key[m] < dif)
+					l = m + 1;
+				else
+					r = m - 1;
 			}
+			return NULL;
 
-			/*
-			 * Decrement number of nodes in the layer.
-			 */
-			layer->node_num--;
+		case DBS_CHRISTREE_N48:
+			if(!(m = DBS_LOAD(nxt->n48.idx[dif])))
+				return NULL;
 
-			return;
-		}
+			return DBS_LOAD(nxt->n48.ptr[m - 1]);
 
-		n_ptr = n_ptr->h_v_next;
+		case DBS_CHRISTREE_N256:
+			return DBS_LOAD(nxt->n256.ptr[dif]);
 	}
+
+	return NULL;
 }
 
 
-DBS_API s8 dbs_christree_link_verti(struct dbs_christree_node *n,
-		struct dbs_christree_node *v_prev)
+/*
+ * Search the v_next list of a node for the child with the given dif
+ * character. This is the unchecked version used on the lookup paths, so the
+ * node has to be valid.
+ */
+static struct dbs_christree_node *dbs_christree_find(struct dbs_christree_node *n,
+		u8 dif)
 {
-	if(!n || !v_prev) {
-		ALARM(ALARM_WARN, "n or v_prev undefined");
-		return -1;
+	return dbs_christree_find_list(DBS_LOAD(n->v_next), dif);
+}
+
+
+/*
+ * Get the child with the smallest dif character, which is equal to or bigger
+ * than the given one, and write its dif character back. Like
+ * dbs_christree_find(), the node has to be valid.
+ */
+static struct dbs_christree_node *dbs_christree_ceil(struct dbs_christree_node *n,
+		s32 *dif)
+{
+	union dbs_christree_next *nxt = DBS_LOAD(n->v_next);
+	struct dbs_christree_node *n_ptr;
+	s32 i;
+	s32 m;
+
+	if(!nxt)
+		return NULL;
+
+	switch(nxt->type) {
+		case DBS_CHRISTREE_N4:
+			for(i = 0; i < nxt->n4.num; i++) {
+				if(nxt->n4.key[i] >= *dif) {
+					*dif = nxt->n4.key[i];
+					return DBS_LOAD(nxt->n4.ptr[i]);
+				}
+			}
+			break;
+
+		case DBS_CHRISTREE_N16:
+			for(i = 0; i < nxt->n16.num; i++) {
+				if(nxt->n16.key[i] >= *dif) {
+					*dif = nxt->n16.key[i];
+					return DBS_LOAD(nxt->n16.ptr[i]);
+				}
+			}
+			break;
+
+		case DBS_CHRISTREE_N48:
+			for(i = *dif; i < 256; i++) {
+				if((m = DBS_LOAD(nxt->n48.idx[i])) &&
+						(n_ptr = DBS_LOAD(nxt->n48.ptr[m - 1]))) {
+					*dif = i;
+					return n_ptr;
+				}
+			}
+			break;
+
+		case DBS_CHRISTREE_N256:
+			for(i = *dif; i < 256; i++) {
+				if((n_ptr = DBS_LOAD(nxt->n256.ptr[i]))) {
+					*dif = i;
+					return n_ptr;
+				}
+			}
+			break;
+	}
+
+	return NULL;
+}
+
+
+/*
+ * Get the next child of a node while walking through the v_next list in
+ * ascending order. The iterator is the smallest dif character to continue
+ * with, so it stays valid, even if the v_next list is replaced in between.
+ * It has to start at 0 and is advanced by every call.
+ */
+static struct dbs_christree_node *dbs_christree_iter(struct dbs_christree_node *n,
+		s32 *it)
+{
+	struct dbs_christree_node *n_ptr;
+	s32 dif = *it;
+
+	if(!(n_ptr = dbs_christree_ceil(n, &dif))) {
+		*it = 256;
+		return NULL;
+	}
+
+	*it = dif + 1;
+	return n_ptr;
+}
+
+
+/*
+ * Collect the nodes with the given dif character in a layer by walking the
+ * tree down from the root, for trees without layer lists. Branches are only
+ * followed as long as they end above the layer.
+ *
+ * Returns: The number of nodes written to the list or -1 if an error occurred
+ */
+static s32 dbs_christree_walk_layer(struct dbs_christree *tree, s32 layer,
+		u8 dif, struct dbs_christree_node **lst, s32 lim)
+{
+	struct dbs_christree_frame *stk;
+	struct dbs_christree_node *n;
+	s32 num = 1;
+	s32 c = 0;
+
+	if(!(stk = smalloc((layer + 2) * sizeof(struct dbs_christree_frame)))) {
+		ALARM(ALARM_ERR, "Failed to allocate stack");
+		return -1;
+	}
+
+	stk[0].node = tree->root;
+	stk[0].next = 0;
+
+	while(num > 0 && c < lim) {
+		if(!(n = dbs_christree_iter(stk[num - 1].node, &stk[num - 1].next))) {
+			num--;
+			continue;
+		}
+
+		DBS_INSTR_COUNT(DBS_INSTR_VISIT, 1);
+
+		if(n->layer == layer) {
+			if(n->dif == dif)
+				lst[c++] = n;
+
+			continue;
+		}
+
+		if(n->layer + n->pref_len >= layer || dbs_christree_vals(tree, n))
+			continue;
+
+		stk[num].node = n;
+		stk[num].next = 0;
+		num++;
+	}
+
+	sfree(stk);
+	return c;
+}
+
+
+DBS_API s32 dbs_christree_get_layer(struct dbs_christree *tree,
+		s32 layer, u8 dif, struct dbs_christree_node **lst, s32 lim)
+{
+	struct dbs_christree_node *n_ptr;
+	s32 c = 0;
+
+	if(!tree || !lst || lim < 1) {
+		ALARM(ALARM_WARN, "layer or lst undefined or lim invalid");
+		return -1;
+	}
+
+	if(layer < 0 || layer >= tree->layer_num)
+		return 0;
+
+	if(tree->flags & DBS_CHRISTREE_LEAN) {
+		c = dbs_christree_walk_layer(tree, layer, dif, lst, lim);
+		DBS_INSTR_COUNT(DBS_INSTR_LAYER, 1);
+		DBS_INSTR_COUNT(DBS_INSTR_CAND, c > 0 ? c : 0);
+		return c;
+	}
+
+	/*
+	 * All nodes in the list for the dif character match.
+	 */
+	n_ptr = dbs_christree_list(tree, layer, dif);
+	while(n_ptr && c < lim) {
+		lst[c] = n_ptr;
+		c++;
+
+		n_ptr = DBS_LOAD(n_ptr->h_v_next);
+	}
+
+	DBS_INSTR_COUNT(DBS_INSTR_LAYER, 1);
+	DBS_INSTR_COUNT(DBS_INSTR_CAND, c);
+	return c;
+}
+
+
+DBS_API s8 dbs_christree_add_v_prev(struct dbs_christree_node *node,
+		struct dbs_christree_node *v_prev)
+{
+	if(!node || !v_prev) {
+		ALARM(ALARM_WARN, "node or v_prev undefined");
+		return -1;
+	}
+
+	node->v_prev = v_prev;
+
+	return 0;
+}
+
+
+DBS_API void dbs_christree_rmv_v_prev(struct dbs_christree_node *node)
+{
+	if(!node) {
+		ALARM(ALARM_WARN, "node undefined");
+		return;
+	}
+
+	node->v_prev = NULL;
+}
+
+
+/*
+ * The number of slots for each kind of v_next list.
+ */
+static const s32 dbs_christree_next_cap[] = {0, 4, 16, 48, 256};
+
+/*
+ * The number of children at or below which a v_next list is shrunk to the
+ * next smaller kind. This is lower than the capacity of the smaller kind, so
+ * adding and removing the same child doesn't resize the list every time.
+ */
+static const s32 dbs_christree_next_shrink[] = {0, 0, 3, 12, 40};
+
+
+/*
+ * Get the smallest kind of v_next list, which can hold the given number of
+ * children.
+ */
+static u8 dbs_christree_next_type(s32 num)
+{
+	u8 type = DBS_CHRISTREE_N0;
+
+	while(dbs_christree_next_cap[type] < num)
+		type++;
+
+	return type;
+}
+
+
+/*
+ * Write all children of a node to the list, sorted by their dif character,
+ * and their dif characters to the key array.
+ *
+ * Returns: The number of children written to the list
+ */
+static s32 dbs_christree_next_list(struct dbs_christree_node *n,
+		u8 *key, struct dbs_christree_node **lst)
+{
+	union dbs_christree_next *nxt = n->v_next;
+	s32 c = 0;
+	s32 i;
+
+	if(!nxt)
+		return 0;
+
+	switch(nxt->type) {
+		case DBS_CHRISTREE_N4:
+			for(; c < nxt->n4.num; c++) {
+				key[c] = nxt->n4.key[c];
+				lst[c] = nxt->n4.ptr[c];
+			}
+			break;
+
+		case DBS_CHRISTREE_N16:
+			for(; c < nxt->n16.num; c++) {
+				key[c] = nxt->n16.key[c];
+				lst[c] = nxt->n16.ptr[c];
+			}
+			break;
+
+		case DBS_CHRISTREE_N48:
+			for(i = 0; i < 256; i++) {
+				if(nxt->n48.idx[i]) {
+					key[c] = i;
+					lst[c++] = nxt->n48.ptr[nxt->n48.idx[i] - 1];
+				}
+			}
+			break;
+
+		case DBS_CHRISTREE_N256:
+			for(i = 0; i < 256; i++) {
+				if(nxt->n256.ptr[i]) {
+					key[c] = i;
+					lst[c++] = nxt->n256.ptr[i];
+				}
+			}
+			break;
+	}
+
+	return c;
+}
+
+
+/*
+ * Replace the v_next list of a node with a list of the given kind, containing
+ * the children from the sorted list with the dif characters from the key
+ * array. The new list is filled completely, before it is published with a
+ * single store.
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+static s8 dbs_christree_next_fill(struct dbs_christree *tree,
+		struct dbs_christree_node *n, u8 type, u8 *key,
+		struct dbs_christree_node **lst, s32 num)
+{
+	union dbs_christree_next *nxt = NULL;
+	union dbs_christree_next *old = n->v_next;
+	s32 i;
+
+	if(type != DBS_CHRISTREE_N0) {
+		if(!(nxt = dbs_slab_alloc(&tree->next_slab[type - 1])))
+			return -1;
+
+		nxt->type = type;
+		nxt->n4.vals = dbs_christree_vals(tree, n);
+	}
+
+	switch(type) {
+		case DBS_CHRISTREE_N4:
+			for(i = 0; i < num; i++) {
+				nxt->n4.key[i] = key[i];
+				nxt->n4.ptr[i] = lst[i];
+			}
+			nxt->n4.num = num;
+			break;
+
+		case DBS_CHRISTREE_N16:
+			for(i = 0; i < num; i++) {
+				nxt->n16.key[i] = key[i];
+				nxt->n16.ptr[i] = lst[i];
+			}
+			nxt->n16.num = num;
+			break;
+
+		case DBS_CHRISTREE_N48:
+			memset(nxt->n48.idx, 0, 256);
+			for(i = 0; i < 48; i++)
+				nxt->n48.ptr[i] = i < num ? lst[i] : NULL;
+
+			for(i = 0; i < num; i++)
+				nxt->n48.idx[key[i]] = i + 1;
+			break;
+
+		case DBS_CHRISTREE_N256:
+			for(i = 0; i < 256; i++)
+				nxt->n256.ptr[i] = NULL;
+
+			for(i = 0; i < num; i++)
+				nxt->n256.ptr[key[i]] = lst[i];
+			break;
+	}
+
+	DBS_STORE(n->v_next, nxt);
+	n->v_next_alloc = dbs_christree_next_cap[type];
+
+	if(old)
+		dbs_christree_free(tree, &tree->next_slab[old->type - 1], old);
+
+	return 0;
+}
+
+
+/*
+ * Replace the v_next list of a node with a list of the given kind, containing
+ * the same children, with the child for the dif character either added or
+ * removed.
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+static s8 dbs_christree_next_copy(struct dbs_christree *tree,
+		struct dbs_christree_node *n, u8 type, u8 dif,
+		struct dbs_christree_node *v_next, s8 add)
+{
+	struct dbs_christree_node *lst[256];
+	u8 key[256];
+	s32 num;
+	s32 i;
+	s32 j;
+
+	num = dbs_christree_next_list(n, key, lst);
+
+	if(add) {
+		for(i = num; i > 0 && key[i - 1] > dif; i--) {
+			key[i] = key[i - 1];
+			lst[i] = lst[i - 1];
+		}
+
+		key[i] = dif;
+		lst[i] = v_next;
+		num++;
+	}
+	else {
+		for(i = 0, j = 0; i < num; i++) {
+			if(key[i] != dif) {
+				key[j] = key[i];
+				lst[j++] = lst[i];
+			}
+		}
+
+		num = j;
+	}
+
+	return dbs_christree_next_fill(tree, n, type, key, lst, num);
+}
+
+
+/*
+ * Insert a pointer into a sorted key array and the matching pointer array.
+ */
+static void dbs_christree_next_ins(u8 *key, struct dbs_christree_node **ptr,
+		s32 used, u8 dif, struct dbs_christree_node *v_next)
+{
+	s32 i;
+
+	for(i = used; i > 0 && key[i - 1] > dif; i--) {
+		key[i] = key[i - 1];
+		ptr[i] = ptr[i - 1];
+	}
+
+	key[i] = dif;
+	ptr[i] = v_next;
+}
+
+
+/*
+ * Remove the pointer with the given dif character from a sorted key array
+ * and the matching pointer array.
+ */
+static void dbs_christree_next_del(u8 *key, struct dbs_christree_node **ptr,
+		s32 used, u8 dif)
+{
+	s32 i;
+
+	for(i = 0; i < used; i++) {
+		if(key[i] == dif)
+			break;
+	}
+
+	for(i = i + 1; i < used; i++) {
+		key[i - 1] = key[i];
+		ptr[i - 1] = ptr[i];
+	}
+}
+
+
+/*
+ * Add a child with the given dif character to the v_next list of a node,
+ * which is either a node or a data pointer.
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+static s8 dbs_christree_next_add(struct dbs_christree *tree,
+		struct dbs_christree_node *node, u8 dif,
+		struct dbs_christree_node *v_next)
+{
+	union dbs_christree_next *nxt = node->v_next;
+	u8 type;
+	s32 i;
+
+	/*
+	 * If there's no space left in the v_next list, the children are moved
+	 * to the next bigger kind. The sorted lists can't be changed in place
+	 * while readers may be searching them, so they are copied as well.
+	 */
+	type = nxt ? nxt->type : DBS_CHRISTREE_N0;
+	if(node->v_next_used >= node->v_next_alloc || (tree->epoch &&
+				type < DBS_CHRISTREE_N48)) {
+		if(node->v_next_used >= node->v_next_alloc)
+			type++;
+
+		if(dbs_christree_next_copy(tree, node, type, dif, v_next, 1) < 0)
+			goto err_return;
+
+		DBS_INSTR_COUNT(DBS_INSTR_GROW, 1);
+
+		node->v_next_used++;
+		return 0;
+	}
+
+	switch(nxt->type) {
+		case DBS_CHRISTREE_N4:
+			dbs_christree_next_ins(nxt->n4.key, nxt->n4.ptr,
+					node->v_next_used, dif, v_next);
+			nxt->n4.num++;
+			break;
+
+		case DBS_CHRISTREE_N16:
+			dbs_christree_next_ins(nxt->n16.key, nxt->n16.ptr,
+					node->v_next_used, dif, v_next);
+			nxt->n16.num++;
+			break;
+
+		case DBS_CHRISTREE_N48:
+			/*
+			 * Use the first free slot, which has to be set before
+			 * the index points to it.
+			 */
+			for(i = 0; nxt->n48.ptr[i]; i++);
+
+			DBS_STORE(nxt->n48.ptr[i], v_next);
+			DBS_STORE(nxt->n48.idx[dif], i + 1);
+			break;
+
+		case DBS_CHRISTREE_N256:
+			DBS_STORE(nxt->n256.ptr[dif], v_next);
+			break;
+	}
+
+	node->v_next_used++;
+	return 0;
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to link v_next element");
+	return -1;
+}
+
+
+DBS_API s8 dbs_christree_add_v_next(struct dbs_christree *tree,
+		struct dbs_christree_node *node, struct dbs_christree_node *v_next)
+{
+	if(!tree || !node || !v_next) {
+		ALARM(ALARM_WARN, "tree or node or v_next undefined");
+		return -1;
+	}
+
+	if(dbs_christree_vals(tree, node)) {
+		ALARM(ALARM_WARN, "node holds data pointers");
+		return -1;
+	}
+
+	return dbs_christree_next_add(tree, node, v_next->dif, v_next);
+}
+
+
+/*
+ * Remove the child with the given dif character from the v_next list of a
+ * node, which has to contain it.
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+static s8 dbs_christree_next_rmv(struct dbs_christree *tree,
+		struct dbs_christree_node *node, u8 dif)
+{
+	union dbs_christree_next *nxt;
+	u8 type;
+	s32 i;
+
+	/*
+	 * Shrink the list if it becomes too big. A slot of an indexed list
+	 * can't be reused while readers may still find the old child in it,
+	 * so only the direct list is changed in place then. If there's not
+	 * enough memory for the new list, the current one is changed, unless
+	 * readers may be searching it.
+	 */
+	nxt = node->v_next;
+	type = nxt->type;
+	if(node->v_next_used - 1 <= dbs_christree_next_shrink[type])
+		type--;
+
+	if(type != nxt->type || (tree->epoch && type < DBS_CHRISTREE_N256)) {
+		if(dbs_christree_next_copy(tree, node, type, dif, NULL, 0) == 0) {
+			node->v_next_used--;
+			return 0;
+		}
+
+		if(tree->epoch) {
+			ALARM(ALARM_ERR, "Failed to copy v_next list");
+			return -1;
+		}
+	}
+
+	switch(nxt->type) {
+		case DBS_CHRISTREE_N4:
+			dbs_christree_next_del(nxt->n4.key, nxt->n4.ptr,
+					node->v_next_used, dif);
+			nxt->n4.num--;
+			break;
+
+		case DBS_CHRISTREE_N16:
+			dbs_christree_next_del(nxt->n16.key, nxt->n16.ptr,
+					node->v_next_used, dif);
+			nxt->n16.num--;
+			break;
+
+		case DBS_CHRISTREE_N48:
+			i = nxt->n48.idx[dif] - 1;
+			DBS_STORE(nxt->n48.idx[dif], 0);
+			DBS_STORE(nxt->n48.ptr[i], NULL);
+			break;
+
+		case DBS_CHRISTREE_N256:
+			DBS_STORE(nxt->n256.ptr[dif], NULL);
+			break;
+	}
+
+	node->v_next_used--;
+	return 0;
+}
+
+
+DBS_API void dbs_christree_rmv_v_next(struct dbs_christree *tree,
+		struct dbs_christree_node *node, struct dbs_christree_node *v_next)
+{
+	if(!tree || !node || !v_next) {
+		ALARM(ALARM_WARN, "tree or node or v_next undefined");
+		return;
+	}
+
+	if(dbs_christree_vals(tree, node)) {
+		ALARM(ALARM_WARN, "node holds data pointers");
+		return;
+	}
+
+	if(dbs_christree_find(node, v_next->dif) != v_next)
+		return;
+
+	dbs_christree_next_rmv(tree, node, v_next->dif);
+}
+
+
+/*
+ * Check if the v_next list of a node holds data pointers. Unlike
+ * dbs_christree_vals(), this only needs the node, as the list carries a flag.
+ */
+static s8 dbs_christree_list_vals(struct dbs_christree_node *n)
+{
+	union dbs_christree_next *nxt = DBS_LOAD(n->v_next);
+
+	return nxt && nxt->n4.vals;
+}
+
+
+DBS_API struct dbs_christree_node *dbs_christree_get_v_next(struct dbs_christree_node *n,
+		u8 dif)
+{
+	if(!n) {
+		ALARM(ALARM_WARN, "n undefined");
+		return NULL;
+	}
+
+	if(dbs_christree_list_vals(n))
+		return NULL;
+
+	return dbs_christree_find(n, dif);
+}
+
+
+DBS_API struct dbs_christree_node *dbs_christree_ceil_v_next(struct dbs_christree_node *n,
+		s32 dif)
+{
+	if(!n) {
+		ALARM(ALARM_WARN, "n undefined");
+		return NULL;
+	}
+
+	if(dbs_christree_list_vals(n))
+		return NULL;
+
+	return dbs_christree_ceil(n, &dif);
+}
+
+
+DBS_API void *dbs_christree_get_val(struct dbs_christree *tree,
+		struct dbs_christree_node *n, u8 dif)
+{
+	if(!tree || !n) {
+		ALARM(ALARM_WARN, "tree or n undefined");
+		return NULL;
+	}
+
+	if(!dbs_christree_vals(tree, n))
+		return NULL;
+
+	return dbs_christree_find(n, dif);
+}
+
+
+DBS_API void *dbs_christree_ceil_val(struct dbs_christree *tree,
+		struct dbs_christree_node *n, s32 *dif)
+{
+	if(!tree || !n || !dif) {
+		ALARM(ALARM_WARN, "tree or n or dif undefined");
+		return NULL;
+	}
+
+	if(!dbs_christree_vals(tree, n))
+		return NULL;
+
+	return dbs_christree_ceil(n, dif);
+}
+
+
+/*
+ * Get the number of entries a compressed node has in the cross lists, which
+ * is one for every byte of its prefix, except for a byte on the last layer.
+ */
+static s32 dbs_christree_cross_num(struct dbs_christree *tree,
+		struct dbs_christree_node *node)
+{
+	s32 num = tree->layer_num - 2 - node->layer;
+
+	return num < node->pref_len ? num : node->pref_len;
+}
+
+
+/*
+ * Mark the layers covered by the prefix of a node. The flags are only set
+ * once, so the layers stay clean for the readers afterwards.
+ */
+static void dbs_christree_cover(struct dbs_christree *tree,
+		struct dbs_christree_node *node)
+{
+	struct dbs_christree_layer *layer;
+	s32 num = dbs_christree_cross_num(tree, node);
+	s32 i;
+
+	if(tree->flags & DBS_CHRISTREE_LEAN)
+		return;
+
+	for(i = 1; i <= num; i++) {
+		layer = tree->layer[node->layer + i];
+		if(!DBS_LOAD(layer->covered))
+			DBS_STORE(layer->covered, 1);
+	}
+}
+
+
+/*
+ * Put an entry in front of the cross list for a byte on a layer.
+ */
+static void dbs_christree_cross_link(struct dbs_christree *tree,
+		struct dbs_christree_cross *e, s32 layer, u8 c)
+{
+	struct dbs_christree_cross **head = &tree->layer[layer]->cross[c];
+
+	dbs_christree_lock_list(tree, layer, c);
+
+	e->h_v_prev = NULL;
+	e->h_v_next = *head;
+
+	if(*head)
+		(*head)->h_v_prev = e;
+
+	DBS_STORE(*head, e);
+
+	dbs_christree_unlock_list(tree, layer, c);
+}
+
+
+/*
+ * Remove an entry from the cross list for a byte on a layer and delete it.
+ * Like with the layer lists, the entry keeps pointing to the next one, so a
+ * reader standing on it can still continue through the list.
+ */
+static void dbs_christree_cross_unlink(struct dbs_christree *tree,
+		struct dbs_christree_cross *e, s32 layer, u8 c)
+{
+	dbs_christree_lock_list(tree, layer, c);
+
+	if(e->h_v_next)
+		e->h_v_next->h_v_prev = e->h_v_prev;
+
+	if(e->h_v_prev)
+		DBS_STORE(e->h_v_prev->h_v_next, e->h_v_next);
+	else
+		DBS_STORE(tree->layer[layer]->cross[c], e->h_v_next);
+
+	dbs_christree_unlock_list(tree, layer, c);
+
+	dbs_christree_free(tree, &tree->cross_slab, e);
+}
+
+
+/*
+ * Remove all entries of a node from the cross lists.
+ */
+static void dbs_christree_cross_rmv(struct dbs_christree *tree,
+		struct dbs_christree_node *node)
+{
+	struct dbs_christree_cross *e;
+	struct dbs_christree_cross *next;
+	s32 i;
+
+	if(!(tree->flags & DBS_CHRISTREE_CROSS))
+		return;
+
+	for(e = node->cross, i = 1; e; i++) {
+		next = e->link;
+		dbs_christree_cross_unlink(tree, e, node->layer + i,
+				node->pref[i - 1]);
+		e = next;
+	}
+
+	node->cross = NULL;
+}
+
+
+/*
+ * Add a node to the cross lists of all layers covered by its prefix.
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+static s8 dbs_christree_cross_add(struct dbs_christree *tree,
+		struct dbs_christree_node *node)
+{
+	struct dbs_christree_cross **pos = &node->cross;
+	struct dbs_christree_cross *e;
+	s32 num = dbs_christree_cross_num(tree, node);
+	s32 i;
+
+	if(!(tree->flags & DBS_CHRISTREE_CROSS))
+		return 0;
+
+	for(i = 1; i <= num; i++) {
+		if(!(e = dbs_slab_alloc(&tree->cross_slab)))
+			goto err_rmv;
+
+		e->node = node;
+		e->link = NULL;
+		*pos = e;
+		pos = &e->link;
+
+		dbs_christree_cross_link(tree, e, node->layer + i,
+				node->pref[i - 1]);
+	}
+
+	return 0;
+
+err_rmv:
+	dbs_christree_cross_rmv(tree, node);
+	return -1;
+}
+
+
+/*
+ * Hand the cross list entries of a node, which is split after the first len
+ * bytes of its prefix, over to the new upper and lower node. The entry for
+ * the layer of the dif character of the lower node is removed, as the lower
+ * node is in the layer list there. All other entries keep their place in the
+ * lists, so a reader going through a cross list never misses the branch.
+ */
+static void dbs_christree_cross_split(struct dbs_christree *tree,
+		struct dbs_christree_node *node, struct dbs_christree_node *n_upper,
+		struct dbs_christree_node *n_lower, s32 len)
+{
+	struct dbs_christree_cross **pos = &n_upper->cross;
+	struct dbs_christree_cross *e;
+	struct dbs_christree_cross *next;
+	s32 i;
+
+	if(!(tree->flags & DBS_CHRISTREE_CROSS))
+		return;
+
+	for(e = node->cross, i = 1; e; i++) {
+		next = e->link;
+
+		if(i == len + 1) {
+			*pos = NULL;
+			pos = &n_lower->cross;
+
+			dbs_christree_cross_unlink(tree, e, node->layer + i,
+					node->pref[i - 1]);
+		}
+		else {
+			DBS_STORE(e->node, i <= len ? n_upper : n_lower);
+			*pos = e;
+			pos = &e->link;
+		}
+
+		e = next;
+	}
+
+	*pos = NULL;
+}
+
+
+/*
+ * Hand the cross list entries of the only child of a node over to the node,
+ * which is merged with the child, and add an entry for the layer of the dif
+ * character of the child.
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+static s8 dbs_christree_cross_merge(struct dbs_christree *tree,
+		struct dbs_christree_node *node, struct dbs_christree_node *n_v_next)
+{
+	struct dbs_christree_cross **pos = &node->cross;
+	struct dbs_christree_cross *e;
+
+	if(!(tree->flags & DBS_CHRISTREE_CROSS))
+		return 0;
+
+	if(!(e = dbs_slab_alloc(&tree->cross_slab)))
+		return -1;
+
+	while(*pos)
+		pos = &(*pos)->link;
+
+	e->node = node;
+	e->link = n_v_next->cross;
+	*pos = e;
+
+	dbs_christree_cross_link(tree, e, n_v_next->layer, n_v_next->dif);
+
+	for(e = e->link; e; e = e->link)
+		e->node = node;
+
+	n_v_next->cross = NULL;
+	return 0;
+}
+
+
+/*
+ * Put a node in front of the layer list for its dif character.
+ */
+static void dbs_christree_list_add(struct dbs_christree *tree,
+		struct dbs_christree_node *node)
+{
+	struct dbs_christree_node **head;
+
+	if(tree->flags & DBS_CHRISTREE_LEAN)
+		return;
+
+	head = &tree->layer[node->layer]->node[node->dif];
+
+	dbs_christree_lock_list(tree, node->layer, node->dif);
+
+	node->h_v_prev = NULL;
+	node->h_v_next = *head;
+
+	if(*head)
+		(*head)->h_v_prev = node;
+
+	DBS_STORE(*head, node);
+
+	dbs_christree_unlock_list(tree, node->layer, node->dif);
+}
+
+
+/*
+ * Remove a node from the layer list for its dif character, if it is linked
+ * there.
+ */
+static void dbs_christree_list_rmv(struct dbs_christree *tree,
+		struct dbs_christree_node *node)
+{
+	struct dbs_christree_layer *layer;
+
+	if(tree->flags & DBS_CHRISTREE_LEAN)
+		return;
+
+	layer = tree->layer[node->layer];
+
+	dbs_christree_lock_list(tree, node->layer, node->dif);
+
+	/*
+	 * Make sure the node is actually linked in the layer.
+	 */
+	if(!node->h_v_prev && layer->node[node->dif] != node) {
+		dbs_christree_unlock_list(tree, node->layer, node->dif);
+		return;
+	}
+
+	/*
+	 * Relink nodes. The node keeps pointing to the next one, so a reader
+	 * standing on the node can still continue through the list.
+	 */
+	if(node->h_v_next)
+		node->h_v_next->h_v_prev = node->h_v_prev;
+
+	if(node->h_v_prev)
+		DBS_STORE(node->h_v_prev->h_v_next, node->h_v_next);
+	else
+		DBS_STORE(layer->node[node->dif], node->h_v_next);
+
+	node->h_v_prev = NULL;
+
+	dbs_christree_unlock_list(tree, node->layer, node->dif);
+}
+
+
+DBS_API s8 dbs_christree_link_hori(struct dbs_christree *tree,
+		struct dbs_christree_node *node)
+{
+	if(!tree || !node || node->layer < 0) {
+		ALARM(ALARM_WARN, "tree or node undefined");
+		return -1;
+	}
+
+	if(node->layer + 1 + node->pref_len > tree->layer_num) {
+		ALARM(ALARM_WARN, "node too deep");
+		return -1;
+	}
+
+	if(tree->flags & DBS_CHRISTREE_LEAN)
+		return 0;
+
+	/*
+	 * The node may be the first one on its layer or the layers covered by
+	 * its prefix.
+	 */
+	if(dbs_christree_grow(tree, node->layer + 1 + node->pref_len) < 0)
+		return -1;
+
+	if(dbs_christree_cross_add(tree, node) < 0)
+		return -1;
+
+	dbs_christree_cover(tree, node);
+	dbs_christree_list_add(tree, node);
+	return 0;
+}
+
+
+DBS_API void dbs_christree_unlink_hori(struct dbs_christree *tree,
+		struct dbs_christree_node *node)
+{
+	if(!tree || !node) {
+		ALARM(ALARM_WARN, "tree or node undefined");
+		return;
+	}
+
+	if(tree->flags & DBS_CHRISTREE_LEAN)
+		return;
+
+	dbs_christree_list_rmv(tree, node);
+	dbs_christree_cross_rmv(tree, node);
+}
+
+
+/*
+ * Replace a node in its layer list with another node, which has the same
+ * layer and dif character.
+ */
+static void dbs_christree_swap_hori(struct dbs_christree *tree,
+		struct dbs_christree_node *old, struct dbs_christree_node *new)
+{
+	struct dbs_christree_layer *layer;
+
+	if(tree->flags & DBS_CHRISTREE_LEAN)
+		return;
+
+	layer = tree->layer[old->layer];
+
+	dbs_christree_lock_list(tree, old->layer, old->dif);
+
+	new->h_v_prev = old->h_v_prev;
+	new->h_v_next = old->h_v_next;
+
+	if(old->h_v_next)
+		old->h_v_next->h_v_prev = new;
+
+	if(old->h_v_prev)
+		DBS_STORE(old->h_v_prev->h_v_next, new);
+	else
+		DBS_STORE(layer->node[old->dif], new);
+
+	old->h_v_prev = NULL;
+
+	dbs_christree_unlock_list(tree, old->layer, old->dif);
+}
+
+
+DBS_API s8 dbs_christree_link_verti(struct dbs_christree *tree,
+		struct dbs_christree_node *n, struct dbs_christree_node *v_prev)
+{
+	if(!tree || !n || !v_prev) {
+		ALARM(ALARM_WARN, "tree or n or v_prev undefined");
+		return -1;
+	}
+
+	/*
+	 * Add v_prev to the v_previous list of n. This is done first, so the
+	 * node is complete once it can be found.
+	 */
+	if(dbs_christree_add_v_prev(n, v_prev) < 0)
+		goto err_return;
+
+	/*
+	 * Add n to the v_next list of the v_previous node.
+	 */
+	if(dbs_christree_add_v_next(tree, v_prev, n) < 0)
+		goto err_rmv_v_prev;
+
+	return 0;
+
+err_rmv_v_prev:
+	dbs_christree_rmv_v_prev(n);
+
+err_return:
+	return -1;
+}
+
+
+DBS_API s8 dbs_christree_unlink_verti(struct dbs_christree *tree,
+		struct dbs_christree_node *n, struct dbs_christree_node *v_prev)
+{
+	if(!tree || !n || !v_prev) {
+		ALARM(ALARM_WARN, "tree or n or v_prev undefined");
+		return -1;
+	}
+
+	if(dbs_christree_find(v_prev, n->dif) == n &&
+			dbs_christree_next_rmv(tree, v_prev, n->dif) < 0)
+		return -1;
+
+	dbs_christree_rmv_v_prev(n);
+
+	return 0;
+}
+
+
+DBS_API s8 dbs_christree_link_node(struct dbs_christree *tree,
+		struct dbs_christree_node *node,
+		struct dbs_christree_node *v_prev)
+{
+	if(!tree || !node) {
+		ALARM(ALARM_WARN, "tree or node undefined");
+		return -1;
+	}
+
+
+	/*
+	 * Link node vertically.
+	 */
+	if(dbs_christree_link_verti(tree, node, v_prev) < 0)
+		goto err_return;
+
+
+	/*
+	 * Add the node to the layer list.
+	 */
+	if(dbs_christree_link_hori(tree, node) < 0)
+		goto err_unlink_verti;
+
+	return 0;
+
+err_unlink_verti:
+	dbs_christree_unlink_verti(tree, node, v_prev);
+
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to link node");
+	return -1;
+}
+
+
+DBS_API void dbs_christree_unlink_node(struct dbs_christree *tree, 
+		struct dbs_christree_node *node,
+		struct dbs_christree_node *v_prev)
+{
+	if(!tree || !node) {
+		ALARM(ALARM_WARN, "tree or node undefined");
+		return;
+	}
+
+	/*
+	 * Unlink from the layer list.
+	 */
+	dbs_christree_unlink_hori(tree, node);
+
+	/*
+	 * Unlink the node vertically.
+	 */
+	dbs_christree_unlink_verti(tree, node, v_prev);
+}
+
+
+/*
+ * Walk down the tree and get the node a string of the given length ends on.
+ * The last byte of a string reaching the last layer is only kept in the
+ * v_next list of the node above, so that node is returned instead, whether
+ * the string is in its list or not.
+ *
+ * Returns: The node or NULL if the string is not in the tree
+ */
+static struct dbs_christree_node *dbs_christree_lookup(struct dbs_christree *tree,
+		u8 *str, s32 len)
+{
+	struct dbs_christree_node *n_ptr = tree->root;
+	s32 i = 0;
+
+	while(i < len) {
+		if(dbs_christree_vals(tree, n_ptr))
+			return n_ptr;
+
+		if(!(n_ptr = dbs_christree_find(n_ptr, str[i])))
+			return NULL;
+
+		DBS_INSTR_COUNT(DBS_INSTR_VISIT, 1);
+
+		if(n_ptr->pref_len) {
+			if(i + 1 + n_ptr->pref_len > len)
+				return NULL;
+
+			if(memcmp(n_ptr->pref, str + i + 1, n_ptr->pref_len))
+				return NULL;
+		}
+
+		i += 1 + n_ptr->pref_len;
+	}
+
+	return n_ptr;
+}
+
+
+/*
+ * Walk down the tree with a batch of strings, the same way as
+ * dbs_christree_lookup(). Every walk is split into steps, which end with
+ * prefetching the memory the next step of the walk will use, and the steps of
+ * all walks are interleaved. So instead of every walk waiting for one cache
+ * miss after another, the misses of the different walks overlap. The data
+ * pointers found are written to the array, with NULL for every string which
+ * is not in the tree.
+ */
+static void dbs_christree_lookup_batch(struct dbs_christree *tree,
+		u8 **str, void **data, s32 num)
+{
+	struct dbs_christree_node *node[DBS_CHRISTREE_BATCH];
+	union dbs_christree_next *nxt[DBS_CHRISTREE_BATCH];
+	s32 pos[DBS_CHRISTREE_BATCH];
+	u8 step[DBS_CHRISTREE_BATCH];
+	struct dbs_christree_node *n;
+	s32 act = 0;
+	s32 k;
+
+	for(k = 0; k < num; k++) {
+		node[k] = tree->root;
+		pos[k] = 0;
+
+		if(tree->layer_num == 0) {
+			data[k] = DBS_LOAD(tree->root->data);
+			step[k] = DBS_CHRISTREE_WALK_DONE;
+		}
+		else {
+			nxt[k] = DBS_LOAD(tree->root->v_next);
+			step[k] = DBS_CHRISTREE_WALK_LIST;
+			act++;
+		}
+	}
+
+	while(act > 0) {
+		for(k = 0; k < num; k++) {
+			switch(step[k]) {
+				case DBS_CHRISTREE_WALK_NODE:
+					n = node[k];
+
+					if(n->pref_len && (pos[k] + 1 + n->pref_len >
+								tree->layer_num ||
+								memcmp(n->pref, str[k] + pos[k] + 1,
+									n->pref_len)))
+						goto miss;
+
+					pos[k] += 1 + n->pref_len;
+					if(pos[k] >= tree->layer_num) {
+						data[k] = DBS_LOAD(n->data);
+						step[k] = DBS_CHRISTREE_WALK_DONE;
+						act--;
+						break;
+					}
+
+					nxt[k] = DBS_LOAD(n->v_next);
+					DBS_PREFETCH(nxt[k]);
+					step[k] = DBS_CHRISTREE_WALK_LIST;
+					break;
+
+				case DBS_CHRISTREE_WALK_LIST:
+					if(!nxt[k])
+						goto miss;
+
+					if(nxt[k]->type == DBS_CHRISTREE_N48)
+						DBS_PREFETCH(&nxt[k]->n48.idx[str[k][pos[k]]]);
+					else if(nxt[k]->type == DBS_CHRISTREE_N256)
+						DBS_PREFETCH(&nxt[k]->n256.ptr[str[k][pos[k]]]);
+
+					step[k] = DBS_CHRISTREE_WALK_FIND;
+					break;
+
+				case DBS_CHRISTREE_WALK_FIND:
+					if(!(node[k] = dbs_christree_find_list(nxt[k],
+									str[k][pos[k]])))
+						goto miss;
+
+					/*
+					 * In the last layer the list holds the data
+					 * pointer itself.
+					 */
+					if(pos[k] == tree->layer_num - 1) {
+						data[k] = node[k];
+						step[k] = DBS_CHRISTREE_WALK_DONE;
+						act--;
+						break;
+					}
+
+					DBS_PREFETCH(node[k]);
+					step[k] = DBS_CHRISTREE_WALK_NODE;
+					break;
+			}
+
+			continue;
+
+miss:
+			data[k] = NULL;
+			step[k] = DBS_CHRISTREE_WALK_DONE;
+			act--;
+		}
+	}
+}
+
+
+/*
+ * Replace the child with the given dif character in the v_next list of a
+ * node, which has to contain it.
+ */
+static void dbs_christree_next_swap(struct dbs_christree_node *n, u8 dif,
+		struct dbs_christree_node *new)
+{
+	union dbs_christree_next *nxt = n->v_next;
+	s32 i;
+
+	switch(nxt->type) {
+		case DBS_CHRISTREE_N4:
+			for(i = 0; nxt->n4.key[i] != dif; i++);
+			DBS_STORE(nxt->n4.ptr[i], new);
+			break;
+
+		case DBS_CHRISTREE_N16:
+			for(i = 0; nxt->n16.key[i] != dif; i++);
+			DBS_STORE(nxt->n16.ptr[i], new);
+			break;
+
+		case DBS_CHRISTREE_N48:
+			DBS_STORE(nxt->n48.ptr[nxt->n48.idx[dif] - 1], new);
+			break;
+
+		case DBS_CHRISTREE_N256:
+			DBS_STORE(nxt->n256.ptr[dif], new);
+			break;
+	}
+}
+
+
+/*
+ * Split a compressed node, so that a new upper node holds the dif character
+ * and the first len bytes of the prefix, and a new lower node holds the rest.
+ * Both take the place of the old node in the tree, which is deleted. The old
+ * node is never changed, so readers standing on it still see a valid node.
+ *
+ * Returns: The new upper node or NULL if an error occurred
+ */
+static struct dbs_christree_node *dbs_christree_split(struct dbs_christree *tree,
+		struct dbs_christree_node *node, s32 len)
+{
+	struct dbs_christree_node *n_upper;
+	struct dbs_christree_node *n_lower = NULL;
+	struct dbs_christree_node *n_ptr;
+	s32 it = 0;
+
+	if(!(n_upper = dbs_christree_new(tree, node->layer, node->dif)))
+		goto err_return;
+
+	memcpy(n_upper->pref, node->pref, len);
+	n_upper->pref_len = len;
+
+	/*
+	 * If the upper node ends right above the last layer, all that is left
+	 * of the old node is the last byte and the data pointer, which go into
+	 * the v_next list of the upper node.
+	 */
+	if(dbs_christree_vals(tree, n_upper)) {
+		if(node->data && dbs_christree_next_add(tree, n_upper,
+					node->pref[len], node->data) < 0)
+			goto err_del_upper;
+
+		goto swap;
+	}
+
+	if(!(n_lower = dbs_christree_new(tree, node->layer + len + 1,
+					node->pref[len])))
+		goto err_del_upper;
+
+	n_lower->pref_len = node->pref_len - len - 1;
+	memcpy(n_lower->pref, node->pref + len + 1, n_lower->pref_len);
+
+	if(dbs_christree_add_v_next(tree, n_upper, n_lower) < 0)
+		goto err_del_lower;
+
+	/*
+	 * The lower node takes over the children and the data pointer.
+	 */
+	n_lower->v_next = node->v_next;
+	n_lower->v_next_used = node->v_next_used;
+	n_lower->v_next_alloc = node->v_next_alloc;
+	n_lower->data = node->data;
+
+	if(!dbs_christree_vals(tree, n_lower)) {
+		while((n_ptr = dbs_christree_iter(n_lower, &it)))
+			DBS_STORE(n_ptr->v_prev, n_lower);
+	}
+
+	n_lower->v_prev = n_upper;
+
+	/*
+	 * The lower node is linked first and the upper node takes the place
+	 * of the old one in its layer list, so a reader going through the
+	 * layer lists always finds the branch. The layers of the lower node
+	 * are already there, as the old node covered them.
+	 */
+	dbs_christree_list_add(tree, n_lower);
+
+swap:
+	n_upper->v_prev = node->v_prev;
+	dbs_christree_cross_split(tree, node, n_upper, n_lower, len);
+	dbs_christree_swap_hori(tree, node, n_upper);
+
+	dbs_christree_next_swap(node->v_prev, node->dif, n_upper);
+
+	/*
+	 * The v_next list now belongs to the lower node.
+	 */
+	dbs_christree_free(tree, &tree->node_slab, node);
+	return n_upper;
+
+err_del_lower:
+	dbs_christree_del(tree, n_lower);
+
+err_del_upper:
+	dbs_christree_del(tree, n_upper);
+
+err_return:
+	return NULL;
+}
+
+
+/*
+ * Merge a node with its only child, if the node holds no data and the
+ * combined prefix fits into a single node.
+ */
+static void dbs_christree_merge(struct dbs_christree *tree,
+		struct dbs_christree_node *node)
+{
+	struct dbs_christree_node *n_v_next;
+	struct dbs_christree_node *n_ptr;
+	union dbs_christree_next *nxt;
+	s32 used;
+	s32 alloc;
+	s32 it = 0;
+
+	/*
+	 * Merging moves the child up into a layer, which a reader searching
+	 * the layer lists may already have passed. So nodes aren't merged
+	 * while the tree is shared.
+	 */
+	if(tree->epoch)
+		return;
+
+	if(!node->v_prev || node->data || node->v_next_used != 1)
+		return;
+
+	n_v_next = dbs_christree_iter(node, &it);
+
+	/*
+	 * The last data pointer in the list of a node above the last layer
+	 * becomes the data pointer of the node itself.
+	 */
+	if(dbs_christree_vals(tree, node)) {
+		if(node->pref_len + 1 > DBS_CHRISTREE_PREF_MAX)
+			return;
+
+		/*
+		 * The new byte is on the last layer, which has no cross
+		 * lists.
+		 */
+		node->pref[node->pref_len++] = it - 1;
+		node->data = n_v_next;
+
+		dbs_christree_free(tree, &tree->next_slab[node->v_next->type - 1],
+				node->v_next);
+		node->v_next = NULL;
+		node->v_next_used = 0;
+		node->v_next_alloc = 0;
+		return;
+	}
+
+	if(node->pref_len + 1 + n_v_next->pref_len > DBS_CHRISTREE_PREF_MAX)
+		return;
+
+	/*
+	 * The node stays in its layer list and takes over the place of the
+	 * child in the cross lists.
+	 */
+	if(dbs_christree_cross_merge(tree, node, n_v_next) < 0)
+		return;
+
+	dbs_christree_list_rmv(tree, n_v_next);
+
+	node->pref[node->pref_len] = n_v_next->dif;
+	memcpy(node->pref + node->pref_len + 1, n_v_next->pref,
+			n_v_next->pref_len);
+	node->pref_len += 1 + n_v_next->pref_len;
+
+	dbs_christree_cover(tree, node);
+
+	/*
+	 * Take over the children and the data of the child, and give it the
+	 * old v_next list, so it is freed together with the child.
+	 */
+	nxt = node->v_next;
+	used = node->v_next_used;
+	alloc = node->v_next_alloc;
+
+	node->v_next = n_v_next->v_next;
+	node->v_next_used = n_v_next->v_next_used;
+	node->v_next_alloc = n_v_next->v_next_alloc;
+	node->data = n_v_next->data;
+
+	n_v_next->v_next = nxt;
+	n_v_next->v_next_used = used;
+	n_v_next->v_next_alloc = alloc;
+
+	if(!dbs_christree_vals(tree, node)) {
+		it = 0;
+		while((n_ptr = dbs_christree_iter(node, &it)))
+			n_ptr->v_prev = node;
+	}
+
+	dbs_christree_del(tree, n_v_next);
+}
+
+
+/*
+ * Unlink a node and all nodes below it from the tree and delete them.
+ */
+static void dbs_christree_prune(struct dbs_christree *tree,
+		struct dbs_christree_node *node)
+{
+	struct dbs_christree_node *n_v_next;
+	s32 it = 0;
+
+	if(!dbs_christree_vals(tree, node)) {
+		while((n_v_next = dbs_christree_iter(node, &it)))
+			dbs_christree_prune(tree, n_v_next);
+	}
+
+	if(node->v_prev)
+		dbs_christree_unlink_node(tree, node, node->v_prev);
+
+	dbs_christree_del(tree, node);
+}
+
+
+/*
+ * Create the nodes for the rest of a string of the given length below a node,
+ * each holding as many bytes as possible. A byte left for the last layer
+ * goes into the v_next list of the last node together with the data pointer.
+ * The new branch is built completely, before it is linked to the node.
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+static s8 dbs_christree_branch(struct dbs_christree *tree,
+		struct dbs_christree_node *n_ptr, u8 *str, s32 len, s32 i,
+		void *data)
+{
+	struct dbs_christree_node *node;
+	struct dbs_christree_node *n_top = NULL;
+	struct dbs_christree_node *n_v_prev = NULL;
+	s32 pref_len;
+
+	while(i < len && i < tree->layer_num - 1) {
+		if(!(node = dbs_christree_new(tree, i, str[i])))
+			goto err_prune;
+
+		pref_len = len - i - 1;
+		if(pref_len > DBS_CHRISTREE_PREF_MAX)
+			pref_len = DBS_CHRISTREE_PREF_MAX;
+
+		memcpy(node->pref, str + i + 1, pref_len);
+		node->pref_len = pref_len;
+
+		if(!n_top)
+			n_top = node;
+		else if(dbs_christree_link_node(tree, node, n_v_prev) < 0)
+			goto err_del_node;
+
+		i += 1 + pref_len;
+		n_v_prev = node;
+	}
+
+	/*
+	 * The lower nodes can already be found in the layer lists.
+	 */
+	if(i < len) {
+		if(dbs_christree_next_add(tree, n_v_prev, str[i], data) < 0)
+			goto err_prune;
+	}
+	else {
+		DBS_STORE(n_v_prev->data, data);
+	}
+
+	if(dbs_christree_link_node(tree, n_top, n_ptr) < 0)
+		goto err_prune;
+
+	return 0;
+
+err_del_node:
+	dbs_christree_del(tree, node);
+
+err_prune:
+	if(n_top)
+		dbs_christree_prune(tree, n_top);
+
+	return -1;
+}
+
+
+/*
+ * Set the data pointer for a dif character in the v_next list of a node above
+ * the last layer, either replacing the old one or adding a new one.
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+static s8 dbs_christree_val_put(struct dbs_christree *tree,
+		struct dbs_christree_node *node, u8 dif, void *data)
+{
+	if(dbs_christree_find(node, dif)) {
+		dbs_christree_next_swap(node, dif, data);
+		return 0;
+	}
+
+	return dbs_christree_next_add(tree, node, dif, data);
+}
+
+
+/*
+ * Try to add a string of the given length to the tree. The nodes are read
+ * without taking any locks, and only the nodes which are changed get locked.
+ * If one of them has been changed by another writer since it has been read,
+ * the attempt is given up.
+ *
+ * Returns: 0 on success, 1 if the attempt has to be repeated or -1 if an
+ *          error occurred
+ */
+static s8 dbs_christree_insert(struct dbs_christree *tree,
+		u8 *str, s32 len, void *data)
+{
+	struct dbs_christree_node *node;
+	struct dbs_christree_node *n_ptr;
+	struct dbs_christree_node *n_upper;
+	u32 v_node;
+	u32 v;
+	s32 i = 0;
+	s32 j;
+	s8 ret = 0;
+
+	n_ptr = tree->root;
+	v = dbs_christree_vers(tree, n_ptr);
+
+	while(i < len) {
+
+		/*
+		 * The last byte of the string goes into the v_next list of the
+		 * node above the last layer.
+		 */
+		if(dbs_christree_vals(tree, n_ptr))
+			break;
+
+		/*
+		 * Check if the required node is already linked below.
+		 */
+		if(!(node = dbs_christree_find(n_ptr, str[i])))
+			break;
+
+		DBS_INSTR_COUNT(DBS_INSTR_VISIT, 1);
+
+		v_node = dbs_christree_vers(tree, node);
+
+		/*
+		 * If the string leaves or ends inside the prefix of a
+		 * compressed node, the node has to be split there. This
+		 * replaces the node in the v_next list above, so both are
+		 * locked.
+		 */
+		for(j = 0; j < node->pref_len && i + 1 + j < len; j++) {
+			if(node->pref[j] != str[i + 1 + j])
+				break;
+		}
+
+		if(j < node->pref_len) {
+			if(dbs_christree_lock(tree, n_ptr, v) < 0)
+				return 1;
+
+			if(dbs_christree_lock(tree, node, v_node) < 0) {
+				dbs_christree_unlock(tree, n_ptr, 0);
+				return 1;
+			}
+
+			if(!(n_upper = dbs_christree_split(tree, node, j))) {
+				dbs_christree_unlock(tree, node, 0);
+				dbs_christree_unlock(tree, n_ptr, 0);
+				return -1;
+			}
+
+			dbs_christree_unlock(tree, node, 1);
+			dbs_christree_unlock(tree, n_ptr, 0);
+
+			node = n_upper;
+			v_node = dbs_christree_vers(tree, node);
+		}
+
+		i += 1 + node->pref_len;
+		n_ptr = node;
+		v = v_node;
+	}
+
+	if(dbs_christree_lock(tree, n_ptr, v) < 0)
+		return 1;
+
+	/*
+	 * Either link the datanection or create the missing nodes.
+	 */
+	if(i >= len)
+		DBS_STORE(n_ptr->data, data);
+	else if(dbs_christree_vals(tree, n_ptr))
+		ret = dbs_christree_val_put(tree, n_ptr, str[i], data);
+	else if(dbs_christree_branch(tree, n_ptr, str, len, i, data) < 0)
+		ret = -1;
+
+	dbs_christree_unlock(tree, n_ptr, 0);
+	return ret;
+}
+
+
+/*
+ * Add a string to the tree, and to the index if there is one. The index is
+ * changed first, as that can fail, and if adding the string to the tree
+ * fails, the string can't have been in the tree before.
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+static s8 dbs_christree_put(struct dbs_christree *tree,
+		u8 *str, s32 len, void *data)
+{
+	s8 ret;
+
+	if(tree->index && dbs_hashmap_set(tree->index, str, len, data) < 0)
+		return -1;
+
+	while((ret = dbs_christree_insert(tree, str, len, data)) > 0)
+		sched_yield();
+
+	if(ret < 0 && tree->index)
+		dbs_hashmap_del(tree->index, str, len);
+
+	return ret;
+}
+
+
+DBS_API s8 dbs_christree_add(struct dbs_christree *tree,
+		u8 *str, void *data)
+{
+	if(!tree) {
+		ALARM(ALARM_WARN, "tree undefined");
+		return -1;
+	}
+
+	return dbs_christree_add_n(tree, str, tree->layer_num, data);
+}
+
+
+DBS_API s8 dbs_christree_add_n(struct dbs_christree *tree,
+		u8 *str, s32 len, void *data)
+{
+	DBS_INSTR_VAR(t)
+	s8 ret;
+
+	if(!tree || !str || !data) {
+		ALARM(ALARM_WARN, "tree or str or data undefined");
+		return -1;
+	}
+
+	if(len < 1 || len > tree->layer_num) {
+		ALARM(ALARM_WARN, "len invalid");
+		return -1;
+	}
+
+	DBS_INSTR_BEGIN(t);
+
+	if(tree->epoch)
+		dbs_epoch_enter(tree->ew.rd);
+
+	ret = dbs_christree_put(tree, str, len, data);
+
+	if(tree->epoch)
+		dbs_epoch_leave(tree->ew.rd);
+
+	DBS_INSTR_END(DBS_INSTR_OP_ADD, t);
+
+	if(ret < 0) {
+		ALARM(ALARM_ERR, "Failed to add new node to the catree");
+		return -1;
+	}
+
+	return 0;
+}
+
+
+/*
+ * Try to remove a string from the tree, the same way as adding one. A
+ * tombstone removal only clears the data pointer and leaves the nodes in
+ * place for dbs_christree_compact().
+ *
+ * Returns: 0 if the string has been removed or isn't in the tree, 1 if the
+ *          attempt has to be repeated or -1 if an error occurred
+ */
+static s8 dbs_christree_erase(struct dbs_christree *tree, u8 *str, s32 len,
+		s8 tomb)
+{
+	struct dbs_christree_node *n_ptr;
+	struct dbs_christree_node *n_v_prev;
+
+	if(!(n_ptr = dbs_christree_lookup(tree, str, len)))
+		return 0;
+
+	if(dbs_christree_lock(tree, n_ptr, dbs_christree_vers(tree, n_ptr)) < 0)
+		return 1;
+
+	/*
+	 * A string reaching the last layer is removed from the v_next list of
+	 * the node above.
+	 */
+	if(dbs_christree_depth(n_ptr) < len) {
+		if(!dbs_christree_find(n_ptr, str[len - 1])) {
+			dbs_christree_unlock(tree, n_ptr, 0);
+			return 0;
+		}
+
+		if(dbs_christree_next_rmv(tree, n_ptr, str[len - 1]) < 0) {
+			dbs_christree_unlock(tree, n_ptr, 0);
+			return -1;
+		}
+	}
+	else {
+		DBS_STORE(n_ptr->data, NULL);
+	}
+
+	if(tomb) {
+		dbs_christree_unlock(tree, n_ptr, 0);
+		return 0;
+	}
+
+	/*
+	 * Remove all nodes, which are no longer needed. Locks are always
+	 * taken from the top down, so the node above can only be tried while
+	 * holding the node. If that fails, the node is released and locked
+	 * again, and may have been changed in the meantime. If it has been
+	 * replaced by a split, the string is looked up again.
+	 */
+	while((n_v_prev = DBS_LOAD(n_ptr->v_prev)) && n_ptr->v_next_used < 1 &&
+			!n_ptr->data) {
+		if(dbs_christree_lock(tree, n_v_prev,
+					DBS_LOAD(n_v_prev->vers)) < 0) {
+			dbs_christree_unlock(tree, n_ptr, 0);
+			sched_yield();
+
+			if(dbs_christree_lock_wait(tree, n_ptr) < 0)
+				return 1;
+
+			continue;
+		}
+
+		/*
+		 * The string is already gone, so if the node can't be removed
+		 * from the list above, it is just left for a compaction.
+		 */
+		if(dbs_christree_unlink_verti(tree, n_ptr, n_v_prev) < 0) {
+			dbs_christree_unlock(tree, n_v_prev, 0);
+			break;
+		}
+
+		dbs_christree_unlink_hori(tree, n_ptr);
+
+		dbs_christree_unlock(tree, n_ptr, 1);
+		dbs_christree_del(tree, n_ptr);
+
+		n_ptr = n_v_prev;
+	}
+
+	/*
+	 * If the remaining node only has a single child left, they can be
+	 * compressed into one node again.
+	 */
+	dbs_christree_merge(tree, n_ptr);
+
+	dbs_christree_unlock(tree, n_ptr, 0);
+	return 0;
+}
+
+
+DBS_API void dbs_christree_rmv(struct dbs_christree *tree,
+		u8 *str)
+{
+	if(!tree) {
+		ALARM(ALARM_WARN, "tree undefined");
+		return;
+	}
+
+	dbs_christree_rmv_n(tree, str, tree->layer_num);
+}
+
+
+DBS_API void dbs_christree_rmv_n(struct dbs_christree *tree,
+		u8 *str, s32 len)
+{
+	DBS_INSTR_VAR(t)
+	s8 ret;
+
+	if(!tree || !str) {
+		ALARM(ALARM_WARN, "tree or str undefined");
+		return;
+	}
+
+	if(len < 1 || len > tree->layer_num) {
+		ALARM(ALARM_WARN, "len invalid");
+		return;
+	}
+
+	DBS_INSTR_BEGIN(t);
+
+	if(tree->epoch)
+		dbs_epoch_enter(tree->ew.rd);
+
+	while((ret = dbs_christree_erase(tree, str, len,
+				(tree->flags & DBS_CHRISTREE_TOMB) != 0)) > 0)
+		sched_yield();
+
+	if(ret < 0)
+		ALARM(ALARM_ERR, "Failed to remove string");
+	else if(tree->index)
+		dbs_hashmap_del(tree->index, str, len);
+
+	if(tree->epoch)
+		dbs_epoch_leave(tree->ew.rd);
+
+	DBS_INSTR_END(DBS_INSTR_OP_RMV, t);
+}
+
+
+/*
+ * Finish a node during a compaction, after all nodes below it have been
+ * finished. If some children have been left without a data pointer and
+ * without children, they are removed, and the v_next list is rebuilt once
+ * with the remaining ones. While the tree is shared, children locked by
+ * another writer are left for the next compaction, and so is a node removed
+ * in the meantime.
+ *
+ * Returns: The number of removed nodes or -1 if an error occurred
+ */
+static s32 dbs_christree_compact_node(struct dbs_christree *tree,
+		struct dbs_christree_node *node, s8 prune)
+{
+	struct dbs_christree_node *lst[256];
+	struct dbs_christree_node *dead[256];
+	struct dbs_christree_node *n_ptr;
+	u8 key[256];
+	s32 num;
+	s32 used = 0;
+	s32 c = 0;
+	s32 i;
+
+	/*
+	 * Nodes are only merged while the tree isn't shared.
+	 */
+	if(!prune && tree->epoch)
+		return 0;
+
+	if(dbs_christree_lock_wait(tree, node) < 0)
+		return 0;
+
+	if(prune) {
+		num = dbs_christree_next_list(node, key, lst);
+
+		for(i = 0; i < num; i++) {
+			n_ptr = lst[i];
+
+			if(!DBS_LOAD(n_ptr->data) && dbs_christree_lock(tree, n_ptr,
+						dbs_christree_vers(tree, n_ptr)) == 0) {
+				if(!n_ptr->data && n_ptr->v_next_used < 1) {
+					dead[c++] = n_ptr;
+					continue;
+				}
+
+				dbs_christree_unlock(tree, n_ptr, 0);
+			}
+
+			key[used] = key[i];
+			lst[used++] = n_ptr;
+		}
+	}
+
+	if(c > 0 && dbs_christree_next_fill(tree, node,
+				dbs_christree_next_type(used), key, lst, used) < 0) {
+		for(i = 0; i < c; i++)
+			dbs_christree_unlock(tree, dead[i], 0);
+
+		dbs_christree_unlock(tree, node, 0);
+		return -1;
+	}
+
+	if(c > 0)
+		node->v_next_used = used;
+
+	for(i = 0; i < c; i++) {
+		dbs_christree_unlink_hori(tree, dead[i]);
+		dbs_christree_rmv_v_prev(dead[i]);
+
+		dbs_christree_unlock(tree, dead[i], 1);
+		dbs_christree_del(tree, dead[i]);
+	}
+
+	/*
+	 * Take over as many nodes below as fit into the prefix.
+	 */
+	do {
+		num = node->pref_len;
+		dbs_christree_merge(tree, node);
+	} while(node->pref_len != num);
+
+	dbs_christree_unlock(tree, node, 0);
+	return c;
+}
+
+
+DBS_API s32 dbs_christree_compact(struct dbs_christree *tree)
+{
+	struct dbs_christree_frame *stk;
+	struct dbs_christree_frame *frm;
+	struct dbs_christree_node *n;
+	s32 *empty;
+	s32 num = 1;
+	s32 c = 0;
+	s32 tmp;
+
+	if(!tree) {
+		ALARM(ALARM_WARN, "tree undefined");
+		return -1;
+	}
+
+	/*
+	 * A branch can't have more nodes than there are layers. Next to the
+	 * stack, the number of empty children found below every node on it
+	 * is kept.
+	 */
+	tmp = (tree->layer_num + 1) * (sizeof(struct dbs_christree_frame) +
+			sizeof(s32));
+	if(!(stk = smalloc(tmp)))
+		goto err_return;
+
+	empty = (s32 *)(stk + tree->layer_num + 1);
+
+	if(tree->epoch)
+		dbs_epoch_enter(tree->ew.rd);
+
+	/*
+	 * Walk through the tree and finish every node after all nodes below
+	 * it, so a branch left empty is removed from the bottom up.
+	 */
+	stk[0].node = tree->root;
+	stk[0].next = 0;
+	empty[0] = 0;
+
+	while(num > 0) {
+		frm = &stk[num - 1];
+
+		if(!dbs_christree_vals(tree, frm->node) &&
+				(n = dbs_christree_iter(frm->node, &frm->next))) {
+			stk[num].node = n;
+			stk[num].next = 0;
+			empty[num] = 0;
+			num++;
+			continue;
+		}
+
+		if((tmp = dbs_christree_compact_node(tree, frm->node,
+						empty[num - 1] > 0)) < 0)
+			break;
+
+		c += tmp;
+		num--;
+
+		if(num > 0 && !DBS_LOAD(frm->node->data) &&
+				DBS_LOAD(frm->node->v_next) == NULL)
+			empty[num - 1]++;
+	}
+
+	if(tree->epoch)
+		dbs_epoch_leave(tree->ew.rd);
+
+	sfree(stk);
+
+	if(num > 0)
+		goto err_return;
+
+	return c;
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to compact tree");
+	return -1;
+}
+
+
+DBS_API void *dbs_christree_get(struct dbs_christree *tree, u8 *str)
+{
+	if(!tree) {
+		ALARM(ALARM_WARN, "tree undefined");
+		return NULL;
+	}
+
+	return dbs_christree_get_n(tree, str, tree->layer_num);
+}
+
+
+DBS_API void *dbs_christree_get_n(struct dbs_christree *tree,
+		u8 *str, s32 len)
+{
+	struct dbs_christree_node *n_ptr;
+	void *ret = NULL;
+	DBS_INSTR_VAR(t)
+
+	if(!tree || !str) {
+		ALARM(ALARM_WARN, "tree or str undefined");
+		return NULL;
+	}
+
+	if(len < 1 || len > tree->layer_num) {
+		ALARM(ALARM_WARN, "len invalid");
+		return NULL;
+	}
+
+	DBS_INSTR_BEGIN(t);
+
+	if(tree->index) {
+		ret = dbs_hashmap_get(tree->index, str, len);
+	}
+	else if((n_ptr = dbs_christree_lookup(tree, str, len))) {
+		if(dbs_christree_depth(n_ptr) < len)
+			ret = dbs_christree_find(n_ptr, str[len - 1]);
+		else
+			ret = DBS_LOAD(n_ptr->data);
+	}
+
+	DBS_INSTR_END(DBS_INSTR_OP_GET, t);
+	return ret;
+}
+
+
+DBS_API s8 dbs_christree_contains(struct dbs_christree *tree, u8 *str)
+{
+	if(!tree || !str) {
+		ALARM(ALARM_WARN, "tree or str undefined");
+		return -1;
+	}
+
+	return dbs_christree_get(tree, str) != NULL;
+}
+
+
+DBS_API s8 dbs_christree_contains_n(struct dbs_christree *tree,
+		u8 *str, s32 len)
+{
+	if(!tree || !str || len < 1 || len > tree->layer_num) {
+		ALARM(ALARM_WARN, "tree or str undefined or len invalid");
+		return -1;
+	}
+
+	return dbs_christree_get_n(tree, str, len) != NULL;
+}
+
+
+DBS_API s8 dbs_christree_add_batch(struct dbs_christree *tree,
+		u8 **str, void **data, s32 num)
+{
+	void *ptr[DBS_CHRISTREE_BATCH];
+	s32 len;
+	s32 i;
+	s32 j;
+	s8 ret = 0;
+
+	if(!tree || !str || !data || num < 0) {
+		ALARM(ALARM_WARN, "tree or str or data undefined or num invalid");
+		return -1;
+	}
+
+	for(i = 0; i < num && ret == 0; i += DBS_CHRISTREE_BATCH) {
+		len = num - i < DBS_CHRISTREE_BATCH ? num - i : DBS_CHRISTREE_BATCH;
+
+		for(j = 0; j < len; j++) {
+			if(!str[i + j] || !data[i + j]) {
+				ALARM(ALARM_WARN, "str or data undefined");
+				return -1;
+			}
+		}
+
+		if(tree->epoch)
+			dbs_epoch_enter(tree->ew.rd);
+
+		/*
+		 * The walks only warm up the cache, the strings are looked up
+		 * again when they are inserted.
+		 */
+		dbs_christree_lookup_batch(tree, str + i, ptr, len);
+
+		for(j = 0; j < len && ret == 0; j++)
+			ret = dbs_christree_put(tree, str[i + j], tree->layer_num,
+					data[i + j]);
+
+		if(tree->epoch)
+			dbs_epoch_leave(tree->ew.rd);
+	}
+
+	if(ret < 0) {
+		ALARM(ALARM_ERR, "Failed to add new node to the catree");
+		return -1;
+	}
+
+	return 0;
+}
+
+
+DBS_API s32 dbs_christree_get_batch(struct dbs_christree *tree,
+		u8 **str, void **data, s32 num)
+{
+	s32 len;
+	s32 c = 0;
+	s32 i;
+	s32 j;
+
+	if(!tree || !str || !data || num < 0) {
+		ALARM(ALARM_WARN, "tree or str or data undefined or num invalid");
+		return -1;
+	}
+
+	for(i = 0; i < num; i += DBS_CHRISTREE_BATCH) {
+		len = num - i < DBS_CHRISTREE_BATCH ? num - i : DBS_CHRISTREE_BATCH;
+
+		for(j = 0; j < len; j++) {
+			if(!str[i + j]) {
+				ALARM(ALARM_WARN, "str undefined");
+				return -1;
+			}
+		}
+
+		/*
+		 * The index only needs a single probe for every string.
+		 */
+		if(tree->index) {
+			for(j = 0; j < len; j++) {
+				data[i + j] = dbs_hashmap_get(tree->index, str[i + j],
+						tree->layer_num);
+				if(data[i + j])
+					c++;
+			}
+
+			continue;
+		}
+
+		dbs_christree_lookup_batch(tree, str + i, data + i, len);
+
+		for(j = 0; j < len; j++) {
+			if(data[i + j])
+				c++;
+		}
+	}
+
+	return c;
+}
+
+
+DBS_API s8 dbs_christree_rmv_batch(struct dbs_christree *tree,
+		u8 **str, s32 num)
+{
+	void *ptr[DBS_CHRISTREE_BATCH];
+	s32 len;
+	s32 i;
+	s32 j;
+	s8 tomb;
+	s8 ret;
+	s8 err = 0;
+
+	if(!tree || !str || num < 0) {
+		ALARM(ALARM_WARN, "tree or str undefined or num invalid");
+		return -1;
+	}
+
+	for(j = 0; j < num; j++) {
+		if(!str[j]) {
+			ALARM(ALARM_WARN, "str undefined");
+			return -1;
+		}
+	}
+
+	tomb = (tree->flags & DBS_CHRISTREE_TOMB) != 0;
+
+	for(i = 0; i < num; i += DBS_CHRISTREE_BATCH) {
+		len = num - i < DBS_CHRISTREE_BATCH ? num - i : DBS_CHRISTREE_BATCH;
+
+		if(tree->epoch)
+			dbs_epoch_enter(tree->ew.rd);
+
+		/*
+		 * Like with inserting, the walks only warm up the cache.
+		 */
+		dbs_christree_lookup_batch(tree, str + i, ptr, len);
+
+		for(j = 0; j < len; j++) {
+			while((ret = dbs_christree_erase(tree, str[i + j],
+						tree->layer_num, tomb)) > 0)
+				sched_yield();
+
+			if(ret < 0)
+				err = 1;
+			else if(tree->index)
+				dbs_hashmap_del(tree->index, str[i + j],
+						tree->layer_num);
+		}
+
+		if(tree->epoch)
+			dbs_epoch_leave(tree->ew.rd);
+	}
+
+	if(err) {
+		ALARM(ALARM_ERR, "Failed to remove strings");
+		return -1;
+	}
+
+	return 0;
+}
+
+
+DBS_API struct dbs_chrisfilter *dbs_chrisfilter_init(s32 len)
+{
+	struct dbs_chrisfilter *flt;
+	s32 tmp;
+	s32 i;
+
+	if(len < 0) {
+		ALARM(ALARM_WARN, "len invalid");
+		return NULL;
+	}
+
+	/*
+	 * Allocate the filter together with the conditions.
+	 */
+	tmp = sizeof(struct dbs_chrisfilter) + len * sizeof(struct dbs_chrisbyte);
+	if(!(flt = smalloc(tmp)))
+		goto err_return;
+
+	flt->len = len;
+	flt->byte = (struct dbs_chrisbyte *)(flt + 1);
+
+	for(i = 0; i < len; i++)
+		dbs_chrisfilter_set_any(flt, i);
+
+	return flt;
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to create filter");
+	return NULL;
+}
+
+
+DBS_API void dbs_chrisfilter_close(struct dbs_chrisfilter *flt)
+{
+	if(!flt) {
+		ALARM(ALARM_WARN, "flt undefined");
+		return;
+	}
+
+	sfree(flt);
+}
+
+
+DBS_API s8 dbs_chrisfilter_set_any(struct dbs_chrisfilter *flt, s32 off)
+{
+	if(!flt || off < 0 || off >= flt->len) {
+		ALARM(ALARM_WARN, "flt undefined or off invalid");
+		return -1;
+	}
+
+	flt->byte[off].lo = 0x00;
+	flt->byte[off].hi = 0xff;
+	flt->byte[off].msk = 0x00;
+	flt->byte[off].val = 0x00;
+	return 0;
+}
+
+
+DBS_API s8 dbs_chrisfilter_set_exact(struct dbs_chrisfilter *flt, s32 off,
+		u8 *data, s32 len)
+{
+	s32 i;
+
+	if(!flt || !data || off < 0 || len < 0 || off + len > flt->len) {
+		ALARM(ALARM_WARN, "flt or data undefined or off or len invalid");
+		return -1;
+	}
+
+	for(i = 0; i < len; i++) {
+		flt->byte[off + i].lo = data[i];
+		flt->byte[off + i].hi = data[i];
+		flt->byte[off + i].msk = 0xff;
+		flt->byte[off + i].val = data[i];
+	}
+
+	return 0;
+}
+
+
+DBS_API s8 dbs_chrisfilter_set_bits(struct dbs_chrisfilter *flt, s32 off,
+		u8 msk, u8 val)
+{
+	if(!flt || off < 0 || off >= flt->len) {
+		ALARM(ALARM_WARN, "flt undefined or off invalid");
+		return -1;
+	}
+
+	flt->byte[off].msk = msk;
+	flt->byte[off].val = val & msk;
+	return 0;
+}
+
+
+DBS_API s8 dbs_chrisfilter_set_range(struct dbs_chrisfilter *flt, s32 off,
+		u8 lo, u8 hi)
+{
+	if(!flt || off < 0 || off >= flt->len || lo > hi) {
+		ALARM(ALARM_WARN, "flt undefined or off or range invalid");
+		return -1;
+	}
+
+	flt->byte[off].lo = lo;
+	flt->byte[off].hi = hi;
+	return 0;
+}
+
+
+/*
+ * Check if a byte matches a condition.
+ */
+static s8 dbs_chrisbyte_match(struct dbs_chrisbyte *b, s32 c)
+{
+	return c >= b->lo && c <= b->hi && (c & b->msk) == b->val;
+}
+
+
+/*
+ * Check if a condition matches every byte.
+ */
+static s8 dbs_chrisbyte_any(struct dbs_chrisbyte *b)
+{
+	return b->lo == 0x00 && b->hi == 0xff && b->msk == 0x00;
+}
+
+
+/*
+ * Fill the conditions for a mask. This needs room for off + len conditions.
+ */
+static void dbs_chrismask_conv(struct dbs_chrismask *mask,
+		struct dbs_chrisfilter *flt, struct dbs_chrisbyte *byte)
+{
+	s32 i;
+
+	flt->len = mask->off + mask->len;
+	flt->byte = byte;
+
+	for(i = 0; i < mask->off; i++)
+		dbs_chrisfilter_set_any(flt, i);
+
+	dbs_chrisfilter_set_exact(flt, mask->off, mask->data, mask->len);
+}
+
+
+/*
+ * Check the bytes of a node against the filter, starting with the given
+ * position in the node, where 0 is the dif character and every following
+ * position is one of the prefix bytes.
+ *
+ * Returns: 1 if all bytes match and 0 if not
+ */
+static s8 dbs_christree_flt_node(struct dbs_chrisfilter *flt,
+		struct dbs_christree_node *n, s32 pos)
+{
+	s32 layer;
+	s32 i;
+
+	for(i = pos; i <= n->pref_len; i++) {
+		if((layer = n->layer + i) >= flt->len)
+			return 1;
+
+		if(!dbs_chrisbyte_match(&flt->byte[layer],
+					i ? n->pref[i - 1] : n->dif))
+			return 0;
+	}
+
+	return 1;
+}
+
+
+/*
+ * Check the filter and prepare a cursor for it. The cursor will use the given
+ * conditions and stack, which have to stay valid while the cursor is used.
+ *
+ * Returns: 0 on success or -1 if the filter is invalid
+ */
+static s8 dbs_christree_cursor_init(struct dbs_christree_cursor *cur,
+		struct dbs_christree *tree, struct dbs_chrisfilter *flt,
+		struct dbs_christree_frame *stk)
+{
+	struct dbs_christree_layer *l;
+	s32 i;
+
+	if(flt->len < 0 || flt->len > tree->layer_num) {
+		ALARM(ALARM_WARN, "filter invalid");
+		return -1;
+	}
+
+	cur->tree = tree;
+	cur->flt = *flt;
+
+	cur->stk = stk;
+	cur->stk_num = 0;
+
+	/*
+	 * If the filter starts with bytes that match anything, the branches
+	 * are searched for in the lists of the first restricted layer.
+	 * Otherwise, or if the tree has no layer lists, the whole tree is
+	 * walked from the root.
+	 */
+	for(i = 0; i < flt->len && dbs_chrisbyte_any(&flt->byte[i]); i++);
+
+	if(i == 0 || i == flt->len || (tree->flags & DBS_CHRISTREE_LEAN)) {
+		cur->step = DBS_CHRISTREE_CUR_ROOT;
+		cur->seed = -1;
+	}
+	else {
+		/*
+		 * The last layer has no nodes, its bytes are only kept in the
+		 * v_next lists of the layer above.
+		 */
+		if(i == tree->layer_num - 1)
+			i--;
+
+		/*
+		 * The compressed nodes covering the layer are found in its
+		 * cross lists, and all other branches start with a node in its
+		 * layer lists. Without cross lists, the branches of compressed
+		 * nodes could only be found by searching all layers above, so
+		 * the tree is walked from the root instead, once the layer is
+		 * covered by one.
+		 */
+		cur->step = DBS_CHRISTREE_CUR_LAYER;
+		if(tree->flags & DBS_CHRISTREE_CROSS)
+			cur->step = DBS_CHRISTREE_CUR_CROSS;
+		else if((l = DBS_LOAD(tree->layer[i])) && DBS_LOAD(l->covered))
+			cur->step = DBS_CHRISTREE_CUR_ROOT;
+
+		cur->seed = cur->step == DBS_CHRISTREE_CUR_ROOT ? -1 : i;
+		cur->cand = NULL;
+		cur->cross = NULL;
+		cur->cand_dif = flt->byte[i].lo - 1;
+	}
+
+	return 0;
+}
+
+
+/*
+ * Advance a cursor to the next character matching the condition of the first
+ * restricted layer.
+ *
+ * Returns: 1 if there is one or 0 if all characters have been gone through
+ */
+static s8 dbs_christree_cursor_dif(struct dbs_christree_cursor *cur)
+{
+	struct dbs_chrisbyte *b = &cur->flt.byte[cur->seed];
+
+	do {
+		cur->cand_dif++;
+	} while(cur->cand_dif <= b->hi &&
+			!dbs_chrisbyte_match(b, cur->cand_dif));
+
+	return cur->cand_dif <= b->hi;
+}
+
+
+/*
+ * Get the next position in the tree to start collecting data pointers from.
+ * This is either the root node, or the positions inside the compressed nodes
+ * in the cross lists of the first restricted layer, if the tree has them, and
+ * afterwards the nodes in its layer lists, both only for the matching
+ * characters. When a node is
+ * split by a concurrent writer, its entries keep their place in the cross
+ * lists and the lower part is linked in the layer lists before the entry on
+ * its layer is removed, so searching the lists in this order never misses a
+ * branch.
+ *
+ * Returns: The node of the position or NULL if there are no more positions
+ */
+static struct dbs_christree_node *dbs_christree_cursor_cand(
+		struct dbs_christree_cursor *cur, s32 *pos)
+{
+	struct dbs_christree *tree = cur->tree;
+	struct dbs_christree_node *n_ptr;
+	struct dbs_christree_cross *e;
+	s32 off = cur->seed;
+
+	if(cur->step == DBS_CHRISTREE_CUR_ROOT) {
+		cur->step = DBS_CHRISTREE_CUR_DONE;
+		*pos = 1;
+		return tree->root;
+	}
+
+	while(cur->step == DBS_CHRISTREE_CUR_CROSS) {
+		if((e = cur->cross)) {
+			cur->cross = DBS_LOAD(e->h_v_next);
+
+			n_ptr = DBS_LOAD(e->node);
+			*pos = off - n_ptr->layer;
+
+			DBS_INSTR_COUNT(DBS_INSTR_CAND, 1);
+			return n_ptr;
+		}
+
+		/*
+		 * Continue with the cross list of the next matching character,
+		 * and with the layer lists after the last one.
+		 */
+		if(!dbs_christree_cursor_dif(cur)) {
+			cur->step = DBS_CHRISTREE_CUR_LAYER;
+			cur->cand_dif = cur->flt.byte[off].lo - 1;
+			break;
+		}
+
+		cur->cross = dbs_christree_cross_list(tree, off, cur->cand_dif);
+	}
+
+	while(cur->step == DBS_CHRISTREE_CUR_LAYER) {
+		if((n_ptr = cur->cand)) {
+			cur->cand = DBS_LOAD(n_ptr->h_v_next);
+			*pos = 0;
+
+			DBS_INSTR_COUNT(DBS_INSTR_CAND, 1);
+			return n_ptr;
+		}
+
+		/*
+		 * Continue with the list of the next matching character.
+		 */
+		if(!dbs_christree_cursor_dif(cur)) {
+			cur->step = DBS_CHRISTREE_CUR_DONE;
+			break;
+		}
+
+		cur->cand = dbs_christree_list(tree, off, cur->cand_dif);
+	}
+
+	return NULL;
+}
+
+
+/*
+ * Get the next child of the node on the stack, which matches the filter.
+ * Only the children with a dif character in the range of the condition for
+ * their layer are looked at. The children of a node above the last layer are
+ * data pointers, which only have their dif character to check.
+ *
+ * Returns: The child or NULL if there are no more matching children
+ */
+static struct dbs_christree_node *dbs_christree_cursor_child(
+		struct dbs_christree_cursor *cur, struct dbs_christree_frame *frm)
+{
+	struct dbs_christree_node *n = frm->node;
+	struct dbs_christree_node *n_ptr;
+	struct dbs_chrisbyte *b;
+	s32 layer;
+	s8 vals = dbs_christree_vals(cur->tree, n);
+
+	/*
+	 * Below the filter, all children match.
+	 */
+	if((layer = n->layer + n->pref_len + 1) >= cur->flt.len)
+		return dbs_christree_iter(n, &frm->next);
+
+	b = &cur->flt.byte[layer];
+	if(dbs_chrisbyte_any(b)) {
+		while((n_ptr = dbs_christree_iter(n, &frm->next))) {
+			if(vals || dbs_christree_flt_node(&cur->flt, n_ptr, 1))
+				return n_ptr;
+		}
+
+		return NULL;
+	}
+
+	/*
+	 * Skip all children outside of the range.
+	 */
+	if(frm->next < b->lo)
+		frm->next = b->lo;
+
+	while(frm->next <= b->hi && (n_ptr = dbs_christree_ceil(n, &frm->next))) {
+		if(frm->next > b->hi)
+			break;
+
+		frm->next++;
+
+		if(vals ? dbs_chrisbyte_match(b, frm->next - 1) :
+				dbs_christree_flt_node(&cur->flt, n_ptr, 0))
+			return n_ptr;
+	}
+
+	frm->next = 256;
+	return NULL;
+}
+
+
+/*
+ * Collect data pointers with a cursor until either the limit is reached or
+ * there are no more data pointers. This is the selection engine used both by
+ * the selection and the cursor functions.
+ *
+ * Returns: The number of data pointers written to the array
+ */
+static s32 dbs_christree_cursor_run(struct dbs_christree_cursor *cur,
+		void **data, s32 lim)
+{
+	struct dbs_christree_frame *frm;
+	struct dbs_christree_node *n_ptr;
+	void *ptr;
+	s32 pos;
+	s32 c = 0;
+	s8 below;
+
+	while(c < lim) {
+		/*
+		 * If the current branch is done, search for the next one, which
+		 * matches the rest of the filter.
+		 */
+		if(cur->stk_num == 0) {
+			while((n_ptr = dbs_christree_cursor_cand(cur, &pos))) {
+				if(dbs_christree_flt_node(&cur->flt, n_ptr, pos))
+					break;
+			}
+
+			if(!n_ptr)
+				break;
+
+			cur->stk[0].node = n_ptr;
+			cur->stk[0].next = -1;
+			cur->stk_num = 1;
+		}
+
+		frm = &cur->stk[cur->stk_num - 1];
+
+		/*
+		 * Collect the data pointer of the node itself first, if its
+		 * string covers the whole filter.
+		 */
+		if(frm->next < 0) {
+			frm->next = 0;
+
+			DBS_INSTR_COUNT(DBS_INSTR_VISIT, 1);
+
+			if(dbs_christree_depth(frm->node) >= cur->flt.len &&
+					(ptr = DBS_LOAD(frm->node->data)))
+				data[c++] = ptr;
+
+			continue;
+		}
+
+		/*
+		 * Below the last layer, the children are the data pointers
+		 * themselves, which are collected in one go. If the filter
+		 * ends above them, they don't have to be checked either.
+		 */
+		if(dbs_christree_vals(cur->tree, frm->node)) {
+			below = cur->flt.len < cur->tree->layer_num;
+
+			while(c < lim && (ptr = below ?
+						dbs_christree_iter(frm->node,
+							&frm->next) :
+						dbs_christree_cursor_child(cur,
+							frm)))
+				data[c++] = ptr;
+
+			if(c < lim)
+				cur->stk_num--;
+
+			continue;
+		}
+
+		/*
+		 * Otherwise go through the matching children in ascending
+		 * order. A child without children of its own only has its data
+		 * pointer, so it is collected right away instead of being
+		 * pushed on the stack.
+		 */
+		if((n_ptr = dbs_christree_cursor_child(cur, frm))) {
+			if(!DBS_LOAD(n_ptr->v_next)) {
+				DBS_INSTR_COUNT(DBS_INSTR_VISIT, 1);
+
+				if(dbs_christree_depth(n_ptr) >= cur->flt.len &&
+						(ptr = DBS_LOAD(n_ptr->data)))
+					data[c++] = ptr;
+
+				continue;
+			}
+
+			frm++;
+			frm->node = n_ptr;
+			frm->next = -1;
+			cur->stk_num++;
+		}
+		else {
+			cur->stk_num--;
+		}
+	}
+
+	return c;
+}
+
+
+/*
+ * Run a selection with a temporary cursor. The stack is kept on the call
+ * stack, if the tree isn't too deep.
+ *
+ * Returns: The number of selected pointers or -1 if an error occurred
+ */
+static s32 dbs_christree_sel_flt(struct dbs_christree *tree,
+		struct dbs_chrisfilter *flt, void **data, s32 lim)
+{
+	struct dbs_christree_frame stk_buf[DBS_CHRISTREE_STK_LEN];
+	struct dbs_christree_frame *stk = stk_buf;
+	struct dbs_christree_cursor cur;
+	s32 tmp;
+	s32 c;
+
+	/*
+	 * A branch can't have more nodes than there are layers.
+	 */
+	if(tree->layer_num + 1 > DBS_CHRISTREE_STK_LEN) {
+		tmp = (tree->layer_num + 1) * sizeof(struct dbs_christree_frame);
+		if(!(stk = smalloc(tmp)))
+			return -1;
+	}
+
+	if(dbs_christree_cursor_init(&cur, tree, flt, stk) < 0)
+		c = -1;
+	else
+		c = dbs_christree_cursor_run(&cur, data, lim);
+
+	if(stk != stk_buf)
+		sfree(stk);
+
+	return c;
+}
+
+
+/*
+ * Check if a parallel selection has to stop, because either the limit has
+ * been reached or a worker failed.
+ */
+static s8 dbs_christree_par_done(struct dbs_christree_par *par)
+{
+	return DBS_LOAD(par->fail) ||
+		__atomic_load_n(&par->num, __ATOMIC_RELAXED) >= par->lim;
+}
+
+
+/*
+ * Add a data pointer to the buffer of a worker. The workers only report
+ * their progress once per batch, so they don't write to the same counter all
+ * the time.
+ *
+ * Returns: 0 on success or -1 if the selection has to stop
+ */
+static s8 dbs_christree_par_add(struct dbs_christree_par *par,
+		struct dbs_christree_parbuf *buf, void *ptr)
+{
+	void **tmp;
+	s32 alloc;
+
+	if(buf->num >= buf->alloc) {
+		alloc = buf->alloc ? buf->alloc * 2 : DBS_CHRISTREE_PAR_BATCH;
+		if(!(tmp = srealloc(buf->data, alloc * sizeof(void *)))) {
+			DBS_STORE(par->fail, 1);
+			return -1;
+		}
+
+		buf->data = tmp;
+		buf->alloc = alloc;
+	}
+
+	buf->data[buf->num++] = ptr;
+
+	if(buf->num % DBS_CHRISTREE_PAR_BATCH == 0 &&
+			__atomic_add_fetch(&par->num, DBS_CHRISTREE_PAR_BATCH,
+				__ATOMIC_RELAXED) >= par->lim)
+		return -1;
+
+	return 0;
+}
+
+
+/*
+ * Walk the branch below a node the same way as a cursor, starting with the
+ * given position of the node. While other workers are idle, the rest of the
+ * oldest unfinished node on the stack is pushed as a new task, so the biggest
+ * parts of the branch are handed out first.
+ */
+static void dbs_christree_par_walk(struct dbs_christree_par *par,
+		struct dbs_pool_worker *wrk, struct dbs_christree_node *n,
+		s32 next)
+{
+	struct dbs_christree_parbuf *buf = &par->buf[wrk->id];
+	struct dbs_christree_frame *stk = buf->stk;
+	struct dbs_christree_node *n_ptr;
+	struct dbs_pool_task task;
+	void *ptr;
+	s32 num = 1;
+	s32 low = 0;
+
+	stk[0].node = n;
+	stk[0].next = next;
+
+	while(num > 0) {
+		if(stk[num - 1].next < 0) {
+			stk[num - 1].next = 0;
+
+			if(dbs_christree_depth(stk[num - 1].node) < par->cur.flt.len ||
+					!(ptr = DBS_LOAD(stk[num - 1].node->data)))
+				continue;
+
+			if(dbs_christree_par_add(par, buf, ptr) < 0)
+				return;
+
+			continue;
+		}
+
+		if(!(n_ptr = dbs_christree_cursor_child(&par->cur,
+						&stk[num - 1]))) {
+			num--;
+			continue;
+		}
+
+		if(dbs_christree_vals(par->cur.tree, stk[num - 1].node)) {
+			if(dbs_christree_par_add(par, buf, n_ptr) < 0)
+				return;
+
+			continue;
+		}
+
+		if(dbs_pool_idle(wrk)) {
+			while(low < num && stk[low].next > 255)
+				low++;
+
+			if(low < num) {
+				task.ptr = stk[low].node;
+				task.arg[0] = DBS_CHRISTREE_TASK_NODE;
+				task.arg[1] = stk[low].next;
+
+				if(dbs_pool_push(wrk, &task) == 0)
+					stk[low].next = 256;
+			}
+		}
+
+		stk[num].node = n_ptr;
+		stk[num].next = -1;
+		num++;
+	}
+}
+
+
+/*
+ * Go through a layer list starting with the given node, and walk the branches
+ * below every node matching the filter. While other workers are idle, the
+ * rest of the list is pushed as a new task.
+ */
+static void dbs_christree_par_list(struct dbs_christree_par *par,
+		struct dbs_pool_worker *wrk, struct dbs_christree_node *n)
+{
+	struct dbs_pool_task task;
+
+	for(; n; n = DBS_LOAD(n->h_v_next)) {
+		if(dbs_christree_par_done(par))
+			return;
+
+		if(!dbs_christree_flt_node(&par->cur.flt, n, 0))
+			continue;
+
+		if(dbs_pool_idle(wrk) && (task.ptr = DBS_LOAD(n->h_v_next))) {
+			task.arg[0] = DBS_CHRISTREE_TASK_LAYER;
+			task.arg[1] = 0;
+
+			if(dbs_pool_push(wrk, &task) == 0) {
+				dbs_christree_par_walk(par, wrk, n, -1);
+				return;
+			}
+		}
+
+		dbs_christree_par_walk(par, wrk, n, -1);
+	}
+}
+
+
+/*
+ * Go through a cross list starting with the given entry, the same way as
+ * through a layer list. The compressed nodes are only checked from their
+ * byte on the first restricted layer on.
+ */
+static void dbs_christree_par_cross(struct dbs_christree_par *par,
+		struct dbs_pool_worker *wrk, struct dbs_christree_cross *e)
+{
+	struct dbs_christree_node *n;
+	struct dbs_pool_task task;
+
+	for(; e; e = DBS_LOAD(e->h_v_next)) {
+		if(dbs_christree_par_done(par))
+			return;
+
+		n = DBS_LOAD(e->node);
+		if(!dbs_christree_flt_node(&par->cur.flt, n,
+					par->cur.seed - n->layer))
+			continue;
+
+		if(dbs_pool_idle(wrk) && (task.ptr = DBS_LOAD(e->h_v_next))) {
+			task.arg[0] = DBS_CHRISTREE_TASK_CROSS;
+			task.arg[1] = 0;
+
+			if(dbs_pool_push(wrk, &task) == 0) {
+				dbs_christree_par_walk(par, wrk, n, -1);
+				return;
+			}
+		}
+
+		dbs_christree_par_walk(par, wrk, n, -1);
+	}
+}
+
+
+/*
+ * Run a single task of a parallel selection.
+ */
+static void dbs_christree_par_task(struct dbs_pool_worker *wrk,
+		struct dbs_pool_task *task, void *ctx)
+{
+	struct dbs_christree_par *par = ctx;
+
+	if(dbs_christree_par_done(par))
+		return;
+
+	if(task->arg[0] == DBS_CHRISTREE_TASK_NODE)
+		dbs_christree_par_walk(par, wrk, task->ptr, task->arg[1]);
+	else if(task->arg[0] == DBS_CHRISTREE_TASK_CROSS)
+		dbs_christree_par_cross(par, wrk, task->ptr);
+	else
+		dbs_christree_par_list(par, wrk, task->ptr);
+}
+
+
+/*
+ * Add a task for every non-empty list a cursor would search for branches, or
+ * a single task for the root, if the whole tree has to be walked.
+ *
+ * Returns: The number of tasks
+ */
+static s32 dbs_christree_par_seed(struct dbs_christree_par *par,
+		struct dbs_pool_task *task)
+{
+	struct dbs_christree_cursor *cur = &par->cur;
+	struct dbs_christree *tree = cur->tree;
+	struct dbs_christree_node *n_ptr;
+	struct dbs_christree_cross *e;
+	struct dbs_chrisbyte *b;
+	s32 num = 0;
+	s32 j;
+
+	if(cur->step == DBS_CHRISTREE_CUR_ROOT) {
+		task[0].ptr = tree->root;
+		task[0].arg[0] = DBS_CHRISTREE_TASK_NODE;
+		task[0].arg[1] = -1;
+		return 1;
+	}
+
+	b = &cur->flt.byte[cur->seed];
+	for(j = b->lo; j <= b->hi; j++) {
+		if(!dbs_chrisbyte_match(b, j))
+			continue;
+
+		if((e = dbs_christree_cross_list(tree, cur->seed, j))) {
+			task[num].ptr = e;
+			task[num].arg[0] = DBS_CHRISTREE_TASK_CROSS;
+			task[num].arg[1] = 0;
+			num++;
+		}
+
+		if((n_ptr = dbs_christree_list(tree, cur->seed, j))) {
+			task[num].ptr = n_ptr;
+			task[num].arg[0] = DBS_CHRISTREE_TASK_LAYER;
+			task[num].arg[1] = 0;
+			num++;
+		}
+	}
+
+	return num;
+}
+
+
+/*
+ * Run a selection with a filter on a pool. Every worker gets a buffer and a
+ * stack of its own, which are merged into the array at the end.
+ *
+ * Returns: The number of selected pointers or -1 if an error occurred
+ */
+static s32 dbs_christree_par_flt(struct dbs_christree *tree,
+		struct dbs_pool *pool, struct dbs_chrisfilter *flt,
+		void **data, s32 lim)
+{
+	struct dbs_christree_par par;
+	struct dbs_christree_frame *stk;
+	struct dbs_pool_task *task;
+	s32 task_num;
+	s32 stk_len;
+	s32 tmp;
+	s32 c = 0;
+	s32 i;
+	s32 j;
+
+	if(dbs_christree_cursor_init(&par.cur, tree, flt, NULL) < 0)
+		return -1;
+
+	/*
+	 * Allocate the buffers together with the stacks and room for a task
+	 * for every list, which could hold a branch.
+	 */
+	stk_len = tree->layer_num + 1;
+	tmp = pool->wrk_num * (sizeof(struct dbs_christree_parbuf) +
+			stk_len * sizeof(struct dbs_christree_frame)) +
+		2 * 256 * sizeof(struct dbs_pool_task);
+	if(!(par.buf = smalloc(tmp)))
+		return -1;
+
+	stk = (struct dbs_christree_frame *)(par.buf + pool->wrk_num);
+	task = (struct dbs_pool_task *)(stk + pool->wrk_num * stk_len);
+
+	for(i = 0; i < pool->wrk_num; i++) {
+		par.buf[i].data = NULL;
+		par.buf[i].num = 0;
+		par.buf[i].alloc = 0;
+		par.buf[i].stk = stk + i * stk_len;
+	}
+
+	par.lim = lim;
+	par.num = 0;
+	par.fail = 0;
+
+	task_num = dbs_christree_par_seed(&par, task);
+
+	if(dbs_pool_run(pool, dbs_christree_par_task, &par, task,
+				task_num) < 0)
+		par.fail = 1;
+
+	for(i = 0; i < pool->wrk_num; i++) {
+		for(j = 0; j < par.buf[i].num && c < lim; j++)
+			data[c++] = par.buf[i].data[j];
+
+		if(par.buf[i].data)
+			sfree(par.buf[i].data);
+	}
+
+	sfree(par.buf);
+	return par.fail ? -1 : c;
+}
+
+
+/*
+ * Allocate a cursor together with its stack and room for the given number of
+ * conditions.
+ */
+static struct dbs_christree_cursor *dbs_christree_cursor_new(
+		struct dbs_christree *tree, s32 len)
+{
+	struct dbs_christree_cursor *cur;
+	s32 stk_len;
+	s32 tmp;
+
+	/*
+	 * A branch can't have more nodes than there are layers.
+	 */
+	stk_len = tree->layer_num + 1;
+	tmp = sizeof(struct dbs_christree_cursor) +
+		stk_len * sizeof(struct dbs_christree_frame) +
+		len * sizeof(struct dbs_chrisbyte);
+	if(!(cur = smalloc(tmp)))
+		return NULL;
+
+	cur->stk = (struct dbs_christree_frame *)(cur + 1);
+	cur->flt.len = len;
+	cur->flt.byte = (struct dbs_chrisbyte *)(cur->stk + stk_len);
+	return cur;
+}
+
+
+/*
+ * Check if a mask fits into the tree.
+ */
+static s8 dbs_chrismask_check(struct dbs_christree *tree,
+		struct dbs_chrismask *mask)
+{
+	return mask->off >= 0 && mask->len >= 1 &&
+		mask->off + mask->len <= tree->layer_num;
+}
+
+
+/*
+ * Run a selection with a mask, either on the calling thread or on a pool.
+ *
+ * Returns: The number of selected pointers or -1 if an error occurred
+ */
+static s32 dbs_christree_sel_mask(struct dbs_christree *tree,
+		struct dbs_pool *pool, struct dbs_chrismask *mask,
+		void **data, s32 lim)
+{
+	struct dbs_chrisbyte byte_buf[DBS_CHRISTREE_STK_LEN];
+	struct dbs_chrisbyte *byte = byte_buf;
+	struct dbs_chrisfilter flt;
+	s32 tmp;
+	s32 c;
+
+	if(!dbs_chrismask_check(tree, mask)) {
+		ALARM(ALARM_WARN, "mask invalid");
+		return -1;
+	}
+
+	/*
+	 * Convert the mask to a filter, which will only be allocated for
+	 * really deep trees.
+	 */
+	if(mask->off + mask->len > DBS_CHRISTREE_STK_LEN) {
+		tmp = (mask->off + mask->len) * sizeof(struct dbs_chrisbyte);
+		if(!(byte = smalloc(tmp)))
+			goto err_return;
+	}
+
+	dbs_chrismask_conv(mask, &flt, byte);
+
+	if(pool)
+		c = dbs_christree_par_flt(tree, pool, &flt, data, lim);
+	else
+		c = dbs_christree_sel_flt(tree, &flt, data, lim);
+
+	if(byte != byte_buf)
+		sfree(byte);
+
+	if(c < 0)
+		goto err_return;
+
+	return c;
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to select data pointers");
+	return -1;
+}
+
+
+DBS_API s32 dbs_christree_sel(struct dbs_christree *tree,
+		struct dbs_chrismask *mask, void **data, s32 lim)
+{
+	s32 c;
+	DBS_INSTR_VAR(t)
+
+	if(!tree || !mask || !mask->data || !data || lim < 1) {
+		ALARM(ALARM_WARN, "tree or mask or data undefined or lim invalid");
+		return -1;
+	}
+
+	DBS_INSTR_BEGIN(t);
+	c = dbs_christree_sel_mask(tree, NULL, mask, data, lim);
+	DBS_INSTR_END(DBS_INSTR_OP_SEL, t);
+
+	return c;
+}
+
+
+DBS_API s32 dbs_christree_filter(struct dbs_christree *tree,
+		struct dbs_chrisfilter *flt, void **data, s32 lim)
+{
+	s32 c;
+	DBS_INSTR_VAR(t)
+
+	if(!tree || !flt || !data || lim < 1) {
+		ALARM(ALARM_WARN, "tree or flt or data undefined or lim invalid");
+		return -1;
+	}
+
+	DBS_INSTR_BEGIN(t);
+	c = dbs_christree_sel_flt(tree, flt, data, lim);
+	DBS_INSTR_END(DBS_INSTR_OP_SEL, t);
+
+	if(c < 0)
+		goto err_return;
+
+	return c;
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to select data pointers");
+	return -1;
+}
+
+
+DBS_API struct dbs_christree_cursor *dbs_christree_sel_open(
+		struct dbs_christree *tree, struct dbs_chrismask *mask)
+{
+	struct dbs_christree_cursor *cur;
+	struct dbs_chrisfilter flt;
+
+	if(!tree || !mask || !mask->data) {
+		ALARM(ALARM_WARN, "tree or mask undefined");
+		return NULL;
+	}
+
+	if(!dbs_chrismask_check(tree, mask)) {
+		ALARM(ALARM_WARN, "mask invalid");
+		return NULL;
+	}
+
+	if(!(cur = dbs_christree_cursor_new(tree, mask->off + mask->len)))
+		goto err_return;
+
+	dbs_chrismask_conv(mask, &flt, cur->flt.byte);
+
+	if(dbs_christree_cursor_init(cur, tree, &flt, cur->stk) < 0)
+		goto err_free_cur;
+
+	return cur;
+
+err_free_cur:
+	sfree(cur);
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to open cursor");
+	return NULL;
+}
+
+
+DBS_API struct dbs_christree_cursor *dbs_christree_filter_open(
+		struct dbs_christree *tree, struct dbs_chrisfilter *flt)
+{
+	struct dbs_christree_cursor *cur;
+	struct dbs_chrisfilter copy;
+
+	if(!tree || !flt) {
+		ALARM(ALARM_WARN, "tree or flt undefined");
+		return NULL;
+	}
+
+	if(flt->len < 0 || flt->len > tree->layer_num) {
+		ALARM(ALARM_WARN, "filter invalid");
+		return NULL;
+	}
+
+	if(!(cur = dbs_christree_cursor_new(tree, flt->len)))
+		goto err_return;
+
+	/*
+	 * Use a copy of the conditions, so the filter can be closed.
+	 */
+	copy.len = flt->len;
+	copy.byte = cur->flt.byte;
+	memcpy(copy.byte, flt->byte, flt->len * sizeof(struct dbs_chrisbyte));
+
+	if(dbs_christree_cursor_init(cur, tree, &copy, cur->stk) < 0)
+		goto err_free_cur;
+
+	return cur;
+
+err_free_cur:
+	sfree(cur);
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to open cursor");
+	return NULL;
+}
+
+
+DBS_API void dbs_christree_sel_close(struct dbs_christree_cursor *cur)
+{
+	if(!cur) {
+		ALARM(ALARM_WARN, "cur undefined");
+		return;
+	}
+
+	sfree(cur);
+}
+
+
+DBS_API s32 dbs_christree_sel_next(struct dbs_christree_cursor *cur,
+		void **data, s32 lim)
+{
+	if(!cur || !data || lim < 1) {
+		ALARM(ALARM_WARN, "cur or data undefined or lim invalid");
+		return -1;
+	}
+
+	return dbs_christree_cursor_run(cur, data, lim);
+}
+
+
+DBS_API s32 dbs_christree_sel_par(struct dbs_christree *tree,
+		struct dbs_pool *pool, struct dbs_chrismask *mask,
+		void **data, s32 lim)
+{
+	if(!tree || !pool || !mask || !mask->data || !data || lim < 1) {
+		ALARM(ALARM_WARN, "tree or pool or mask or data undefined or lim invalid");
+		return -1;
+	}
+
+	return dbs_christree_sel_mask(tree, pool, mask, data, lim);
+}
+
+
+DBS_API s32 dbs_christree_filter_par(struct dbs_christree *tree,
+		struct dbs_pool *pool, struct dbs_chrisfilter *flt,
+		void **data, s32 lim)
+{
+	s32 c;
+
+	if(!tree || !pool || !flt || !data || lim < 1) {
+		ALARM(ALARM_WARN, "tree or pool or flt or data undefined or lim invalid");
+		return -1;
+	}
+
+	if((c = dbs_christree_par_flt(tree, pool, flt, data, lim)) < 0)
+		goto err_return;
+
+	return c;
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to select data pointers");
+	return -1;
+}
+
+
+/*
+ * Push a node onto the stack of a scan and write its bytes into the key. If
+ * the key of the node is not below the upper bound of the scan, neither the
+ * node nor any node after it is in the range.
+ *
+ * Returns: 0 on success or -1 if the end of the range has been reached
+ */
+static s8 dbs_christree_scan_push(struct dbs_christree_scan *scan,
+		struct dbs_christree_node *n)
+{
+	struct dbs_christree_frame *frm;
+	s32 depth = dbs_christree_depth(n);
+	s32 i;
+
+	scan->key[n->layer] = n->dif;
+	memcpy(scan->key + n->layer + 1, n->pref, n->pref_len);
+
+	/*
+	 * The bytes only have to be compared with the upper bound, as long as
+	 * the path above is equal to it.
+	 */
+	if(scan->hi && scan->hi_eq >= n->layer) {
+		for(i = n->layer; i < depth; i++) {
+			if(scan->key[i] != scan->hi[i])
+				break;
+		}
+
+		if(i < depth && scan->key[i] > scan->hi[i])
+			return -1;
+
+		if(i >= scan->tree->layer_num)
+			return -1;
+
+		scan->hi_eq = i;
+	}
+
+	frm = &scan->stk[scan->stk_num++];
+	frm->node = n;
+	frm->next = -1;
+	return 0;
+}
+
+
+/*
+ * Write the dif character of a data pointer from the v_next list of a node
+ * above the last layer into the key, and check the key against the upper
+ * bound the same way as dbs_christree_scan_push().
+ *
+ * Returns: 0 on success or -1 if the end of the range has been reached
+ */
+static s8 dbs_christree_scan_val(struct dbs_christree_scan *scan, u8 dif)
+{
+	s32 last = scan->tree->layer_num - 1;
+
+	scan->key[last] = dif;
+
+	if(scan->hi && scan->hi_eq >= last && dif >= scan->hi[last])
+		return -1;
+
+	return 0;
+}
+
+
+/*
+ * Pop the topmost node from the stack of a scan.
+ */
+static void dbs_christree_scan_pop(struct dbs_christree_scan *scan)
+{
+	s32 depth;
+
+	if(--scan->stk_num < 1)
+		return;
+
+	depth = dbs_christree_depth(scan->stk[scan->stk_num - 1].node);
+	if(scan->hi_eq > depth)
+		scan->hi_eq = depth;
+}
+
+
+/*
+ * Prepare a scan and walk down to the first key, which is either equal to or
+ * bigger than the lower bound, or only bigger, if the bound is exclusive.
+ * Every branch on the way, which lies completely below the bound, is skipped.
+ * The scan will use the given stack and key buffer, which have to stay valid
+ * while the scan is used.
+ */
+static void dbs_christree_scan_init(struct dbs_christree_scan *scan,
+		struct dbs_christree *tree, u8 *lo, s8 incl, u8 *hi,
+		struct dbs_christree_frame *stk, u8 *key)
+{
+	struct dbs_christree_frame *frm;
+	struct dbs_christree_node *n_ptr;
+	s32 depth;
+	s32 r;
+
+	scan->tree = tree;
+	scan->hi = hi;
+	scan->hi_eq = 0;
+	scan->key = key;
+	scan->stk = stk;
+	scan->stk_num = 1;
+
+	/*
+	 * The root has no bytes of its own.
+	 */
+	stk[0].node = tree->root;
+	stk[0].next = -1;
+	if(!lo)
+		return;
+
+	while(1) {
+		frm = &scan->stk[scan->stk_num - 1];
+
+		/*
+		 * The path is equal to the lower bound.
+		 */
+		if((depth = dbs_christree_depth(frm->node)) >= tree->layer_num) {
+			frm->next = incl ? -1 : 0;
+			return;
+		}
+
+		/*
+		 * Otherwise the node itself is below the bound, so continue with
+		 * the first child not below the bound. The data pointers below a
+		 * node above the last layer only have their dif character.
+		 */
+		frm->next = lo[depth];
+		if(dbs_christree_vals(tree, frm->node)) {
+			if(!incl)
+				frm->next++;
+
+			return;
+		}
+
+		if(!(n_ptr = dbs_christree_iter(frm->node, &frm->next)))
+			return;
+
+		if(n_ptr->dif == lo[depth]) {
+			r = memcmp(n_ptr->pref, lo + depth + 1, n_ptr->pref_len);
+			if(r < 0)
+				return;
+
+			if(r == 0) {
+				if(dbs_christree_scan_push(scan, n_ptr) < 0)
+					break;
+
+				continue;
+			}
+		}
+
+		/*
+		 * The whole branch is above the bound.
+		 */
+		if(dbs_christree_scan_push(scan, n_ptr) < 0)
+			break;
+
+		return;
+	}
+
+	scan->stk_num = 0;
+}
+
+
+/*
+ * Collect keys and data pointers with a scan until either the limit or the
+ * end of the range is reached.
+ *
+ * Returns: The number of data pointers written to the array
+ */
+static s32 dbs_christree_scan_run(struct dbs_christree_scan *scan,
+		u8 *keys, void **data, s32 lim)
+{
+	struct dbs_christree_frame *frm;
+	struct dbs_christree_node *n_ptr;
+	s32 key_len = scan->tree->layer_num;
+	void *ptr;
+	s32 depth;
+	s32 c = 0;
+
+	while(c < lim && scan->stk_num > 0) {
+		frm = &scan->stk[scan->stk_num - 1];
+
+		/*
+		 * Collect the data pointer of the node itself first. A shorter
+		 * key is padded in the key of the scan.
+		 */
+		if(frm->next < 0) {
+			frm->next = 0;
+
+			if((ptr = DBS_LOAD(frm->node->data))) {
+				depth = dbs_christree_depth(frm->node);
+				memset(scan->key + depth, 0, key_len - depth);
+
+				if(keys)
+					memcpy(keys + c * key_len, scan->key, key_len);
+
+				data[c++] = ptr;
+			}
+
+			continue;
+		}
+
+		/*
+		 * Then go through the children in ascending order, until the
+		 * upper bound is reached. Below the last layer, they are the
+		 * data pointers themselves.
+		 */
+		if(!(n_ptr = dbs_christree_iter(frm->node, &frm->next))) {
+			dbs_christree_scan_pop(scan);
+		}
+		else if(!dbs_christree_vals(scan->tree, frm->node)) {
+			if(dbs_christree_scan_push(scan, n_ptr) < 0)
+				scan->stk_num = 0;
+		}
+		else if(dbs_christree_scan_val(scan, frm->next - 1) < 0) {
+			scan->stk_num = 0;
+		}
+		else {
+			if(keys)
+				memcpy(keys + c * key_len, scan->key, key_len);
+
+			data[c++] = n_ptr;
+		}
+	}
+
+	return c;
+}
+
+
+/*
+ * Get the first key of the tree, which is not below the given string.
+ *
+ * Returns: 1 if a key has been found, 0 if not or -1 if an error occurred
+ */
+static s8 dbs_christree_bound(struct dbs_christree *tree, u8 *str, s8 incl,
+		u8 *key, void **data)
+{
+	struct dbs_christree_frame stk_buf[DBS_CHRISTREE_STK_LEN];
+	struct dbs_christree_frame *stk = stk_buf;
+	struct dbs_christree_scan scan;
+	u8 key_buf[DBS_CHRISTREE_STK_LEN];
+	u8 *key_ptr = key ? key : key_buf;
+	void *data_buf;
+	s32 tmp;
+	s32 c;
+
+	/*
+	 * A branch can't have more nodes than there are layers.
+	 */
+	if(tree->layer_num + 1 > DBS_CHRISTREE_STK_LEN) {
+		tmp = (tree->layer_num + 1) * sizeof(struct dbs_christree_frame);
+		if(!(stk = smalloc(tmp)))
+			return -1;
+
+		if(!key && !(key_ptr = smalloc(tree->layer_num))) {
+			sfree(stk);
+			return -1;
+		}
+	}
+
+	dbs_christree_scan_init(&scan, tree, str, incl, NULL, stk, key_ptr);
+	c = dbs_christree_scan_run(&scan, NULL, &data_buf, 1);
+
+	if(c && data)
+		*data = data_buf;
+
+	if(stk != stk_buf)
+		sfree(stk);
+
+	if(key_ptr != key && key_ptr != key_buf)
+		sfree(key_ptr);
+
+	return c;
+}
+
+
+DBS_API s8 dbs_christree_lower_bound(struct dbs_christree *tree, u8 *str,
+		u8 *key, void **data)
+{
+	s8 r;
+
+	if(!tree || !str) {
+		ALARM(ALARM_WARN, "tree or str undefined");
+		return -1;
+	}
+
+	if((r = dbs_christree_bound(tree, str, 1, key, data)) < 0)
+		goto err_return;
+
+	return r;
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to search lower bound");
+	return -1;
+}
+
+
+DBS_API s8 dbs_christree_upper_bound(struct dbs_christree *tree, u8 *str,
+		u8 *key, void **data)
+{
+	s8 r;
+
+	if(!tree || !str) {
+		ALARM(ALARM_WARN, "tree or str undefined");
+		return -1;
+	}
+
+	if((r = dbs_christree_bound(tree, str, 0, key, data)) < 0)
+		goto err_return;
+
+	return r;
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to search upper bound");
+	return -1;
+}
+
+
+DBS_API s32 dbs_christree_range(struct dbs_christree *tree, u8 *lo, u8 *hi,
+		u8 *keys, void **data, s32 lim)
+{
+	struct dbs_christree_scan *scan;
+	s32 c;
+
+	if(!tree || !data || lim < 1) {
+		ALARM(ALARM_WARN, "tree or data undefined or lim invalid");
+		return -1;
+	}
+
+	if(!(scan = dbs_christree_range_open(tree, lo, hi)))
+		goto err_return;
+
+	c = dbs_christree_scan_run(scan, keys, data, lim);
+
+	dbs_christree_range_close(scan);
+	return c;
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to scan range");
+	return -1;
+}
+
+
+DBS_API struct dbs_christree_scan *dbs_christree_range_open(
+		struct dbs_christree *tree, u8 *lo, u8 *hi)
+{
+	struct dbs_christree_scan *scan;
+	struct dbs_christree_frame *stk;
+	u8 *key;
+	u8 *hi_copy = NULL;
+	s32 stk_len;
+	s32 tmp;
+
+	if(!tree) {
+		ALARM(ALARM_WARN, "tree undefined");
+		return NULL;
+	}
+
+	/*
+	 * Allocate the scan together with the stack, the key and the copy of
+	 * the upper bound. A branch can't have more nodes than there are
+	 * layers.
+	 */
+	stk_len = tree->layer_num + 1;
+	tmp = sizeof(struct dbs_christree_scan) +
+		stk_len * sizeof(struct dbs_christree_frame) +
+		2 * tree->layer_num;
+	if(!(scan = smalloc(tmp)))
+		goto err_return;
+
+	stk = (struct dbs_christree_frame *)(scan + 1);
+	key = (u8 *)(stk + stk_len);
+
+	if(hi) {
+		hi_copy = key + tree->layer_num;
+		memcpy(hi_copy, hi, tree->layer_num);
+	}
+
+	dbs_christree_scan_init(scan, tree, lo, 1, hi_copy, stk, key);
+	return scan;
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to open scan");
+	return NULL;
+}
+
+
+DBS_API void dbs_christree_range_close(struct dbs_christree_scan *scan)
+{
+	if(!scan) {
+		ALARM(ALARM_WARN, "scan undefined");
+		return;
+	}
+
+	sfree(scan);
+}
+
+
+DBS_API s32 dbs_christree_range_next(struct dbs_christree_scan *scan,
+		u8 *keys, void **data, s32 lim)
+{
+	if(!scan || !data || lim < 1) {
+		ALARM(ALARM_WARN, "scan or data undefined or lim invalid");
+		return -1;
+	}
+
+	return dbs_christree_scan_run(scan, keys, data, lim);
+}
+
+
+/*
+ * Walk through the whole tree and put every string with a data pointer into
+ * a hash map.
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+static s8 dbs_christree_index_fill(struct dbs_christree *tree,
+		struct dbs_hashmap *map)
+{
+	struct dbs_christree_frame *stk;
+	struct dbs_christree_node *n;
+	u8 *key;
+	s32 stk_len;
+	s32 num = 1;
+	s8 ret = 0;
+
+	/*
+	 * A branch can't have more nodes than there are layers.
+	 */
+	stk_len = tree->layer_num + 1;
+	if(!(stk = smalloc(stk_len * sizeof(struct dbs_christree_frame) +
+					tree->layer_num)))
+		return -1;
+
+	key = (u8 *)(stk + stk_len);
+
+	stk[0].node = tree->root;
+	stk[0].next = 0;
+
+	while(num > 0 && ret == 0) {
+		if(!(n = dbs_christree_iter(stk[num - 1].node, &stk[num - 1].next))) {
+			num--;
+			continue;
+		}
+
+		if(dbs_christree_vals(tree, stk[num - 1].node)) {
+			key[tree->layer_num - 1] = stk[num - 1].next - 1;
+			if(dbs_hashmap_set(map, key, tree->layer_num, n) < 0)
+				ret = -1;
+
+			continue;
+		}
+
+		key[n->layer] = n->dif;
+		memcpy(key + n->layer + 1, n->pref, n->pref_len);
+
+		if(n->data && dbs_hashmap_set(map, key, dbs_christree_depth(n),
+					n->data) < 0)
+			ret = -1;
+
+		stk[num].node = n;
+		stk[num].next = 0;
+		num++;
+	}
+
+	sfree(stk);
+	return ret;
+}
+
+
+DBS_API s8 dbs_christree_index(struct dbs_christree *tree)
+{
+	struct dbs_hashmap *map;
+
+	if(!tree) {
+		ALARM(ALARM_WARN, "tree undefined");
+		return -1;
+	}
+
+	if(tree->index || tree->epoch || tree->main) {
+		ALARM(ALARM_WARN, "tree already indexed or shared");
+		return -1;
+	}
+
+	if(!(map = dbs_hashmap_init()))
+		goto err_return;
+
+	if(dbs_christree_index_fill(tree, map) < 0)
+		goto err_close_map;
+
+	tree->index = map;
+	return 0;
+
+err_close_map:
+	dbs_hashmap_close(map);
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to index tree");
+	return -1;
+}
+
+
+DBS_API void dbs_christree_unindex(struct dbs_christree *tree)
+{
+	if(!tree || !tree->index) {
+		ALARM(ALARM_WARN, "tree undefined or not indexed");
+		return;
 	}
 
-	/*
-	 * Add n to the v_next list of the v_previous node.
-	 */
-	if(dbs_christree_add_v_next(v_prev, n) < 0)
-		goto err_return;
+	dbs_hashmap_close(tree->index);
+	tree->index = NULL;
+}
+
+
+/*
+ * Make sure there's room for one more child in the list of a load.
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+static s8 dbs_christree_load_grow(struct dbs_christree_loader *ld)
+{
+	struct dbs_christree_node **lst;
+	u8 *key;
+	s32 alloc;
+
+	if(ld->lst_num < ld->lst_alloc)
+		return 0;
+
+	alloc = ld->lst_alloc * 2;
+	if(!(lst = srealloc(ld->lst, alloc * sizeof(struct dbs_christree_node *))))
+		return -1;
+
+	ld->lst = lst;
+
+	if(!(key = srealloc(ld->key, alloc)))
+		return -1;
+
+	ld->key = key;
+	ld->lst_alloc = alloc;
+	return 0;
+}
+
+
+/*
+ * Close the topmost open node of a load. All children of the node are known
+ * by now, so the v_next list is created with the exact size. Afterwards the
+ * node is linked into its layer list and added to the children of the node
+ * below it.
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+static s8 dbs_christree_load_close(struct dbs_christree_loader *ld)
+{
+	struct dbs_christree_frame *frm = &ld->stk[ld->stk_num - 1];
+	struct dbs_christree_node *n = frm->node;
+	s32 num = ld->lst_num - frm->next;
+	s32 i;
+
+	if(dbs_christree_load_grow(ld) < 0)
+		return -1;
+
+	if(dbs_christree_next_fill(ld->tree, n, dbs_christree_next_type(num),
+				ld->key + frm->next, ld->lst + frm->next, num) < 0)
+		return -1;
+
+	n->v_next_used = num;
+	if(!dbs_christree_vals(ld->tree, n)) {
+		for(i = frm->next; i < ld->lst_num; i++)
+			ld->lst[i]->v_prev = n;
+	}
 
 	/*
-	 * Add v_prev to the v_previous list of n.
+	 * The root has no layer and no parent. Any other node stays open
+	 * until it is linked, so it is deleted together with its children if
+	 * that fails.
 	 */
-	if(dbs_christree_add_v_prev(n, v_prev) < 0)
-		goto err_rmv_v_next;
+	if(n->layer >= 0 && dbs_christree_link_hori(ld->tree, n) < 0)
+		return -1;
 
-	return 0;
+	ld->lst_num = frm->next;
+	ld->stk_num--;
 
-err_rmv_v_next:
-	dbs_christree_rmv_v_next(v_prev, n);
+	if(n->layer < 0)
+		return 0;
 
-err_return:
-	return -1;
+	ld->key[ld->lst_num] = n->dif;
+	ld->lst[ld->lst_num++] = n;
+	return 0;
 }
 
 
-DBS_API s8 dbs_christree_unlink_verti(struct dbs_christree_node *n,
-		struct dbs_christree_node *v_prev)
+/*
+ * Split the topmost open node of a load, so that it ends before the given
+ * layer. The lower part takes over the children and the data pointer, and is
+ * closed right away. On the last layer, the lower part is only the last byte
+ * and the data pointer, which become a child of the node.
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+static s8 dbs_christree_load_split(struct dbs_christree_loader *ld,
+		s32 layer)
 {
-	if(!n || !v_prev) {
-		ALARM(ALARM_WARN, "n or v_prev undefined");
-		return -1;
+	struct dbs_christree_frame *frm = &ld->stk[ld->stk_num - 1];
+	struct dbs_christree_node *n = frm->node;
+	struct dbs_christree_node *n_lower;
+	s32 off = layer - n->layer - 1;
+
+	if(layer == ld->tree->layer_num - 1) {
+		if(dbs_christree_load_grow(ld) < 0)
+			return -1;
+
+		ld->key[ld->lst_num] = n->pref[off];
+		ld->lst[ld->lst_num++] = n->data;
+
+		n->pref_len = off;
+		n->data = NULL;
+		return 0;
 	}
 
-	dbs_christree_rmv_v_next(v_prev, n);
+	if(!(n_lower = dbs_christree_new(ld->tree, layer, n->pref[off])))
+		return -1;
 
-	dbs_christree_rmv_v_prev(n);
+	n_lower->pref_len = n->pref_len - off - 1;
+	memcpy(n_lower->pref, n->pref + off + 1, n_lower->pref_len);
+	n_lower->data = n->data;
 
-	return 0;
+	n->pref_len = off;
+	n->data = NULL;
+
+	/*
+	 * The lower node gets all children collected for the node so far.
+	 */
+	ld->stk[ld->stk_num].node = n_lower;
+	ld->stk[ld->stk_num].next = frm->next;
+	ld->stk_num++;
+
+	return dbs_christree_load_close(ld);
 }
 
 
-DBS_API s8 dbs_christree_link_node(struct dbs_christree *tree,
-		struct dbs_christree_node *node,
-		struct dbs_christree_node *v_prev)
+/*
+ * Add the next key to a load. All open nodes, which aren't on the path of the
+ * new key, are closed and new open nodes are created for the rest of the
+ * key, each holding as many bytes as possible.
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+static s8 dbs_christree_load_key(struct dbs_christree_loader *ld,
+		u8 *str, void *data)
 {
-	if(!tree || !node) {
-		ALARM(ALARM_WARN, "tree or node undefined");
+	struct dbs_christree_node *node;
+	struct dbs_christree_frame *frm;
+	s32 layer_num = ld->tree->layer_num;
+	s32 i = 0;
+	s32 len;
+
+	if(!str || !data) {
+		ALARM(ALARM_WARN, "str or data undefined");
 		return -1;
 	}
 
+	if(ld->tree->index && dbs_hashmap_set(ld->tree->index, str, layer_num,
+				data) < 0)
+		return -1;
 
 	/*
-	 * Link node vertically.
+	 * Get the length of the prefix shared with the last key.
 	 */
-	if(dbs_christree_link_verti(node, v_prev) < 0)
-		goto err_return;
+	if(ld->key_num) {
+		while(i < layer_num && str[i] == ld->prev[i])
+			i++;
+
+		if(i == layer_num) {
+			node = ld->stk[ld->stk_num - 1].node;
+			if(dbs_christree_vals(ld->tree, node))
+				ld->lst[ld->lst_num - 1] = data;
+			else
+				node->data = data;
+
+			return 0;
+		}
 
+		if(str[i] < ld->prev[i]) {
+			ALARM(ALARM_WARN, "keys not sorted");
+			return -1;
+		}
+	}
+
+	while(ld->stk[ld->stk_num - 1].node->layer >= i) {
+		if(dbs_christree_load_close(ld) < 0)
+			return -1;
+	}
+
+	node = ld->stk[ld->stk_num - 1].node;
+	if(node->layer + 1 + node->pref_len > i) {
+		if(dbs_christree_load_split(ld, i) < 0)
+			return -1;
+	}
+
+	while(i < layer_num - 1) {
+		if(!(node = dbs_christree_new(ld->tree, i, str[i])))
+			return -1;
+
+		len = layer_num - i - 1;
+		if(len > DBS_CHRISTREE_PREF_MAX)
+			len = DBS_CHRISTREE_PREF_MAX;
+
+		memcpy(node->pref, str + i + 1, len);
+		node->pref_len = len;
+
+		frm = &ld->stk[ld->stk_num++];
+		frm->node = node;
+		frm->next = ld->lst_num;
+
+		i += 1 + len;
+	}
 
 	/*
-	 * Add the node to the layer list.
+	 * A byte left for the last layer is added to the children of the
+	 * topmost open node.
 	 */
-	if(dbs_christree_link_hori(tree, node) < 0)
-		goto err_unlink_verti;
+	if(i < layer_num) {
+		if(dbs_christree_load_grow(ld) < 0)
+			return -1;
+
+		ld->key[ld->lst_num] = str[i];
+		ld->lst[ld->lst_num++] = data;
+	}
+	else {
+		node->data = data;
+	}
 
+	memcpy(ld->prev, str, layer_num);
+	ld->key_num++;
 	return 0;
+}
 
-err_unlink_verti:
-	dbs_christree_unlink_verti(node, v_prev);
 
+/*
+ * Prepare a load into an empty tree.
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+static s8 dbs_christree_load_begin(struct dbs_christree_loader *ld,
+		struct dbs_christree *tree)
+{
+	s32 stk_len;
+	s32 tmp;
 
-err_return:
-	ALARM(ALARM_ERR, "Failed to link node");
-	return -1;
+	if(tree->root->v_next_used || tree->root->data) {
+		ALARM(ALARM_WARN, "tree not empty");
+		return -1;
+	}
+
+	if(!(tree->flags & DBS_CHRISTREE_LEAN) &&
+			dbs_christree_grow(tree, tree->layer_num) < 0)
+		return -1;
+
+	/*
+	 * Allocate the stack together with the last key. There can't be more
+	 * open nodes than there are layers.
+	 */
+	stk_len = tree->layer_num + 1;
+	tmp = stk_len * sizeof(struct dbs_christree_frame) + tree->layer_num;
+	if(!(ld->stk = smalloc(tmp)))
+		return -1;
+
+	ld->lst_alloc = 256;
+	tmp = ld->lst_alloc * sizeof(struct dbs_christree_node *);
+	if(!(ld->lst = smalloc(tmp))) {
+		sfree(ld->stk);
+		return -1;
+	}
+
+	if(!(ld->key = smalloc(ld->lst_alloc))) {
+		sfree(ld->lst);
+		sfree(ld->stk);
+		return -1;
+	}
+
+	ld->tree = tree;
+	ld->prev = (u8 *)(ld->stk + stk_len);
+	ld->key_num = 0;
+	ld->lst_num = 0;
+
+	ld->stk[0].node = tree->root;
+	ld->stk[0].next = 0;
+	ld->stk_num = 1;
+	return 0;
 }
 
 
-DBS_API void dbs_christree_unlink_node(struct dbs_christree *tree, 
-		struct dbs_christree_node *node,
-		struct dbs_christree_node *v_prev)
+/*
+ * Unlink and delete a node, which has been closed by a load, together with
+ * all nodes below it.
+ */
+static void dbs_christree_load_drop(struct dbs_christree *tree,
+		struct dbs_christree_node *node)
 {
-	if(!tree || !node) {
-		ALARM(ALARM_WARN, "tree or node undefined");
-		return;
+	struct dbs_christree_node *n_ptr;
+	s32 it = 0;
+
+	if(!dbs_christree_vals(tree, node)) {
+		while((n_ptr = dbs_christree_iter(node, &it)))
+			dbs_christree_load_drop(tree, n_ptr);
 	}
 
-	/*
-	 * Unlink from the layer list.
-	 */
 	dbs_christree_unlink_hori(tree, node);
-
-	/*
-	 * Unlink the node vertically.
-	 */
-	dbs_christree_unlink_verti(node, v_prev);
+	dbs_christree_del(tree, node);
 }
 
 
-DBS_API s8 dbs_christree_add(struct dbs_christree *tree,
-		u8 *str, void *data)
+/*
+ * Finish a load by closing all open nodes. If the load failed, all nodes
+ * created so far are deleted again, leaving the tree empty.
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+static s8 dbs_christree_load_end(struct dbs_christree_loader *ld, s8 fail)
 {
 	s32 i;
-	struct dbs_christree_node *node;
-	struct dbs_christree_node *n_ptr;
 
-	if(!tree || !str || !data) {
-		ALARM(ALARM_WARN, "tree or str or data undefined");
-		return -1;
+	while(!fail && ld->stk_num > 0) {
+		if(dbs_christree_load_close(ld) < 0)
+			fail = 1;
 	}
 
-	n_ptr = tree->root; 
-	for(i = 0; i < tree->layer_num; i++) {
+	if(fail) {
+		/*
+		 * The children collected for an open node above the last layer
+		 * are data pointers.
+		 */
+		if(ld->stk_num > 0 && dbs_christree_vals(ld->tree,
+					ld->stk[ld->stk_num - 1].node))
+			ld->lst_num = ld->stk[ld->stk_num - 1].next;
+
+		for(i = 0; i < ld->lst_num; i++)
+			dbs_christree_load_drop(ld->tree, ld->lst[i]);
+
+		for(i = 1; i < ld->stk_num; i++)
+			dbs_christree_del(ld->tree, ld->stk[i].node);
 
 		/*
-		 * Check if the required node is already linked below.
+		 * The tree has been empty before, and so has the index.
 		 */
-		if(!(node = dbs_christree_get_v_next(n_ptr, str[i]))) {
+		if(ld->tree->index)
+			dbs_hashmap_clear(ld->tree->index);
+	}
 
-			/*
-			 * Otherwise create a new node and link it.
-			 */
+	sfree(ld->key);
+	sfree(ld->lst);
+	sfree(ld->stk);
+	return fail ? -1 : 0;
+}
 
-			if(!(node = dbs_christree_new(i, str[i])))
-				goto err_return;
 
-			if(dbs_christree_link_node(tree, node, n_ptr) < 0)
-				goto err_del_node;
+DBS_API s8 dbs_christree_load(struct dbs_christree *tree,
+		s8 (*src)(void *arg, u8 **str, void **data), void *arg)
+{
+	struct dbs_christree_loader ld;
+	u8 *str;
+	void *data;
+	s8 r;
 
-		}
-		else {
-		}
+	if(!tree || !src) {
+		ALARM(ALARM_WARN, "tree or src undefined");
+		return -1;
+	}
 
+	if(dbs_christree_load_begin(&ld, tree) < 0)
+		goto err_return;
 
-		n_ptr = node;
+	while((r = src(arg, &str, &data)) > 0) {
+		if(dbs_christree_load_key(&ld, str, data) < 0)
+			break;
 	}
 
-	/*
-	 * Link the datanection.
-	 */
-	n_ptr->data = data;
+	if(dbs_christree_load_end(&ld, r != 0) < 0)
+		goto err_return;
 
 	return 0;
 
-err_del_node:
-	dbs_christree_del(node);
-
 err_return:
-	ALARM(ALARM_ERR, "Failed to add new node to the catree");
+	ALARM(ALARM_ERR, "Failed to load keys");
 	return -1;
 }
 
 
-DBS_API void dbs_christree_rmv(struct dbs_christree *tree,
-		u8 *str)
+DBS_API s8 dbs_christree_load_array(struct dbs_christree *tree,
+		u8 *keys, void **data, s32 num)
 {
-	struct dbs_christree_node *n_ptr;
-	struct dbs_christree_node *n_v_next;
-	struct dbs_christree_node *n_v_prev;
+	struct dbs_christree_loader ld;
 	s32 i;
 
-	if(!tree || !str) {
-		ALARM(ALARM_WARN, "tree or str undefined");
-		return;
-	}	
+	if(!tree || !keys || !data || num < 0) {
+		ALARM(ALARM_WARN, "tree or keys or data undefined or num invalid");
+		return -1;
+	}
 
-	n_ptr = tree->root;
-	for(i = 0; i < tree->layer_num; i++) {
-		if(!(n_v_next = dbs_christree_get_v_next(n_ptr, str[i]))) {
-			return;
-		}
+	if(dbs_christree_load_begin(&ld, tree) < 0)
+		goto err_return;
 
-		n_ptr = n_v_next;
+	for(i = 0; i < num; i++) {
+		if(dbs_christree_load_key(&ld, keys + i * tree->layer_num,
+					data[i]) < 0)
+			break;
 	}
 
-	for(i = tree->layer_num - 1; i >= 0; i--) {
-		n_v_prev = n_ptr->v_prev;
+	if(dbs_christree_load_end(&ld, i < num) < 0)
+		goto err_return;
 
-		if(n_ptr->v_next_used >= 1 || n_v_prev == NULL)
-			return;
+	return 0;
 
-		dbs_christree_unlink_node(tree, n_ptr, n_v_prev);
+err_return:
+	ALARM(ALARM_ERR, "Failed to load keys");
+	return -1;
+}
 
-		dbs_christree_del(n_ptr);
 
-		n_ptr = n_v_prev;
-	}
+/*
+ * Get the bucket of the fan-out histogram for a number of children.
+ */
+static s32 dbs_christree_fanout(s32 num)
+{
+	s32 i = 0;
+
+	if(num < 2)
+		return num;
+
+	while((1 << i) < num)
+		i++;
+
+	return i + 1;
 }
 
 
-DBS_API void dbs_christree_sel_hlf(struct dbs_christree_node *nc, void *d)
+/*
+ * Add the memory of a tree or writer handle to the statistics.
+ */
+static void dbs_christree_stats_mem(struct dbs_christree *tree,
+		struct dbs_christree_stats *stats)
 {
-	struct dbs_christree_sel_pass *pass = d;
+	struct dbs_slab *slab;
 	s32 i;
 
-	if(nc->data != NULL) {
-		pass->data[pass->c] = nc->data;
-		pass->c++;
-	}
+	stats->bytes += sizeof(struct dbs_christree);
 
-	if(pass->c >= pass->lim)
-		return;
+	for(i = 0; i < 6; i++) {
+		if(i == 0)
+			slab = &tree->node_slab;
+		else if(i == 5)
+			slab = &tree->cross_slab;
+		else
+			slab = &tree->next_slab[i - 1];
+
+		stats->bytes += (u64)slab->chunk_num *
+			(sizeof(struct dbs_slab_chunk) +
+			 (u64)slab->per_chunk * slab->size);
 
-	for(i = 0; i < nc->v_next_used; i++) {
-		dbs_christree_sel_hlf(nc->v_next[i], d);
+		/*
+		 * Objects can be freed to the slab of another handle, so only
+		 * the sum over all handles is the number in use.
+		 */
+		stats->bytes_used += (s64)slab->used * slab->size;
 	}
 }
 
 
-
-DBS_API s32 dbs_christree_sel(struct dbs_christree *tree,
-		struct dbs_chrismask *mask, void **data, s32 lim)
+/*
+ * Walk through the whole tree and count the nodes, their children and the
+ * chains of nodes with a single child. Every stack entry carries the length
+ * of the chain ending with its node, which is 0 if the node doesn't continue
+ * a chain.
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+static s8 dbs_christree_stats_walk(struct dbs_christree *tree,
+		struct dbs_christree_stats *stats)
 {
-	struct dbs_christree_sel_pass pass;
+	struct dbs_christree_frame *stk;
+	struct dbs_christree_layer_stats *ls;
+	struct dbs_christree_node *n;
+	s32 *run;
+	s32 stk_len;
+	s32 num = 1;
+	s32 len;
+	s32 tmp;
 	s32 i;
-	s32 j;
-
-	struct dbs_christree_node *lst[64];
-	s32 num;
+	s64 sum = 0;
 
-	if(!tree || !mask || lim < 1) {
-		ALARM(ALARM_WARN, "tree or mask undefined");
+	stk_len = tree->layer_num + 1;
+	if(!(stk = smalloc(stk_len * (sizeof(struct dbs_christree_frame) +
+						sizeof(s32)))))
 		return -1;
+
+	run = (s32 *)(stk + stk_len);
+
+	stk[0].node = tree->root;
+	stk[0].next = 0;
+	run[0] = 0;
+
+	stats->fanout[dbs_christree_fanout(tree->root->v_next_used)]++;
+	if(tree->root->v_next) {
+		tmp = tree->root->v_next->type - DBS_CHRISTREE_N4;
+		stats->next_num[tmp]++;
+		stats->next_slack[tmp] += tree->root->v_next_alloc -
+			tree->root->v_next_used;
 	}
 
-	/*
-	 * Go through the mask to find the branches to collect the nodes from.
-	 */
-	if((num = dbs_christree_get_layer(tree, mask->off, mask->data[0],
-					lst, 64)) < 0)
-		return 0;
+	while(num > 0) {
+		if(!(n = dbs_christree_iter(stk[num - 1].node, &stk[num - 1].next))) {
+			num--;
+			continue;
+		}
 
+		/*
+		 * The strings reaching the last layer have no nodes there.
+		 */
+		if(dbs_christree_vals(tree, stk[num - 1].node)) {
+			stats->layer[tree->layer_num - 1].data_num++;
+			stats->data_num++;
+			stats->layer_num = tree->layer_num;
+			continue;
+		}
 
-	/*
-	 * Set the passing argument for searching recursivly.
-	 */
-	pass.c = 0;
-	pass.lim = lim;
-	pass.data = data;
+		ls = &stats->layer[n->layer];
+		ls->node_num++;
+		ls->child_num += n->v_next_used;
+		stats->node_num++;
 
+		for(i = 1; i <= n->pref_len; i++)
+			stats->layer[n->layer + i].cross++;
 
-	for(i = 0; i < num; i++) {
-		for(j = 1; j < mask->len; j++) {
-			if(!(lst[i] = dbs_christree_get_v_next(lst[i],
-							mask->data[j])))
-				return 0;
+		/*
+		 * A lean tree has no layer lists, so the layers in use are
+		 * only known from the nodes.
+		 */
+		if(dbs_christree_depth(n) > stats->layer_num)
+			stats->layer_num = dbs_christree_depth(n);
+
+		if(n->data) {
+			stats->layer[dbs_christree_depth(n) - 1].data_num++;
+			stats->data_num++;
+		}
+
+		stats->fanout[dbs_christree_fanout(n->v_next_used)]++;
+		if(n->v_next) {
+			tmp = n->v_next->type - DBS_CHRISTREE_N4;
+			stats->next_num[tmp]++;
+			stats->next_slack[tmp] += n->v_next_alloc - n->v_next_used;
 		}
 
 		/*
-		 * Recursivly collect all data connections from branches below
-		 * this node.
+		 * Either continue the chain of the node above, or end it.
 		 */
-		dbs_christree_sel_hlf(lst[i], &pass);
+		len = run[num - 1];
+		if(n->v_next_used == 1 && !n->data) {
+			len += 1 + n->pref_len;
+		}
+		else if(len > 0) {
+			stats->chain_num++;
+			sum += len;
+
+			if(len > stats->chain_max)
+				stats->chain_max = len;
+
+			len = 0;
+		}
+
+		stk[num].node = n;
+		stk[num].next = 0;
+		run[num] = len;
+		num++;
+	}
+
+	if(stats->chain_num > 0)
+		stats->chain_avg = (double)sum / stats->chain_num;
+
+	sfree(stk);
+	return 0;
+}
+
+
+DBS_API struct dbs_christree_stats *dbs_christree_stats_init(
+		struct dbs_christree *tree)
+{
+	struct dbs_christree_stats *stats;
+	struct dbs_christree *wr;
+	s32 tmp;
+
+	if(!tree || tree->main) {
+		ALARM(ALARM_WARN, "tree undefined or a writer handle");
+		return NULL;
+	}
+
+	if(!(stats = smalloc(sizeof(struct dbs_christree_stats))))
+		goto err_return;
+
+	memset(stats, 0, sizeof(struct dbs_christree_stats));
+
+	stats->layer_num = tree->layer_used;
+	tmp = tree->layer_num * sizeof(struct dbs_christree_layer_stats);
+	if(!(stats->layer = smalloc(tmp)))
+		goto err_free_stats;
+
+	memset(stats->layer, 0, tmp);
+
+	if(dbs_christree_stats_walk(tree, stats) < 0)
+		goto err_free_layer;
+
+	dbs_christree_stats_mem(tree, stats);
+	for(wr = tree->handle; wr; wr = wr->handle)
+		dbs_christree_stats_mem(wr, stats);
+
+	stats->bytes += tree->layer_num * sizeof(struct dbs_christree_layer *) +
+		tree->layer_used * sizeof(struct dbs_christree_layer);
+
+	if(tree->index) {
+		stats->bytes += sizeof(struct dbs_hashmap) +
+			tree->index->alloc * sizeof(struct dbs_hashmap_entry);
 	}
 
-	return pass.c;
+	if(stats->data_num > 0)
+		stats->bytes_per_key = (double)stats->bytes / stats->data_num;
 
+	return stats;
+
+err_free_layer:
+	sfree(stats->layer);
+
+err_free_stats:
+	sfree(stats);
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to collect statistics");
+	return NULL;
+}
+
+
+DBS_API void dbs_christree_stats_close(struct dbs_christree_stats *stats)
+{
+	if(!stats) {
+		ALARM(ALARM_WARN, "stats undefined");
+		return;
+	}
+
+	sfree(stats->layer);
+	sfree(stats);
 }
 
-DBS_API s32 dbs_christree_dump_rec(struct dbs_christree_node *n)
+
+DBS_API s32 dbs_christree_dump_rec(struct dbs_christree *tree,
+		struct dbs_christree_node *n)
 {
+	struct dbs_christree_node *n_ptr;
+	s32 it = 0;
 	s32 i;
 	s32 l;
 
@@ -703,11 +5262,29 @@ DBS_API s32 dbs_christree_dump_rec(struct dbs_christree_node *n)
 	}
 
 	printf("- %d (%d): ", l, n->v_next_used);
-	printf("%02x (%c)\n", n->dif, (char)n->dif);
+	printf("%02x (%c)", n->dif, (char)n->dif);
+
+	for(i = 0; i < n->pref_len; i++)
+		printf(" %02x", n->pref[i]);
+
+	printf("\n");
 
 
-	for(i = 0; i < n->v_next_used; i++) {
-		dbs_christree_dump_rec(n->v_next[i]);	
+	while((n_ptr = dbs_christree_iter(n, &it))) {
+		if(!dbs_christree_vals(tree, n)) {
+			dbs_christree_dump_rec(tree, n_ptr);
+			continue;
+		}
+
+		/*
+		 * The data pointers below the node only have a dif character.
+		 */
+		for(i = 0; i < tree->layer_num; i++) {
+			printf("  ");
+		}
+
+		printf("- %d (0): %02x (%c)\n", tree->layer_num, it - 1,
+				(char)(it - 1));
 	}
 
 	return 0;
@@ -721,7 +5298,7 @@ DBS_API s8 dbs_christree_dump(struct dbs_christree *tree)
 		return -1;
 	}
 
-	dbs_christree_dump_rec(tree->root);
+	dbs_christree_dump_rec(tree, tree->root);
 
 	return 0;
 }
@@ -730,6 +5307,8 @@ DBS_API s8 dbs_christree_dump(struct dbs_christree *tree)
 DBS_API s8 dbs_christree_dump_layers(struct dbs_christree *tree)
 {
 	s32 i;
+	s32 j;
+	s32 c;
 	struct dbs_christree_node *n_ptr;
 
 	if(!tree) {
@@ -737,19 +5316,40 @@ DBS_API s8 dbs_christree_dump_layers(struct dbs_christree *tree)
 		return -1;
 	}
 
-	for(i = 0; i < tree->layer_num; i++) {
-		printf("Layer %d(%d): ", i, tree->layer[i].node_num);
+	/*
+	 * The used layers are counted on the tree a handle belongs to.
+	 */
+	if(tree->main)
+		tree = tree->main;
+
+	for(i = 0; i < DBS_LOAD(tree->layer_used); i++) {
+		/*
+		 * The nodes of a layer are only counted when they are needed,
+		 * so linking a node doesn't have to update a shared counter.
+		 */
+		c = 0;
+		for(j = 0; j < 256; j++) {
+			for(n_ptr = tree->layer[i]->node[j]; n_ptr;
+					n_ptr = n_ptr->h_v_next)
+				c++;
+		}
 
-		n_ptr = tree->layer[i].node;
-		while(n_ptr) {
-			printf("%02x (%c, v_next_used %d)", n_ptr->dif, 
-					(char)n_ptr->dif,
-					n_ptr->v_next_used);
+		printf("Layer %d(%d): ", i, c);
 
-			if(n_ptr->h_v_next)
-				printf(", ");
+		c = 0;
+		for(j = 0; j < 256; j++) {
+			n_ptr = tree->layer[i]->node[j];
+			while(n_ptr) {
+				if(c++)
+					printf(", ");
 
-			n_ptr = n_ptr->h_v_next;
+				printf("%02x (%c, v_next_used %d, pref_len %d)",
+						n_ptr->dif, (char)n_ptr->dif,
+						n_ptr->v_next_used,
+						n_ptr->pref_len);
+
+				n_ptr = n_ptr->h_v_next;
+			}
 		}
 
 		printf("\n");
@@ -0,0 +1,286 @@
+#include "epoch.h"
+
+#include "../../alarm/inc/alarm.h"
+
+#include <stdlib.h>
+
+
+DBS_API struct dbs_epoch *dbs_epoch_init(s32 slot_num)
+{
+	struct dbs_epoch *ep;
+	unsigned long addr;
+	s32 tmp;
+	s32 i;
+
+	if(slot_num < 1) {
+		ALARM(ALARM_WARN, "slot_num invalid");
+		return NULL;
+	}
+
+	if(!(ep = smalloc(sizeof(struct dbs_epoch))))
+		goto err_return;
+
+	/*
+	 * Allocate one more line, so the slots can be aligned to the cache
+	 * lines.
+	 */
+	tmp = (slot_num + 1) * sizeof(union dbs_epoch_slot);
+	if(!(ep->slot_mem = smalloc(tmp)))
+		goto err_free_ep;
+
+	addr = (unsigned long)ep->slot_mem;
+	addr = (addr + DBS_EPOCH_LINE - 1) & ~(unsigned long)(DBS_EPOCH_LINE - 1);
+	ep->slot = (union dbs_epoch_slot *)addr;
+	ep->slot_num = slot_num;
+
+	for(i = 0; i < slot_num; i++) {
+		ep->slot[i].rd.epoch = 0;
+		ep->slot[i].rd.ep = ep;
+		ep->slot[i].rd.used = 0;
+	}
+
+	/*
+	 * A reader outside of a read section has the epoch 0, so the epochs
+	 * start with 1.
+	 */
+	ep->epoch = 1;
+
+	return ep;
+
+err_free_ep:
+	sfree(ep);
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to create epoch");
+	return NULL;
+}
+
+
+DBS_API void dbs_epoch_close(struct dbs_epoch *ep)
+{
+	if(!ep) {
+		ALARM(ALARM_WARN, "ep undefined");
+		return;
+	}
+
+	sfree(ep->slot_mem);
+	sfree(ep);
+}
+
+
+DBS_API struct dbs_epoch_reader *dbs_epoch_reader_open(struct dbs_epoch *ep)
+{
+	struct dbs_epoch_reader *rd;
+	s32 exp;
+	s32 i;
+
+	if(!ep) {
+		ALARM(ALARM_WARN, "ep undefined");
+		return NULL;
+	}
+
+	/*
+	 * Claim the first free slot.
+	 */
+	for(i = 0; i < ep->slot_num; i++) {
+		rd = &ep->slot[i].rd;
+		exp = 0;
+
+		if(__atomic_compare_exchange_n(&rd->used, &exp, 1, 0,
+					__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			return rd;
+	}
+
+	ALARM(ALARM_ERR, "No free reader slot");
+	return NULL;
+}
+
+
+DBS_API void dbs_epoch_reader_close(struct dbs_epoch_reader *rd)
+{
+	if(!rd) {
+		ALARM(ALARM_WARN, "rd undefined");
+		return;
+	}
+
+	DBS_STORE(rd->epoch, 0);
+	DBS_STORE(rd->used, 0);
+}
+
+
+DBS_API void dbs_epoch_enter(struct dbs_epoch_reader *rd)
+{
+	u64 e;
+
+	/*
+	 * The epoch of the reader has to be visible to the writer before
+	 * anything of the shared structure is read. If the epoch advances in
+	 * between, the reader just holds back the next advance a bit longer.
+	 */
+	e = __atomic_load_n(&rd->ep->epoch, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&rd->epoch, e, __ATOMIC_SEQ_CST);
+}
+
+
+DBS_API void dbs_epoch_leave(struct dbs_epoch_reader *rd)
+{
+	DBS_STORE(rd->epoch, 0);
+}
+
+
+DBS_API s8 dbs_epoch_writer_init(struct dbs_epoch_writer *wr,
+		struct dbs_epoch *ep)
+{
+	s32 i;
+
+	if(!wr || !ep) {
+		ALARM(ALARM_WARN, "wr or ep undefined");
+		return -1;
+	}
+
+	if(!(wr->rd = dbs_epoch_reader_open(ep)))
+		return -1;
+
+	wr->ep = ep;
+
+	for(i = 0; i < 3; i++) {
+		wr->limbo[i].epoch = 0;
+		wr->limbo[i].item = NULL;
+		wr->limbo[i].num = 0;
+		wr->limbo[i].alloc = 0;
+	}
+
+	return 0;
+}
+
+
+/*
+ * Return all objects of a limbo list to their slabs.
+ */
+static void dbs_epoch_flush(struct dbs_epoch_limbo *limbo)
+{
+	s32 i;
+
+	for(i = 0; i < limbo->num; i++)
+		dbs_slab_free(limbo->item[i].slab, limbo->item[i].ptr);
+
+	limbo->num = 0;
+}
+
+
+DBS_API void dbs_epoch_writer_release(struct dbs_epoch_writer *wr)
+{
+	s32 i;
+
+	if(!wr) {
+		ALARM(ALARM_WARN, "wr undefined");
+		return;
+	}
+
+	for(i = 0; i < 3; i++) {
+		dbs_epoch_flush(&wr->limbo[i]);
+		sfree(wr->limbo[i].item);
+	}
+
+	dbs_epoch_reader_close(wr->rd);
+}
+
+
+DBS_API s8 dbs_epoch_collect(struct dbs_epoch_writer *wr)
+{
+	struct dbs_epoch *ep = wr->ep;
+	s8 ret = 1;
+	u64 e;
+	u64 r;
+	s32 i;
+
+	/*
+	 * Make sure the removals of the writer are visible, before checking
+	 * the readers. ThreadSanitizer doesn't model fences, so it may report
+	 * races between a reader and a writer reusing an object the reader
+	 * could only reach in an older epoch. Those reports are false
+	 * positives, as long as bench/stress.c doesn't find any wrong reads.
+	 */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	e = __atomic_load_n(&ep->epoch, __ATOMIC_SEQ_CST);
+	for(i = 0; i < ep->slot_num; i++) {
+		r = __atomic_load_n(&ep->slot[i].rd.epoch, __ATOMIC_SEQ_CST);
+		if(r && r != e) {
+			ret = 0;
+			break;
+		}
+	}
+
+	/*
+	 * If another writer advanced the epoch in the meantime, that's just
+	 * as good.
+	 */
+	if(ret)
+		__atomic_compare_exchange_n(&ep->epoch, &e, e + 1, 0,
+				__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+
+	/*
+	 * All readers have left the epochs before the last one, so the
+	 * objects retired in them can be returned.
+	 */
+	e = __atomic_load_n(&ep->epoch, __ATOMIC_SEQ_CST);
+	for(i = 0; i < 3; i++) {
+		if(wr->limbo[i].epoch + 2 <= e)
+			dbs_epoch_flush(&wr->limbo[i]);
+	}
+
+	return ret;
+}
+
+
+DBS_API void dbs_epoch_retire(struct dbs_epoch_writer *wr,
+		struct dbs_slab *slab, void *ptr)
+{
+	struct dbs_epoch_limbo *limbo;
+	struct dbs_epoch_item *item;
+	s32 alloc;
+	u64 e;
+
+	/*
+	 * The object has to be unreachable for everyone who sees the epoch
+	 * it is retired in.
+	 */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	e = __atomic_load_n(&wr->ep->epoch, __ATOMIC_SEQ_CST);
+
+	/*
+	 * A list still holding objects of an older epoch, has been passed by
+	 * at least three epochs.
+	 */
+	limbo = &wr->limbo[e % 3];
+	if(limbo->epoch != e) {
+		dbs_epoch_flush(limbo);
+		limbo->epoch = e;
+	}
+
+	if(limbo->num >= limbo->alloc) {
+		alloc = limbo->alloc ? limbo->alloc * 2 : DBS_EPOCH_BATCH;
+		item = srealloc(limbo->item, alloc * sizeof(struct dbs_epoch_item));
+
+		/*
+		 * The writer may be inside a read section itself, so it can't
+		 * wait for the readers. The object stays in the slab until the
+		 * slab is released.
+		 */
+		if(!item) {
+			ALARM(ALARM_ERR, "Failed to retire object");
+			return;
+		}
+
+		limbo->item = item;
+		limbo->alloc = alloc;
+	}
+
+	limbo->item[limbo->num].slab = slab;
+	limbo->item[limbo->num].ptr = ptr;
+	limbo->num++;
+
+	if(limbo->num % DBS_EPOCH_BATCH == 0)
+		dbs_epoch_collect(wr);
+}
@@ -0,0 +1,1347 @@
+#include "frozen.h"
+
+#include "../../alarm/inc/alarm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/*
+ * Get the child of a node with the smallest dif character, which is equal to
+ * or bigger than the given one, and write its dif character back. The
+ * children of a node above the last layer are data pointers, so the one with
+ * the smallest last byte is returned instead.
+ *
+ * Returns: The child or NULL if there are no more children
+ */
+static void *dbs_chrisfile_ceil(struct dbs_christree *tree,
+		struct dbs_christree_node *n, s32 *dif)
+{
+	struct dbs_christree_node *n_ptr;
+
+	if(dbs_christree_has_vals(tree, n) == 1)
+		return dbs_christree_ceil_val(tree, n, dif);
+
+	if((n_ptr = dbs_christree_ceil_v_next(n, *dif)))
+		*dif = n_ptr->dif;
+
+	return n_ptr;
+}
+
+
+DBS_API struct dbs_chrisfrozen *dbs_christree_freeze(struct dbs_christree *tree)
+{
+	struct dbs_christree_frame *lst;
+	struct dbs_christree_frame *tmp;
+	struct dbs_christree_node *n_ptr;
+	struct dbs_christree_node *n;
+	struct dbs_chrisfrozen_node *fn;
+	struct dbs_chrisfrozen *frz;
+	struct dbs_christree *wr;
+	s32 used;
+	s32 dif;
+	s8 vals;
+	u32 node_num = 1;
+	u32 pref_num = 0;
+	u32 data_num = 0;
+	u64 size;
+	u32 i;
+
+	if(!tree) {
+		ALARM(ALARM_WARN, "tree undefined");
+		return NULL;
+	}
+
+	/*
+	 * The nodes of a shared tree may have been taken from the slabs of
+	 * any writer.
+	 */
+	if(tree->main)
+		tree = tree->main;
+
+	used = tree->node_slab.used;
+	for(wr = tree->handle; wr; wr = wr->handle)
+		used += wr->node_slab.used;
+
+	/*
+	 * Collect all nodes in breadth-first order first, to get the exact
+	 * sizes of the arrays. The keys reaching the last layer have no nodes
+	 * there, so they are kept as the node above and the dif character,
+	 * and turned into frozen nodes of their own.
+	 */
+	used++;
+	if(!(lst = smalloc(used * sizeof(struct dbs_christree_frame))))
+		goto err_return;
+
+	lst[0].node = tree->root;
+	lst[0].next = -1;
+	for(i = 0; i < node_num; i++) {
+		if(lst[i].next >= 0) {
+			data_num++;
+			continue;
+		}
+
+		n = lst[i].node;
+		vals = dbs_christree_has_vals(tree, n) == 1;
+
+		dif = 0;
+		while((n_ptr = dbs_chrisfile_ceil(tree, n, &dif))) {
+			if(node_num >= (u32)used) {
+				used *= 2;
+				if(!(tmp = srealloc(lst, used *
+							sizeof(struct dbs_christree_frame))))
+					goto err_free_lst;
+
+				lst = tmp;
+			}
+
+			lst[node_num].node = vals ? n : n_ptr;
+			lst[node_num].next = vals ? dif : -1;
+			node_num++;
+			dif++;
+		}
+
+		pref_num += n->pref_len;
+		if(n->data)
+			data_num++;
+	}
+
+	/*
+	 * Allocate the frozen tree together with all arrays. The data pointers
+	 * come right after the nodes to keep them aligned.
+	 */
+	size = sizeof(struct dbs_chrisfrozen) +
+		node_num * sizeof(struct dbs_chrisfrozen_node) +
+		data_num * sizeof(void *) + node_num + pref_num;
+	if(!(frz = smalloc(size)))
+		goto err_free_lst;
+
+	frz->layer_num = tree->layer_num;
+	frz->size = size;
+	frz->map = NULL;
+
+	frz->node = (struct dbs_chrisfrozen_node *)(frz + 1);
+	frz->node_num = node_num;
+
+	frz->data = (void **)(frz->node + node_num);
+	frz->data_num = 0;
+	frz->val = NULL;
+	frz->val_size = 0;
+
+	frz->key = (u8 *)(frz->data + data_num);
+
+	frz->pref = frz->key + node_num;
+	frz->pref_num = 0;
+
+	/*
+	 * The children of every node follow each other in the list, and the
+	 * first child of a node comes right after the children of all nodes
+	 * before it.
+	 */
+	node_num = 1;
+	for(i = 0; i < frz->node_num; i++) {
+		n = lst[i].node;
+		fn = &frz->node[i];
+
+		if(lst[i].next >= 0) {
+			frz->key[i] = lst[i].next;
+
+			fn->child = node_num;
+			fn->child_num = 0;
+			fn->pref = frz->pref_num;
+			fn->pref_len = 0;
+
+			frz->data[frz->data_num++] = dbs_christree_get_val(tree, n,
+					lst[i].next);
+			fn->data = frz->data_num;
+			continue;
+		}
+
+		frz->key[i] = n->dif;
+
+		fn->child = node_num;
+		fn->child_num = n->v_next_used;
+		node_num += n->v_next_used;
+
+		fn->pref = frz->pref_num;
+		fn->pref_len = n->pref_len;
+		memcpy(frz->pref + frz->pref_num, n->pref, n->pref_len);
+		frz->pref_num += n->pref_len;
+
+		fn->data = 0;
+		if(n->data) {
+			frz->data[frz->data_num++] = n->data;
+			fn->data = frz->data_num;
+		}
+	}
+
+	sfree(lst);
+	return frz;
+
+err_free_lst:
+	sfree(lst);
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to freeze tree");
+	return NULL;
+}
+
+
+DBS_API void dbs_chrisfrozen_close(struct dbs_chrisfrozen *frz)
+{
+	if(!frz) {
+		ALARM(ALARM_WARN, "frz undefined");
+		return;
+	}
+
+	if(frz->map)
+		munmap(frz->map, frz->size);
+
+	sfree(frz);
+}
+
+
+/*
+ * Get the data pointer with the given index plus one. For a mapped file,
+ * this is a pointer to the value in the mapping.
+ */
+static void *dbs_chrisfrozen_data(struct dbs_chrisfrozen *frz, u32 data)
+{
+	if(frz->val)
+		return frz->val + (u64)(data - 1) * frz->val_size;
+
+	return frz->data[data - 1];
+}
+
+
+/*
+ * Get the position of the first child of a node, with a dif character equal
+ * to or bigger than the given one.
+ *
+ * Returns: The position or the number of children if there is no such child
+ */
+static s32 dbs_chrisfrozen_ceil(struct dbs_chrisfrozen *frz,
+		struct dbs_chrisfrozen_node *n, s32 dif)
+{
+	u8 *key = frz->key + n->child;
+	s32 l = 0;
+	s32 r = n->child_num;
+	s32 m;
+
+	/*
+	 * If all characters are there, the position is the character itself.
+	 */
+	if(n->child_num == 256)
+		return dif;
+
+	if(r <= 8) {
+		while(l < r && key[l] < dif)
+			l++;
+
+		return l;
+	}
+
+	while(l < r) {
+		m = (l + r) / 2;
+
+		if(key[m] < dif)
+			l = m + 1;
+		else
+			r = m;
+	}
+
+	return l;
+}
+
+
+DBS_API void *dbs_chrisfrozen_get(struct dbs_chrisfrozen *frz, u8 *str)
+{
+	if(!frz) {
+		ALARM(ALARM_WARN, "frz undefined");
+		return NULL;
+	}
+
+	return dbs_chrisfrozen_get_n(frz, str, frz->layer_num);
+}
+
+
+DBS_API void *dbs_chrisfrozen_get_n(struct dbs_chrisfrozen *frz, u8 *str,
+		s32 len)
+{
+	struct dbs_chrisfrozen_node *n;
+	s32 i = 0;
+	s32 p;
+	u32 idx;
+
+	if(!frz || !str) {
+		ALARM(ALARM_WARN, "frz or str undefined");
+		return NULL;
+	}
+
+	if(len < 1 || len > frz->layer_num) {
+		ALARM(ALARM_WARN, "len invalid");
+		return NULL;
+	}
+
+	n = &frz->node[0];
+	while(i < len) {
+		p = dbs_chrisfrozen_ceil(frz, n, str[i]);
+		if(p >= n->child_num || frz->key[n->child + p] != str[i])
+			return NULL;
+
+		idx = n->child + p;
+		n = &frz->node[idx];
+
+		if(n->pref_len) {
+			if(i + 1 + n->pref_len > len)
+				return NULL;
+
+			if(memcmp(frz->pref + n->pref, str + i + 1, n->pref_len))
+				return NULL;
+		}
+
+		i += 1 + n->pref_len;
+	}
+
+	if(!n->data)
+		return NULL;
+
+	return dbs_chrisfrozen_data(frz, n->data);
+}
+
+
+DBS_API s8 dbs_chrisfrozen_contains(struct dbs_chrisfrozen *frz, u8 *str)
+{
+	if(!frz || !str) {
+		ALARM(ALARM_WARN, "frz or str undefined");
+		return -1;
+	}
+
+	return dbs_chrisfrozen_get(frz, str) != NULL;
+}
+
+
+DBS_API s8 dbs_chrisfrozen_contains_n(struct dbs_chrisfrozen *frz, u8 *str,
+		s32 len)
+{
+	if(!frz || !str || len < 1 || len > frz->layer_num) {
+		ALARM(ALARM_WARN, "frz or str undefined or len invalid");
+		return -1;
+	}
+
+	return dbs_chrisfrozen_get_n(frz, str, len) != NULL;
+}
+
+
+/*
+ * Check if a byte matches a condition.
+ */
+static s8 dbs_chrisfrozen_byte(struct dbs_chrisbyte *b, s32 c)
+{
+	return c >= b->lo && c <= b->hi && (c & b->msk) == b->val;
+}
+
+
+/*
+ * Check the prefix bytes of a node against the filter, if the dif character
+ * of the node lies on the given layer.
+ *
+ * Returns: 1 if all bytes match and 0 if not
+ */
+static s8 dbs_chrisfrozen_match(struct dbs_chrisfrozen *frz,
+		struct dbs_chrisfilter *flt, u32 idx, s32 layer)
+{
+	struct dbs_chrisfrozen_node *n = &frz->node[idx];
+	u8 *pref = frz->pref + n->pref;
+	s32 i;
+
+	for(i = 0; i < n->pref_len && layer + 1 + i < flt->len; i++) {
+		if(!dbs_chrisfrozen_byte(&flt->byte[layer + 1 + i], pref[i]))
+			return 0;
+	}
+
+	return 1;
+}
+
+
+/*
+ * Get the next child of the node of a stack entry, which matches the filter.
+ * Only the children with a dif character in the range of the condition for
+ * their layer are looked at.
+ *
+ * Returns: 1 if a child has been found, 0 if not
+ */
+static s8 dbs_chrisfrozen_child(struct dbs_chrisfrozen *frz,
+		struct dbs_chrisfilter *flt, struct dbs_chrisfrozen_frame *frm,
+		u32 *idx)
+{
+	struct dbs_chrisfrozen_node *n = &frz->node[frm->node];
+	struct dbs_chrisbyte *b;
+	u8 k;
+
+	/*
+	 * Below the filter, all children match.
+	 */
+	if(frm->depth >= flt->len) {
+		if(frm->next >= n->child_num)
+			return 0;
+
+		*idx = n->child + frm->next++;
+		return 1;
+	}
+
+	/*
+	 * Skip all children outside of the range.
+	 */
+	b = &flt->byte[frm->depth];
+	if(frm->next == 0 && b->lo > 0)
+		frm->next = dbs_chrisfrozen_ceil(frz, n, b->lo);
+
+	while(frm->next < n->child_num) {
+		*idx = n->child + frm->next++;
+
+		if((k = frz->key[*idx]) > b->hi)
+			break;
+
+		if((k & b->msk) == b->val &&
+				dbs_chrisfrozen_match(frz, flt, *idx, frm->depth))
+			return 1;
+	}
+
+	frm->next = n->child_num;
+	return 0;
+}
+
+
+/*
+ * Walk through a frozen tree and collect the data pointers of all branches
+ * matching the filter, until the limit is reached.
+ *
+ * Returns: The number of data pointers written to the array
+ */
+static s32 dbs_chrisfrozen_walk(struct dbs_chrisfrozen *frz,
+		struct dbs_chrisfilter *flt, struct dbs_chrisfrozen_frame *stk,
+		void **data, s32 lim)
+{
+	struct dbs_chrisfrozen_frame *frm;
+	struct dbs_chrisfrozen_node *n;
+	s32 stk_num = 1;
+	s32 c = 0;
+	u32 idx;
+
+	stk[0].node = 0;
+	stk[0].depth = 0;
+	stk[0].next = -1;
+
+	while(stk_num > 0 && c < lim) {
+		frm = &stk[stk_num - 1];
+
+		/*
+		 * Collect the data pointer of the node itself first, if its
+		 * string covers the whole filter.
+		 */
+		if(frm->next < 0) {
+			frm->next = 0;
+
+			n = &frz->node[frm->node];
+			if(n->data && frm->depth >= flt->len)
+				data[c++] = dbs_chrisfrozen_data(frz, n->data);
+
+			continue;
+		}
+
+		/*
+		 * Then go through the matching children in ascending order.
+		 */
+		if(dbs_chrisfrozen_child(frz, flt, frm, &idx)) {
+			frm++;
+			frm->node = idx;
+			frm->depth = frm[-1].depth + 1 + frz->node[idx].pref_len;
+			frm->next = -1;
+			stk_num++;
+		}
+		else {
+			stk_num--;
+		}
+	}
+
+	return c;
+}
+
+
+/*
+ * Run a selection over a frozen tree. The stack is kept on the call stack,
+ * if the tree isn't too deep.
+ *
+ * Returns: The number of selected pointers or -1 if an error occurred
+ */
+static s32 dbs_chrisfrozen_sel_flt(struct dbs_chrisfrozen *frz,
+		struct dbs_chrisfilter *flt, void **data, s32 lim)
+{
+	struct dbs_chrisfrozen_frame stk_buf[DBS_CHRISTREE_STK_LEN];
+	struct dbs_chrisfrozen_frame *stk = stk_buf;
+	s32 tmp;
+	s32 c;
+
+	/*
+	 * A branch can't have more nodes than there are layers.
+	 */
+	if(frz->layer_num + 1 > DBS_CHRISTREE_STK_LEN) {
+		tmp = (frz->layer_num + 1) * sizeof(struct dbs_chrisfrozen_frame);
+		if(!(stk = smalloc(tmp)))
+			return -1;
+	}
+
+	c = dbs_chrisfrozen_walk(frz, flt, stk, data, lim);
+
+	if(stk != stk_buf)
+		sfree(stk);
+
+	return c;
+}
+
+
+DBS_API s32 dbs_chrisfrozen_sel(struct dbs_chrisfrozen *frz,
+		struct dbs_chrismask *mask, void **data, s32 lim)
+{
+	struct dbs_chrisbyte byte_buf[DBS_CHRISTREE_STK_LEN];
+	struct dbs_chrisfilter flt;
+	s32 tmp;
+	s32 c;
+	s32 i;
+
+	if(!frz || !mask || !mask->data || !data || lim < 1) {
+		ALARM(ALARM_WARN, "frz or mask or data undefined or lim invalid");
+		return -1;
+	}
+
+	if(mask->off < 0 || mask->len < 1 ||
+			mask->off + mask->len > frz->layer_num) {
+		ALARM(ALARM_WARN, "mask invalid");
+		return -1;
+	}
+
+	/*
+	 * Convert the mask to a filter, which will only be allocated for
+	 * really deep trees.
+	 */
+	flt.len = mask->off + mask->len;
+	flt.byte = byte_buf;
+	if(flt.len > DBS_CHRISTREE_STK_LEN) {
+		tmp = flt.len * sizeof(struct dbs_chrisbyte);
+		if(!(flt.byte = smalloc(tmp)))
+			goto err_return;
+	}
+
+	for(i = 0; i < mask->off; i++)
+		dbs_chrisfilter_set_any(&flt, i);
+
+	dbs_chrisfilter_set_exact(&flt, mask->off, mask->data, mask->len);
+
+	c = dbs_chrisfrozen_sel_flt(frz, &flt, data, lim);
+
+	if(flt.byte != byte_buf)
+		sfree(flt.byte);
+
+	if(c < 0)
+		goto err_return;
+
+	return c;
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to select data pointers");
+	return -1;
+}
+
+
+DBS_API s32 dbs_chrisfrozen_filter(struct dbs_chrisfrozen *frz,
+		struct dbs_chrisfilter *flt, void **data, s32 lim)
+{
+	s32 c;
+
+	if(!frz || !flt || !data || lim < 1) {
+		ALARM(ALARM_WARN, "frz or flt or data undefined or lim invalid");
+		return -1;
+	}
+
+	if(flt->len < 0 || flt->len > frz->layer_num) {
+		ALARM(ALARM_WARN, "filter invalid");
+		return -1;
+	}
+
+	if((c = dbs_chrisfrozen_sel_flt(frz, flt, data, lim)) < 0)
+		goto err_return;
+
+	return c;
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to select data pointers");
+	return -1;
+}
+
+
+/*
+ * Push a node onto the stack of a scan and write its bytes into the key. If
+ * the key of the node is not below the upper bound of the scan, neither the
+ * node nor any node after it is in the range.
+ *
+ * Returns: 0 on success or -1 if the end of the range has been reached
+ */
+static s8 dbs_chrisfrozen_scan_push(struct dbs_chrisfrozen_scan *scan,
+		u32 idx, s32 layer)
+{
+	struct dbs_chrisfrozen *frz = scan->frz;
+	struct dbs_chrisfrozen_frame *frm;
+	struct dbs_chrisfrozen_node *n = &frz->node[idx];
+	s32 depth = layer + 1 + n->pref_len;
+	s32 i;
+
+	scan->key[layer] = frz->key[idx];
+	memcpy(scan->key + layer + 1, frz->pref + n->pref, n->pref_len);
+
+	/*
+	 * The bytes only have to be compared with the upper bound, as long as
+	 * the path above is equal to it.
+	 */
+	if(scan->hi && scan->hi_eq >= layer) {
+		for(i = layer; i < depth; i++) {
+			if(scan->key[i] != scan->hi[i])
+				break;
+		}
+
+		if(i < depth && scan->key[i] > scan->hi[i])
+			return -1;
+
+		if(i >= frz->layer_num)
+			return -1;
+
+		scan->hi_eq = i;
+	}
+
+	frm = &scan->stk[scan->stk_num++];
+	frm->node = idx;
+	frm->depth = depth;
+	frm->next = -1;
+	return 0;
+}
+
+
+/*
+ * Prepare a scan and walk down to the first key, which is equal to or bigger
+ * than the lower bound. Every branch on the way, which lies completely below
+ * the bound, is skipped.
+ */
+static void dbs_chrisfrozen_scan_init(struct dbs_chrisfrozen_scan *scan,
+		struct dbs_chrisfrozen *frz, u8 *lo, u8 *hi,
+		struct dbs_chrisfrozen_frame *stk, u8 *key)
+{
+	struct dbs_chrisfrozen_frame *frm;
+	struct dbs_chrisfrozen_node *n;
+	u32 idx;
+	s32 r;
+
+	scan->frz = frz;
+	scan->hi = hi;
+	scan->hi_eq = 0;
+	scan->key = key;
+	scan->stk = stk;
+	scan->stk_num = 1;
+
+	stk[0].node = 0;
+	stk[0].depth = 0;
+	stk[0].next = -1;
+	if(!lo)
+		return;
+
+	while(1) {
+		frm = &scan->stk[scan->stk_num - 1];
+		n = &frz->node[frm->node];
+
+		/*
+		 * The path is equal to the lower bound.
+		 */
+		if(frm->depth >= frz->layer_num)
+			return;
+
+		/*
+		 * Otherwise the node itself is below the bound, so continue with
+		 * the first child not below the bound.
+		 */
+		frm->next = dbs_chrisfrozen_ceil(frz, n, lo[frm->depth]);
+		if(frm->next >= n->child_num)
+			return;
+
+		idx = n->child + frm->next++;
+
+		if(frz->key[idx] == lo[frm->depth]) {
+			r = memcmp(frz->pref + frz->node[idx].pref,
+					lo + frm->depth + 1, frz->node[idx].pref_len);
+			if(r < 0)
+				return;
+
+			if(r == 0) {
+				if(dbs_chrisfrozen_scan_push(scan, idx, frm->depth) < 0)
+					break;
+
+				continue;
+			}
+		}
+
+		/*
+		 * The whole branch is above the bound.
+		 */
+		if(dbs_chrisfrozen_scan_push(scan, idx, frm->depth) < 0)
+			break;
+
+		return;
+	}
+
+	scan->stk_num = 0;
+}
+
+
+/*
+ * Collect keys and data pointers with a scan until either the limit or the
+ * end of the range is reached.
+ *
+ * Returns: The number of data pointers written to the array
+ */
+static s32 dbs_chrisfrozen_scan_run(struct dbs_chrisfrozen_scan *scan,
+		u8 *keys, void **data, s32 lim)
+{
+	struct dbs_chrisfrozen *frz = scan->frz;
+	struct dbs_chrisfrozen_frame *frm;
+	struct dbs_chrisfrozen_node *n;
+	s32 c = 0;
+
+	while(c < lim && scan->stk_num > 0) {
+		frm = &scan->stk[scan->stk_num - 1];
+		n = &frz->node[frm->node];
+
+		/*
+		 * Collect the data pointer of the node itself first.
+		 */
+		if(frm->next < 0) {
+			frm->next = 0;
+
+			if(n->data) {
+				if(keys) {
+					memcpy(keys + c * frz->layer_num, scan->key,
+							frm->depth);
+					memset(keys + c * frz->layer_num + frm->depth, 0,
+							frz->layer_num - frm->depth);
+				}
+
+				data[c++] = dbs_chrisfrozen_data(frz, n->data);
+			}
+
+			continue;
+		}
+
+		/*
+		 * Then go through the children in ascending order, until the
+		 * upper bound is reached.
+		 */
+		if(frm->next < n->child_num) {
+			if(dbs_chrisfrozen_scan_push(scan, n->child + frm->next++,
+						frm->depth) < 0)
+				scan->stk_num = 0;
+		}
+		else if(--scan->stk_num > 0) {
+			frm--;
+			if(scan->hi_eq > frm->depth)
+				scan->hi_eq = frm->depth;
+		}
+	}
+
+	return c;
+}
+
+
+DBS_API s32 dbs_chrisfrozen_range(struct dbs_chrisfrozen *frz, u8 *lo, u8 *hi,
+		u8 *keys, void **data, s32 lim)
+{
+	struct dbs_chrisfrozen_frame stk_buf[DBS_CHRISTREE_STK_LEN];
+	struct dbs_chrisfrozen_frame *stk = stk_buf;
+	struct dbs_chrisfrozen_scan scan;
+	u8 key_buf[DBS_CHRISTREE_STK_LEN];
+	u8 *key = key_buf;
+	s32 tmp;
+	s32 c;
+
+	if(!frz || !data || lim < 1) {
+		ALARM(ALARM_WARN, "frz or data undefined or lim invalid");
+		return -1;
+	}
+
+	/*
+	 * A branch can't have more nodes than there are layers. Only really
+	 * deep trees need a stack bigger than the one on the call stack.
+	 */
+	if(frz->layer_num + 1 > DBS_CHRISTREE_STK_LEN) {
+		tmp = (frz->layer_num + 1) * sizeof(struct dbs_chrisfrozen_frame) +
+			frz->layer_num;
+		if(!(stk = smalloc(tmp)))
+			goto err_return;
+
+		key = (u8 *)(stk + frz->layer_num + 1);
+	}
+
+	dbs_chrisfrozen_scan_init(&scan, frz, lo, hi, stk, key);
+	c = dbs_chrisfrozen_scan_run(&scan, keys, data, lim);
+
+	if(stk != stk_buf)
+		sfree(stk);
+
+	return c;
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to scan range");
+	return -1;
+}
+
+
+/*
+ * Get the next node of a tree in depth-first order, with the children of
+ * every node in ascending order. The stack has to start with the root. A key
+ * reaching the last layer has no node there, so it is written to the given
+ * node instead, which is returned as a leaf.
+ *
+ * Returns: The next node or NULL if all nodes have been visited
+ */
+static struct dbs_christree_node *dbs_chrisfile_walk(struct dbs_christree *tree,
+		struct dbs_christree_frame *stk, s32 *stk_num,
+		struct dbs_christree_node *val)
+{
+	struct dbs_christree_frame *frm;
+	struct dbs_christree_node *n_ptr;
+
+	while(*stk_num > 0) {
+		frm = &stk[*stk_num - 1];
+
+		if(frm->next < 0) {
+			frm->next = 0;
+			return frm->node;
+		}
+
+		if((n_ptr = dbs_chrisfile_ceil(tree, frm->node, &frm->next))) {
+			frm->next++;
+
+			if(dbs_christree_has_vals(tree, frm->node) == 1) {
+				val->layer = tree->layer_num - 1;
+				val->dif = frm->next - 1;
+				val->data = n_ptr;
+				return val;
+			}
+
+			frm++;
+			frm->node = n_ptr;
+			frm->next = -1;
+			(*stk_num)++;
+		}
+		else {
+			(*stk_num)--;
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+ * Write the buffered bytes of a region to the file.
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+static s8 dbs_chrisfile_flush(s32 fd, struct dbs_chrisfile_buf *buf)
+{
+	ssize_t r;
+	s32 done = 0;
+
+	while(done < buf->len) {
+		if((r = pwrite(fd, buf->data + done, buf->len - done,
+						buf->off + done)) < 0)
+			return -1;
+
+		done += r;
+	}
+
+	buf->off += buf->len;
+	buf->len = 0;
+	return 0;
+}
+
+
+/*
+ * Append bytes to a region of the file.
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+static s8 dbs_chrisfile_put(s32 fd, struct dbs_chrisfile_buf *buf,
+		void *ptr, u32 len)
+{
+	u8 *p = ptr;
+	u32 tmp;
+
+	while(len > 0) {
+		if(buf->len >= DBS_CHRISFILE_BUF_LEN &&
+				dbs_chrisfile_flush(fd, buf) < 0)
+			return -1;
+
+		tmp = DBS_CHRISFILE_BUF_LEN - buf->len;
+		if(tmp > len)
+			tmp = len;
+
+		memcpy(buf->data + buf->len, p, tmp);
+		buf->len += tmp;
+		p += tmp;
+		len -= tmp;
+	}
+
+	return 0;
+}
+
+
+/*
+ * Round a file offset up to the next multiple of eight.
+ */
+static u64 dbs_chrisfile_align(u64 off)
+{
+	return (off + 7) & ~(u64)7;
+}
+
+
+/*
+ * Flush the directory containing a file to disk, so a file renamed into it
+ * stays there after a crash.
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+static s8 dbs_chrisfile_sync_dir(char *pth)
+{
+	char *dir;
+	char *sep;
+	s32 fd;
+	s8 ret = 0;
+
+	if(!(dir = smalloc(strlen(pth) + 2)))
+		return -1;
+
+	strcpy(dir, pth);
+	if(!(sep = strrchr(dir, '/')))
+		strcpy(dir, ".");
+	else if(sep == dir)
+		dir[1] = 0;
+	else
+		*sep = 0;
+
+	if((fd = open(dir, O_RDONLY)) < 0) {
+		sfree(dir);
+		return -1;
+	}
+
+	if(fsync(fd) < 0)
+		ret = -1;
+
+	close(fd);
+	sfree(dir);
+	return ret;
+}
+
+
+DBS_API s8 dbs_christree_save(struct dbs_christree *tree, char *pth,
+		u32 val_size)
+{
+	struct dbs_christree_frame *stk;
+	struct dbs_christree_node *n;
+	struct dbs_christree_node val;
+	struct dbs_chrisfile_buf *buf;
+	struct dbs_chrisfile_hdr hdr;
+	struct dbs_chrisfrozen_node fn;
+	char *tmp_pth;
+	s32 layer_num;
+	s32 stk_num;
+	u32 *cnt;
+	u32 *base;
+	u32 i;
+	s32 d;
+	s32 fd;
+	s32 tmp;
+
+	if(!tree || !pth || val_size < 1) {
+		ALARM(ALARM_WARN, "tree or pth undefined or val_size invalid");
+		return -1;
+	}
+
+	/*
+	 * Allocate the stack together with the node counters. The counters
+	 * are indexed with the layer plus one, so the root comes first.
+	 */
+	layer_num = tree->layer_num;
+	tmp = (layer_num + 1) * sizeof(struct dbs_christree_frame) +
+		2 * (layer_num + 1) * sizeof(u32);
+	if(!(stk = smalloc(tmp)))
+		goto err_return;
+
+	cnt = (u32 *)(stk + layer_num + 1);
+	base = cnt + layer_num + 1;
+
+	/*
+	 * Count the nodes of every layer, the prefix bytes and the values
+	 * first, to know where every region of the file starts.
+	 */
+	memset(&hdr, 0, sizeof(struct dbs_chrisfile_hdr));
+	memset(&val, 0, sizeof(struct dbs_christree_node));
+	memset(cnt, 0, (layer_num + 1) * sizeof(u32));
+
+	stk[0].node = tree->root;
+	stk[0].next = -1;
+	stk_num = 1;
+	while((n = dbs_chrisfile_walk(tree, stk, &stk_num, &val))) {
+		cnt[n->layer + 1]++;
+		hdr.pref_num += n->pref_len;
+		if(n->data)
+			hdr.data_num++;
+	}
+
+	/*
+	 * The nodes are sorted by their layer. As the nodes of a layer are
+	 * visited in the same order they're written in, the children of a
+	 * node always start at the current position of the next layer.
+	 */
+	for(i = 0; i <= (u32)layer_num; i++) {
+		base[i] = hdr.node_num;
+		hdr.node_num += cnt[i];
+		cnt[i] = 0;
+	}
+
+	memcpy(hdr.magic, DBS_CHRISFILE_MAGIC, 8);
+	hdr.version = DBS_CHRISFILE_VERSION;
+	hdr.order = DBS_CHRISFILE_ORDER;
+	hdr.node_size = sizeof(struct dbs_chrisfrozen_node);
+	hdr.layer_num = layer_num;
+	hdr.val_size = val_size;
+
+	hdr.node_off = dbs_chrisfile_align(sizeof(struct dbs_chrisfile_hdr));
+	hdr.key_off = hdr.node_off + (u64)hdr.node_num * hdr.node_size;
+	hdr.val_off = dbs_chrisfile_align(hdr.key_off + hdr.node_num);
+	hdr.pref_off = hdr.val_off + (u64)hdr.data_num * val_size;
+	hdr.size = hdr.pref_off + hdr.pref_num;
+
+	/*
+	 * Use one buffer for the nodes and one for the dif characters of every
+	 * layer, and one for the values and one for the prefix bytes.
+	 */
+	tmp = (2 * (layer_num + 1) + 2) * sizeof(struct dbs_chrisfile_buf);
+	if(!(buf = smalloc(tmp)))
+		goto err_free_stk;
+
+	for(i = 0; i <= (u32)layer_num; i++) {
+		buf[i].off = hdr.node_off + (u64)base[i] * hdr.node_size;
+		buf[i].len = 0;
+
+		buf[layer_num + 1 + i].off = hdr.key_off + base[i];
+		buf[layer_num + 1 + i].len = 0;
+	}
+
+	buf[2 * layer_num + 2].off = hdr.val_off;
+	buf[2 * layer_num + 2].len = 0;
+	buf[2 * layer_num + 3].off = hdr.pref_off;
+	buf[2 * layer_num + 3].len = 0;
+
+	/*
+	 * The tree is written to a new file next to the old one, which only
+	 * replaces the old file once it is complete.
+	 */
+	if(!(tmp_pth = smalloc(strlen(pth) + 8)))
+		goto err_free_buf;
+
+	strcpy(tmp_pth, pth);
+	strcat(tmp_pth, ".XXXXXX");
+
+	if((fd = mkstemp(tmp_pth)) < 0)
+		goto err_free_pth;
+
+	if(fchmod(fd, 0644) < 0)
+		goto err_close_fd;
+
+	/*
+	 * Write all nodes while walking through the tree again.
+	 */
+	memset(&fn, 0, sizeof(struct dbs_chrisfrozen_node));
+	hdr.pref_num = 0;
+	hdr.data_num = 0;
+
+	stk[0].node = tree->root;
+	stk[0].next = -1;
+	stk_num = 1;
+	while((n = dbs_chrisfile_walk(tree, stk, &stk_num, &val))) {
+		i = n->layer + 1;
+		d = n->layer + 1 + n->pref_len;
+
+		fn.child = d < layer_num ? base[d + 1] + cnt[d + 1] : 0;
+		fn.child_num = n->v_next_used;
+		fn.pref_len = n->pref_len;
+		fn.pref = hdr.pref_num;
+		fn.data = n->data ? hdr.data_num + 1 : 0;
+
+		cnt[i]++;
+
+		if(dbs_chrisfile_put(fd, &buf[i], &fn, sizeof(fn)) < 0)
+			goto err_close_fd;
+
+		if(dbs_chrisfile_put(fd, &buf[layer_num + 1 + i], &n->dif, 1) < 0)
+			goto err_close_fd;
+
+		if(dbs_chrisfile_put(fd, &buf[2 * layer_num + 3], n->pref,
+					n->pref_len) < 0)
+			goto err_close_fd;
+
+		hdr.pref_num += n->pref_len;
+
+		if(n->data) {
+			if(dbs_chrisfile_put(fd, &buf[2 * layer_num + 2], n->data,
+						val_size) < 0)
+				goto err_close_fd;
+
+			hdr.data_num++;
+		}
+	}
+
+	for(i = 0; i < 2 * (u32)layer_num + 4; i++) {
+		if(dbs_chrisfile_flush(fd, &buf[i]) < 0)
+			goto err_close_fd;
+	}
+
+	/*
+	 * Write the header last, so an incomplete file is never valid.
+	 */
+	if(ftruncate(fd, hdr.size) < 0)
+		goto err_close_fd;
+
+	if(pwrite(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+		goto err_close_fd;
+
+	if(fsync(fd) < 0)
+		goto err_close_fd;
+
+	if(close(fd) < 0)
+		goto err_remove_file;
+
+	/*
+	 * Renaming the file keeps the old one alive for everyone who has it
+	 * mapped, and if the save fails before, the old file is left as it
+	 * was.
+	 */
+	if(rename(tmp_pth, pth) < 0)
+		goto err_remove_file;
+
+	if(dbs_chrisfile_sync_dir(pth) < 0)
+		goto err_free_pth;
+
+	sfree(tmp_pth);
+	sfree(buf);
+	sfree(stk);
+	return 0;
+
+err_close_fd:
+	close(fd);
+
+err_remove_file:
+	unlink(tmp_pth);
+
+err_free_pth:
+	sfree(tmp_pth);
+
+err_free_buf:
+	sfree(buf);
+
+err_free_stk:
+	sfree(stk);
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to save tree");
+	return -1;
+}
+
+
+/*
+ * Check if the header of a file is valid and all regions lie inside of the
+ * file.
+ *
+ * Returns: 1 if the header is valid and 0 if not
+ */
+static s8 dbs_chrisfile_check(struct dbs_chrisfile_hdr *hdr, u64 size)
+{
+	if(memcmp(hdr->magic, DBS_CHRISFILE_MAGIC, 8) ||
+			hdr->version != DBS_CHRISFILE_VERSION ||
+			hdr->order != DBS_CHRISFILE_ORDER ||
+			hdr->node_size != sizeof(struct dbs_chrisfrozen_node))
+		return 0;
+
+	if(hdr->layer_num < 0 || hdr->node_num < 1 || hdr->val_size < 1)
+		return 0;
+
+	if(hdr->node_off < sizeof(struct dbs_chrisfile_hdr) ||
+			hdr->node_off % 8 ||
+			hdr->key_off < hdr->node_off +
+			(u64)hdr->node_num * hdr->node_size ||
+			hdr->val_off < hdr->key_off + hdr->node_num ||
+			hdr->pref_off < hdr->val_off +
+			(u64)hdr->data_num * hdr->val_size ||
+			hdr->size < hdr->pref_off + hdr->pref_num ||
+			hdr->size > size)
+		return 0;
+
+	return 1;
+}
+
+
+/*
+ * Check all nodes of a file in one pass, so a file with a valid header but a
+ * truncated or corrupted body is rejected before any lookup reads through
+ * its nodes. Every node must refer to children, prefix bytes and values
+ * inside of their regions. As the nodes are sorted by their layer, children
+ * always come after their parent, so the depth of every node is known once
+ * it is reached, and no path may go further down than the last layer.
+ *
+ * Returns: 1 if all nodes are valid, 0 if not or -1 if an error occurred
+ */
+static s8 dbs_chrisfile_check_nodes(struct dbs_chrisfile_hdr *hdr, u8 *map)
+{
+	struct dbs_chrisfrozen_node *node;
+	struct dbs_chrisfrozen_node *n;
+	s32 *depth;
+	u32 i;
+	u32 j;
+
+	if(!(depth = smalloc(hdr->node_num * sizeof(s32))))
+		return -1;
+
+	for(i = 0; i < hdr->node_num; i++)
+		depth[i] = -1;
+
+	node = (struct dbs_chrisfrozen_node *)(map + hdr->node_off);
+	depth[0] = 0;
+
+	for(i = 0; i < hdr->node_num; i++) {
+		n = &node[i];
+
+		if((u64)n->pref + n->pref_len > hdr->pref_num ||
+				n->data > hdr->data_num)
+			goto err_free_depth;
+
+		if(n->child_num == 0)
+			continue;
+
+		/*
+		 * Unreached nodes don't have a depth, so they must not have
+		 * any children either.
+		 */
+		if(depth[i] < 0 || n->child <= i ||
+				(u64)n->child + n->child_num > hdr->node_num)
+			goto err_free_depth;
+
+		for(j = n->child; j < n->child + n->child_num; j++) {
+			if(depth[j] >= 0)
+				goto err_free_depth;
+
+			depth[j] = depth[i] + 1 + node[j].pref_len;
+			if(depth[j] > hdr->layer_num)
+				goto err_free_depth;
+		}
+	}
+
+	sfree(depth);
+	return 1;
+
+err_free_depth:
+	sfree(depth);
+	return 0;
+}
+
+
+DBS_API struct dbs_chrisfrozen *dbs_chrisfrozen_map(char *pth)
+{
+	struct dbs_chrisfile_hdr *hdr;
+	struct dbs_chrisfrozen *frz;
+	struct stat st;
+	u8 *map;
+	s32 fd;
+	s8 ret;
+
+	if(!pth) {
+		ALARM(ALARM_WARN, "pth undefined");
+		return NULL;
+	}
+
+	if((fd = open(pth, O_RDONLY)) < 0)
+		goto err_return;
+
+	if(fstat(fd, &st) < 0)
+		goto err_close_fd;
+
+	if((u64)st.st_size < sizeof(struct dbs_chrisfile_hdr)) {
+		ALARM(ALARM_WARN, "file invalid");
+		goto err_close_fd;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if(map == MAP_FAILED)
+		goto err_close_fd;
+
+	hdr = (struct dbs_chrisfile_hdr *)map;
+	if(!dbs_chrisfile_check(hdr, st.st_size)) {
+		ALARM(ALARM_WARN, "file invalid");
+		goto err_unmap;
+	}
+
+	if((ret = dbs_chrisfile_check_nodes(hdr, map)) < 1) {
+		if(ret == 0)
+			ALARM(ALARM_WARN, "file invalid");
+
+		goto err_unmap;
+	}
+
+	if(!(frz = smalloc(sizeof(struct dbs_chrisfrozen))))
+		goto err_unmap;
+
+	frz->layer_num = hdr->layer_num;
+
+	frz->node = (struct dbs_chrisfrozen_node *)(map + hdr->node_off);
+	frz->key = map + hdr->key_off;
+	frz->node_num = hdr->node_num;
+
+	frz->pref = map + hdr->pref_off;
+	frz->pref_num = hdr->pref_num;
+
+	frz->data = NULL;
+	frz->data_num = hdr->data_num;
+
+	frz->val = map + hdr->val_off;
+	frz->val_size = hdr->val_size;
+
+	frz->size = st.st_size;
+	frz->map = map;
+
+	/*
+	 * The mapping stays valid without the file descriptor.
+	 */
+	close(fd);
+	return frz;
+
+err_unmap:
+	munmap(map, st.st_size);
+
+err_close_fd:
+	close(fd);
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to map file");
+	return NULL;
+}
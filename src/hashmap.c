@@ -0,0 +1,266 @@
+#include "hashmap.h"
+#include "utils.h"
+
+#include "../../alarm/inc/alarm.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+DBS_API struct dbs_hashmap *dbs_hashmap_init(void)
+{
+	struct dbs_hashmap *map;
+	s32 tmp;
+	s32 i;
+
+	if(!(map = smalloc(sizeof(struct dbs_hashmap))))
+		goto err_return;
+
+	tmp = DBS_HASHMAP_MIN * sizeof(struct dbs_hashmap_entry);
+	if(!(map->entry = smalloc(tmp)))
+		goto err_free_map;
+
+	for(i = 0; i < DBS_HASHMAP_MIN; i++)
+		map->entry[i].data = NULL;
+
+	map->num = 0;
+	map->alloc = DBS_HASHMAP_MIN;
+	map->seed = dbs_hash_seed();
+	return map;
+
+err_free_map:
+	sfree(map);
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to create hash map");
+	return NULL;
+}
+
+
+DBS_API void dbs_hashmap_close(struct dbs_hashmap *map)
+{
+	if(!map) {
+		ALARM(ALARM_WARN, "map undefined");
+		return;
+	}
+
+	dbs_hashmap_clear(map);
+
+	sfree(map->entry);
+	sfree(map);
+}
+
+
+DBS_API void dbs_hashmap_clear(struct dbs_hashmap *map)
+{
+	s32 i;
+
+	if(!map) {
+		ALARM(ALARM_WARN, "map undefined");
+		return;
+	}
+
+	for(i = 0; i < map->alloc; i++) {
+		if(map->entry[i].data && map->entry[i].len > DBS_HASHMAP_INLINE)
+			sfree(map->entry[i].key.ptr);
+
+		map->entry[i].data = NULL;
+	}
+
+	map->num = 0;
+}
+
+
+/*
+ * Get the bytes of the string of an entry.
+ */
+static u8 *dbs_hashmap_key(struct dbs_hashmap_entry *e)
+{
+	return e->len > DBS_HASHMAP_INLINE ? e->key.ptr : e->key.buf;
+}
+
+
+/*
+ * Hash a string with the seed of the hash map. Strings of the common fixed
+ * lengths take the fast paths.
+ */
+static u64 dbs_hashmap_hash(struct dbs_hashmap *map, u8 *str, s32 len)
+{
+	switch(len) {
+		case 4:
+			return dbs_hash64_4(str, map->seed);
+
+		case 8:
+			return dbs_hash64_8(str, map->seed);
+
+		case 16:
+			return dbs_hash64_16(str, map->seed);
+
+		default:
+			return dbs_hash64(str, len, map->seed);
+	}
+}
+
+
+/*
+ * Search the entry of a string, or the empty entry it would be put into.
+ *
+ * Returns: The index of the entry
+ */
+static s32 dbs_hashmap_find(struct dbs_hashmap *map, u64 hash,
+		u8 *str, s32 len)
+{
+	struct dbs_hashmap_entry *e;
+	s32 mask = map->alloc - 1;
+	s32 i = hash & mask;
+
+	while((e = &map->entry[i])->data) {
+		if(e->hash == hash && e->len == len &&
+				memcmp(dbs_hashmap_key(e), str, len) == 0)
+			break;
+
+		i = (i + 1) & mask;
+	}
+
+	return i;
+}
+
+
+/*
+ * Move all entries into a table twice as big. The copies of the strings are
+ * kept.
+ *
+ * Returns: 0 on success or -1 if an error occurred
+ */
+static s8 dbs_hashmap_grow(struct dbs_hashmap *map)
+{
+	struct dbs_hashmap_entry *entry;
+	s32 alloc = map->alloc * 2;
+	s32 mask = alloc - 1;
+	s32 i;
+	s32 j;
+
+	if(!(entry = smalloc(alloc * sizeof(struct dbs_hashmap_entry))))
+		return -1;
+
+	for(i = 0; i < alloc; i++)
+		entry[i].data = NULL;
+
+	for(i = 0; i < map->alloc; i++) {
+		if(!map->entry[i].data)
+			continue;
+
+		j = map->entry[i].hash & mask;
+		while(entry[j].data)
+			j = (j + 1) & mask;
+
+		entry[j] = map->entry[i];
+	}
+
+	sfree(map->entry);
+	map->entry = entry;
+	map->alloc = alloc;
+	return 0;
+}
+
+
+DBS_API s8 dbs_hashmap_set(struct dbs_hashmap *map, u8 *str, s32 len,
+		void *data)
+{
+	struct dbs_hashmap_entry *e;
+	u64 hash;
+
+	if(!map || !str || !data || len < 0) {
+		ALARM(ALARM_WARN, "map or str or data undefined or len invalid");
+		return -1;
+	}
+
+	/*
+	 * Grow the table first, so a new entry can always be added.
+	 */
+	if((map->num + 1) * 2 > map->alloc && dbs_hashmap_grow(map) < 0)
+		goto err_return;
+
+	hash = dbs_hashmap_hash(map, str, len);
+	e = &map->entry[dbs_hashmap_find(map, hash, str, len)];
+
+	if(!e->data) {
+		if(len > DBS_HASHMAP_INLINE) {
+			if(!(e->key.ptr = smalloc(len)))
+				goto err_return;
+
+			memcpy(e->key.ptr, str, len);
+		}
+		else {
+			memcpy(e->key.buf, str, len);
+		}
+
+		e->hash = hash;
+		e->len = len;
+		map->num++;
+	}
+
+	e->data = data;
+	return 0;
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to set entry");
+	return -1;
+}
+
+
+DBS_API void *dbs_hashmap_get(struct dbs_hashmap *map, u8 *str, s32 len)
+{
+	u64 hash;
+
+	if(!map || !str || len < 0) {
+		ALARM(ALARM_WARN, "map or str undefined or len invalid");
+		return NULL;
+	}
+
+	hash = dbs_hashmap_hash(map, str, len);
+	return map->entry[dbs_hashmap_find(map, hash, str, len)].data;
+}
+
+
+DBS_API void dbs_hashmap_del(struct dbs_hashmap *map, u8 *str, s32 len)
+{
+	struct dbs_hashmap_entry *e;
+	u64 hash;
+	s32 mask;
+	s32 i;
+	s32 j;
+	s32 k;
+
+	if(!map || !str || len < 0) {
+		ALARM(ALARM_WARN, "map or str undefined or len invalid");
+		return;
+	}
+
+	hash = dbs_hashmap_hash(map, str, len);
+	i = dbs_hashmap_find(map, hash, str, len);
+	if(!(e = &map->entry[i])->data)
+		return;
+
+	if(e->len > DBS_HASHMAP_INLINE)
+		sfree(e->key.ptr);
+
+	/*
+	 * Move every later entry of the run back into the gap, unless the
+	 * entry it points to lies between the gap and itself.
+	 */
+	mask = map->alloc - 1;
+	j = i;
+	while(map->entry[j = (j + 1) & mask].data) {
+		k = map->entry[j].hash & mask;
+
+		if(i <= j ? (i < k && k <= j) : (i < k || k <= j))
+			continue;
+
+		map->entry[i] = map->entry[j];
+		i = j;
+	}
+
+	map->entry[i].data = NULL;
+	map->num--;
+}
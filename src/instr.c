@@ -0,0 +1,243 @@
+#include "instr.h"
+
+#include "../../alarm/inc/alarm.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/*
+ * A counter is only changed by its own thread, so adding to it doesn't need
+ * an atomic read-modify-write. The store is atomic, so a snapshot never reads
+ * half of it.
+ */
+#define DBS_INSTR_ADD(p, n)     __atomic_store_n(&(p), (p) + (n), \
+		__ATOMIC_RELAXED)
+#define DBS_INSTR_GET(p)        __atomic_load_n(&(p), __ATOMIC_RELAXED)
+
+
+/*
+ * The blocks of all threads, the block of the calling thread and the sums at
+ * the last reset, which are guarded by the lock.
+ */
+static struct dbs_instr_thread *dbs_instr_list = NULL;
+static __thread struct dbs_instr_thread *dbs_instr_self = NULL;
+static struct dbs_instr dbs_instr_base;
+static pthread_mutex_t dbs_instr_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*
+ * Get the block of the calling thread, which is created with the first call
+ * on the thread.
+ *
+ * Returns: Either a pointer to the block or NULL if an error occurred
+ */
+static struct dbs_instr_thread *dbs_instr_get_thread(void)
+{
+	struct dbs_instr_thread *th;
+
+	if((th = dbs_instr_self))
+		return th;
+
+	if(!(th = smalloc(sizeof(struct dbs_instr_thread)))) {
+		ALARM(ALARM_ERR, "Failed to create instrumentation block");
+		return NULL;
+	}
+
+	memset(th, 0, sizeof(struct dbs_instr_thread));
+
+	th->next = DBS_LOAD(dbs_instr_list);
+	while(!__atomic_compare_exchange_n(&dbs_instr_list, &th->next, th, 0,
+				__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+	dbs_instr_self = th;
+	return th;
+}
+
+
+static u64 dbs_instr_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+/*
+ * Get the bucket of the histogram for a latency.
+ */
+static s32 dbs_instr_bucket(u64 ns)
+{
+	s32 msb;
+
+	if(ns < 16)
+		return ns;
+
+	msb = 63 - __builtin_clzl(ns);
+	return 16 + (msb - 4) * DBS_INSTR_SUB + ((ns >> (msb - 3)) & 7);
+}
+
+
+/*
+ * Get the biggest latency falling into a bucket of the histogram.
+ */
+static u64 dbs_instr_upper(s32 i)
+{
+	s32 msb;
+
+	if(i < 16)
+		return i;
+
+	msb = (i - 16) / DBS_INSTR_SUB + 4;
+	return ((u64)(DBS_INSTR_SUB + (i - 16) % DBS_INSTR_SUB + 1) <<
+			(msb - 3)) - 1;
+}
+
+
+/*
+ * Sum up the counters of all threads.
+ */
+static void dbs_instr_sum(struct dbs_instr *sum)
+{
+	struct dbs_instr_thread *th;
+	struct dbs_instr_op *src;
+	struct dbs_instr_op *dst;
+	s32 i;
+	s32 j;
+
+	memset(sum, 0, sizeof(struct dbs_instr));
+
+	for(th = DBS_LOAD(dbs_instr_list); th; th = th->next) {
+		for(i = 0; i < DBS_INSTR_OPS; i++) {
+			src = &th->cnt.op[i];
+			dst = &sum->op[i];
+
+			dst->num += DBS_INSTR_GET(src->num);
+			dst->ns += DBS_INSTR_GET(src->ns);
+			dst->visit += DBS_INSTR_GET(src->visit);
+
+			for(j = 0; j < DBS_INSTR_BUCKETS; j++)
+				dst->hist[j] += DBS_INSTR_GET(src->hist[j]);
+		}
+
+		for(i = 0; i < DBS_INSTR_CNTS; i++)
+			sum->cnt[i] += DBS_INSTR_GET(th->cnt.cnt[i]);
+	}
+}
+
+
+DBS_API u64 dbs_instr_begin(void)
+{
+	struct dbs_instr_thread *th;
+
+	if((th = dbs_instr_get_thread()))
+		th->mark = th->cnt.cnt[DBS_INSTR_VISIT];
+
+	return dbs_instr_now();
+}
+
+
+DBS_API void dbs_instr_end(s32 op, u64 start)
+{
+	struct dbs_instr_thread *th;
+	struct dbs_instr_op *o;
+	u64 ns = dbs_instr_now() - start;
+
+	if(op < 0 || op >= DBS_INSTR_OPS || !(th = dbs_instr_get_thread()))
+		return;
+
+	o = &th->cnt.op[op];
+	DBS_INSTR_ADD(o->num, 1);
+	DBS_INSTR_ADD(o->ns, ns);
+	DBS_INSTR_ADD(o->visit, th->cnt.cnt[DBS_INSTR_VISIT] - th->mark);
+	DBS_INSTR_ADD(o->hist[dbs_instr_bucket(ns)], 1);
+}
+
+
+DBS_API void dbs_instr_count(s32 c, u64 n)
+{
+	struct dbs_instr_thread *th;
+
+	if(c < 0 || c >= DBS_INSTR_CNTS || !(th = dbs_instr_get_thread()))
+		return;
+
+	DBS_INSTR_ADD(th->cnt.cnt[c], n);
+}
+
+
+DBS_API void dbs_instr_snapshot(struct dbs_instr *snap)
+{
+	s32 i;
+	s32 j;
+
+	if(!snap) {
+		ALARM(ALARM_WARN, "snap undefined");
+		return;
+	}
+
+	dbs_instr_sum(snap);
+
+	pthread_mutex_lock(&dbs_instr_lock);
+
+	for(i = 0; i < DBS_INSTR_OPS; i++) {
+		snap->op[i].num -= dbs_instr_base.op[i].num;
+		snap->op[i].ns -= dbs_instr_base.op[i].ns;
+		snap->op[i].visit -= dbs_instr_base.op[i].visit;
+
+		for(j = 0; j < DBS_INSTR_BUCKETS; j++) {
+			snap->op[i].hist[j] -= dbs_instr_base.op[i].hist[j];
+
+			if(snap->op[i].hist[j])
+				snap->op[i].max = dbs_instr_upper(j);
+		}
+	}
+
+	for(i = 0; i < DBS_INSTR_CNTS; i++)
+		snap->cnt[i] -= dbs_instr_base.cnt[i];
+
+	pthread_mutex_unlock(&dbs_instr_lock);
+}
+
+
+DBS_API void dbs_instr_reset(void)
+{
+	struct dbs_instr sum;
+
+	dbs_instr_sum(&sum);
+
+	pthread_mutex_lock(&dbs_instr_lock);
+	dbs_instr_base = sum;
+	pthread_mutex_unlock(&dbs_instr_lock);
+}
+
+
+DBS_API u64 dbs_instr_percentile(struct dbs_instr *snap, s32 op, double p)
+{
+	struct dbs_instr_op *o;
+	u64 lim;
+	u64 c = 0;
+	s32 i;
+
+	if(!snap || op < 0 || op >= DBS_INSTR_OPS) {
+		ALARM(ALARM_WARN, "snap undefined or op invalid");
+		return 0;
+	}
+
+	o = &snap->op[op];
+	if(o->num == 0)
+		return 0;
+
+	lim = (u64)(p / 100.0 * o->num);
+	if(lim < 1)
+		lim = 1;
+
+	for(i = 0; i < DBS_INSTR_BUCKETS - 1; i++) {
+		if((c += o->hist[i]) >= lim)
+			break;
+	}
+
+	return dbs_instr_upper(i);
+}
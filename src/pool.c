@@ -0,0 +1,333 @@
+#include "pool.h"
+
+#include "../../alarm/inc/alarm.h"
+
+#include <sched.h>
+#include <stdlib.h>
+
+
+/*
+ * The number of tasks a deque can hold, before it is grown.
+ */
+#define DBS_POOL_TASKS          64
+
+
+static void *dbs_pool_main(void *arg);
+
+
+DBS_API struct dbs_pool *dbs_pool_init(s32 wrk_num)
+{
+	struct dbs_pool *pool;
+	struct dbs_pool_worker *wrk;
+	s32 i;
+
+	if(wrk_num < 1) {
+		ALARM(ALARM_WARN, "wrk_num invalid");
+		return NULL;
+	}
+
+	if(!(pool = smalloc(sizeof(struct dbs_pool))))
+		goto err_return;
+
+	if(!(pool->wrk = smalloc(wrk_num * sizeof(struct dbs_pool_worker))))
+		goto err_free_pool;
+
+	pool->wrk_num = 0;
+	pool->gen = 0;
+	pool->stop = 0;
+	pool->fn = NULL;
+	pool->ctx = NULL;
+	pool->pending = 0;
+	pool->idle = 0;
+	pool->busy = 0;
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->cond, NULL);
+
+	for(i = 0; i < wrk_num; i++) {
+		wrk = &pool->wrk[i];
+		wrk->pool = pool;
+		wrk->id = i;
+
+		pthread_mutex_init(&wrk->dq.lock, NULL);
+		wrk->dq.head = 0;
+		wrk->dq.num = 0;
+		wrk->dq.alloc = DBS_POOL_TASKS;
+
+		if(!(wrk->dq.task = smalloc(DBS_POOL_TASKS *
+						sizeof(struct dbs_pool_task))))
+			goto err_close_pool;
+
+		pool->wrk_num++;
+
+		/*
+		 * The first worker is the thread running the jobs.
+		 */
+		if(i > 0 && pthread_create(&wrk->thread, NULL, dbs_pool_main,
+					wrk) != 0) {
+			sfree(wrk->dq.task);
+			pool->wrk_num--;
+			goto err_close_pool;
+		}
+	}
+
+	return pool;
+
+err_close_pool:
+	dbs_pool_close(pool);
+	ALARM(ALARM_ERR, "Failed to create pool");
+	return NULL;
+
+err_free_pool:
+	sfree(pool);
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to create pool");
+	return NULL;
+}
+
+
+DBS_API void dbs_pool_close(struct dbs_pool *pool)
+{
+	s32 i;
+
+	if(!pool) {
+		ALARM(ALARM_WARN, "pool undefined");
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	for(i = 0; i < pool->wrk_num; i++) {
+		if(i > 0)
+			pthread_join(pool->wrk[i].thread, NULL);
+
+		pthread_mutex_destroy(&pool->wrk[i].dq.lock);
+		sfree(pool->wrk[i].dq.task);
+	}
+
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->cond);
+
+	sfree(pool->wrk);
+	sfree(pool);
+}
+
+
+/*
+ * Take a task from either the back or the front of a deque.
+ *
+ * Returns: 0 on success or -1 if the deque is empty
+ */
+static s8 dbs_pool_take(struct dbs_pool_deque *dq, struct dbs_pool_task *task,
+		s8 back)
+{
+	s8 ret = -1;
+
+	pthread_mutex_lock(&dq->lock);
+
+	if(dq->num > 0) {
+		if(back) {
+			*task = dq->task[(dq->head + dq->num - 1) % dq->alloc];
+		}
+		else {
+			*task = dq->task[dq->head];
+			dq->head = (dq->head + 1) % dq->alloc;
+		}
+
+		DBS_STORE(dq->num, dq->num - 1);
+		ret = 0;
+	}
+
+	pthread_mutex_unlock(&dq->lock);
+	return ret;
+}
+
+
+/*
+ * Get the next task for a worker. If its own deque is empty, the worker tries
+ * to steal from the others, until all tasks of the job are done.
+ *
+ * Returns: 0 on success or -1 if the job is done
+ */
+static s8 dbs_pool_next(struct dbs_pool_worker *wrk, struct dbs_pool_task *task)
+{
+	struct dbs_pool *pool = wrk->pool;
+	struct dbs_pool_deque *dq;
+	s8 ret = -1;
+	s32 i;
+
+	if(dbs_pool_take(&wrk->dq, task, 1) == 0)
+		return 0;
+
+	__atomic_add_fetch(&pool->idle, 1, __ATOMIC_RELAXED);
+
+	while(ret < 0 && DBS_LOAD(pool->pending) > 0) {
+		for(i = 1; i < pool->wrk_num; i++) {
+			dq = &pool->wrk[(wrk->id + i) % pool->wrk_num].dq;
+
+			if(DBS_LOAD(dq->num) > 0 && dbs_pool_take(dq, task, 0) == 0) {
+				ret = 0;
+				break;
+			}
+		}
+
+		if(ret < 0)
+			sched_yield();
+	}
+
+	__atomic_sub_fetch(&pool->idle, 1, __ATOMIC_RELAXED);
+	return ret;
+}
+
+
+/*
+ * Run tasks until the current job is done. A task is only counted as done
+ * after the tasks it pushed have been counted, so the job can't end early.
+ */
+static void dbs_pool_work(struct dbs_pool_worker *wrk)
+{
+	struct dbs_pool *pool = wrk->pool;
+	struct dbs_pool_task task;
+
+	while(dbs_pool_next(wrk, &task) == 0) {
+		pool->fn(wrk, &task, pool->ctx);
+
+		__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL);
+	}
+}
+
+
+static void *dbs_pool_main(void *arg)
+{
+	struct dbs_pool_worker *wrk = arg;
+	struct dbs_pool *pool = wrk->pool;
+	u32 gen = 0;
+
+	while(1) {
+		pthread_mutex_lock(&pool->lock);
+
+		while(!pool->stop && pool->gen == gen)
+			pthread_cond_wait(&pool->cond, &pool->lock);
+
+		if(pool->stop) {
+			pthread_mutex_unlock(&pool->lock);
+			return NULL;
+		}
+
+		gen = pool->gen;
+		pthread_mutex_unlock(&pool->lock);
+
+		dbs_pool_work(wrk);
+
+		__atomic_sub_fetch(&pool->busy, 1, __ATOMIC_RELEASE);
+	}
+}
+
+
+DBS_API s8 dbs_pool_push(struct dbs_pool_worker *wrk,
+		struct dbs_pool_task *task)
+{
+	struct dbs_pool_deque *dq;
+	struct dbs_pool_task *tmp;
+	s32 alloc;
+	s32 i;
+
+	if(!wrk || !task) {
+		ALARM(ALARM_WARN, "wrk or task undefined");
+		return -1;
+	}
+
+	dq = &wrk->dq;
+	pthread_mutex_lock(&dq->lock);
+
+	/*
+	 * Grow the ring buffer, which moves the tasks to the front.
+	 */
+	if(dq->num >= dq->alloc) {
+		alloc = dq->alloc * 2;
+		if(!(tmp = smalloc(alloc * sizeof(struct dbs_pool_task)))) {
+			pthread_mutex_unlock(&dq->lock);
+			return -1;
+		}
+
+		for(i = 0; i < dq->num; i++)
+			tmp[i] = dq->task[(dq->head + i) % dq->alloc];
+
+		sfree(dq->task);
+		dq->task = tmp;
+		dq->head = 0;
+		dq->alloc = alloc;
+	}
+
+	dq->task[(dq->head + dq->num) % dq->alloc] = *task;
+
+	__atomic_add_fetch(&wrk->pool->pending, 1, __ATOMIC_RELAXED);
+	DBS_STORE(dq->num, dq->num + 1);
+
+	pthread_mutex_unlock(&dq->lock);
+	return 0;
+}
+
+
+DBS_API s8 dbs_pool_idle(struct dbs_pool_worker *wrk)
+{
+	return __atomic_load_n(&wrk->pool->idle, __ATOMIC_RELAXED) > 0;
+}
+
+
+DBS_API s8 dbs_pool_run(struct dbs_pool *pool,
+		void (*fn)(struct dbs_pool_worker *wrk,
+			struct dbs_pool_task *task, void *ctx),
+		void *ctx, struct dbs_pool_task *task, s32 task_num)
+{
+	s32 i;
+
+	if(!pool || !fn || (task_num > 0 && !task) || task_num < 0) {
+		ALARM(ALARM_WARN, "pool or fn or task undefined");
+		return -1;
+	}
+
+	pool->fn = fn;
+	pool->ctx = ctx;
+
+	/*
+	 * Spread the first tasks over all workers.
+	 */
+	for(i = 0; i < task_num; i++) {
+		if(dbs_pool_push(&pool->wrk[i % pool->wrk_num], &task[i]) < 0)
+			goto err_drop;
+	}
+
+	pool->busy = pool->wrk_num - 1;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->gen++;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	dbs_pool_work(&pool->wrk[0]);
+
+	/*
+	 * Wait for the other workers to leave the job, so nothing of it is
+	 * used after returning.
+	 */
+	while(__atomic_load_n(&pool->busy, __ATOMIC_ACQUIRE) > 0)
+		sched_yield();
+
+	return 0;
+
+err_drop:
+	for(i = 0; i < pool->wrk_num; i++) {
+		pool->wrk[i].dq.head = 0;
+		pool->wrk[i].dq.num = 0;
+	}
+
+	pool->pending = 0;
+
+	ALARM(ALARM_ERR, "Failed to run job");
+	return -1;
+}
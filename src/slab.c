@@ -0,0 +1,111 @@
+#include "slab.h"
+
+#include "../../alarm/inc/alarm.h"
+
+#include <stdlib.h>
+
+
+DBS_API void dbs_slab_init(struct dbs_slab *slab, s32 size)
+{
+	/*
+	 * Every object has to be able to hold the free list pointer and keep
+	 * the following objects aligned.
+	 */
+	if(size < (s32)sizeof(void *))
+		size = sizeof(void *);
+
+	size = (size + sizeof(void *) - 1) & ~(s32)(sizeof(void *) - 1);
+
+	slab->size = size;
+	slab->per_chunk = DBS_SLAB_CHUNK_SIZE / size;
+	if(slab->per_chunk < 16)
+		slab->per_chunk = 16;
+
+	slab->chunk = NULL;
+	slab->chunk_num = 0;
+	slab->cur = NULL;
+	slab->left = 0;
+	slab->free = NULL;
+	slab->used = 0;
+}
+
+
+DBS_API void dbs_slab_release(struct dbs_slab *slab)
+{
+	struct dbs_slab_chunk *chunk;
+	struct dbs_slab_chunk *next;
+
+	if(!slab) {
+		ALARM(ALARM_WARN, "slab undefined");
+		return;
+	}
+
+	chunk = slab->chunk;
+	while(chunk) {
+		next = chunk->hdr.next;
+		sfree(chunk);
+		chunk = next;
+	}
+
+	slab->chunk = NULL;
+	slab->chunk_num = 0;
+	slab->cur = NULL;
+	slab->left = 0;
+	slab->free = NULL;
+	slab->used = 0;
+}
+
+
+DBS_API void *dbs_slab_alloc(struct dbs_slab *slab)
+{
+	struct dbs_slab_chunk *chunk;
+	void *ptr;
+	s32 tmp;
+
+	/*
+	 * Reuse a freed object if possible.
+	 */
+	if(slab->free) {
+		ptr = slab->free;
+		slab->free = *(void **)ptr;
+		slab->used++;
+		return ptr;
+	}
+
+	/*
+	 * Otherwise allocate a new chunk if the current one is used up.
+	 */
+	if(slab->left < 1) {
+		tmp = sizeof(struct dbs_slab_chunk) + slab->per_chunk * slab->size;
+		if(!(chunk = smalloc(tmp)))
+			goto err_return;
+
+		chunk->hdr.next = slab->chunk;
+		slab->chunk = chunk;
+		slab->chunk_num++;
+
+		slab->cur = (u8 *)(chunk + 1);
+		slab->left = slab->per_chunk;
+	}
+
+	ptr = slab->cur;
+	slab->cur += slab->size;
+	slab->left--;
+	slab->used++;
+	return ptr;
+
+err_return:
+	ALARM(ALARM_ERR, "Failed to allocate slab chunk");
+	return NULL;
+}
+
+
+DBS_API void dbs_slab_free(struct dbs_slab *slab, void *ptr)
+{
+	if(!ptr)
+		return;
+
+	*(void **)ptr = slab->free;
+	slab->free = ptr;
+	slab->used--;
+}
@@ -1,6 +1,18 @@
 #include "utils.h"
 
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/*
+ * The primes used by the 64-bit hash, which are the ones of XXH64.
+ */
+#define DBS_HASH64_P1          0x9E3779B185EBCA87UL
+#define DBS_HASH64_P2          0xC2B2AE3D27D4EB4FUL
+#define DBS_HASH64_P3          0x165667B19E3779F9UL
+#define DBS_HASH64_P4          0x85EBCA77C2B2AE63UL
+#define DBS_HASH64_P5          0x27D4EB2F165667C5UL
 
 
 DBS_API u64 dbs_hash(u8 *buf, s32 len)
@@ -14,3 +26,253 @@ DBS_API u64 dbs_hash(u8 *buf, s32 len)
 
 	return hash;
 }
+
+
+static u64 dbs_hash64_rotl(u64 x, s32 r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+
+/*
+ * Read 8 or 4 bytes in little endian order. Compilers turn this into a single
+ * load on little endian machines.
+ */
+static u64 dbs_hash64_read64(u8 *p)
+{
+	return (u64)p[0] | ((u64)p[1] << 8) | ((u64)p[2] << 16) |
+		((u64)p[3] << 24) | ((u64)p[4] << 32) | ((u64)p[5] << 40) |
+		((u64)p[6] << 48) | ((u64)p[7] << 56);
+}
+
+
+static u64 dbs_hash64_read32(u8 *p)
+{
+	return (u64)p[0] | ((u64)p[1] << 8) | ((u64)p[2] << 16) |
+		((u64)p[3] << 24);
+}
+
+
+/*
+ * Mix 8 bytes into an accumulator.
+ */
+static u64 dbs_hash64_round(u64 acc, u64 in)
+{
+	acc += in * DBS_HASH64_P2;
+	acc = dbs_hash64_rotl(acc, 31);
+	return acc * DBS_HASH64_P1;
+}
+
+
+static u64 dbs_hash64_merge(u64 h, u64 acc)
+{
+	h ^= dbs_hash64_round(0, acc);
+	return h * DBS_HASH64_P1 + DBS_HASH64_P4;
+}
+
+
+/*
+ * Mix 8 or 4 bytes of the tail into the hash value.
+ */
+static u64 dbs_hash64_tail8(u64 h, u8 *p)
+{
+	h ^= dbs_hash64_round(0, dbs_hash64_read64(p));
+	return dbs_hash64_rotl(h, 27) * DBS_HASH64_P1 + DBS_HASH64_P4;
+}
+
+
+static u64 dbs_hash64_tail4(u64 h, u8 *p)
+{
+	h ^= dbs_hash64_read32(p) * DBS_HASH64_P1;
+	return dbs_hash64_rotl(h, 23) * DBS_HASH64_P2 + DBS_HASH64_P3;
+}
+
+
+/*
+ * Spread every bit of the hash value over all bits.
+ */
+static u64 dbs_hash64_avalanche(u64 h)
+{
+	h ^= h >> 33;
+	h *= DBS_HASH64_P2;
+	h ^= h >> 29;
+	h *= DBS_HASH64_P3;
+	h ^= h >> 32;
+	return h;
+}
+
+
+/*
+ * Mix all whole blocks of a buffer into the accumulators.
+ *
+ * Returns: The number of bytes processed
+ */
+static u64 dbs_hash64_blocks(u64 *acc, u8 *buf, u64 len)
+{
+	u64 off;
+
+	for(off = 0; off + DBS_HASH64_BLOCK <= len; off += DBS_HASH64_BLOCK) {
+		acc[0] = dbs_hash64_round(acc[0], dbs_hash64_read64(buf + off));
+		acc[1] = dbs_hash64_round(acc[1], dbs_hash64_read64(buf + off + 8));
+		acc[2] = dbs_hash64_round(acc[2], dbs_hash64_read64(buf + off + 16));
+		acc[3] = dbs_hash64_round(acc[3], dbs_hash64_read64(buf + off + 24));
+	}
+
+	return off;
+}
+
+
+/*
+ * Finish a hash from the accumulators, the total length and the remaining
+ * bytes, which are less than a whole block. If the total length is shorter
+ * than a block, the accumulators have never been used and only the seed is.
+ */
+static u64 dbs_hash64_finish(u64 *acc, u64 seed, u64 total, u8 *buf, u64 len)
+{
+	u64 h;
+	u64 i = 0;
+
+	if(total >= DBS_HASH64_BLOCK) {
+		h = dbs_hash64_rotl(acc[0], 1) + dbs_hash64_rotl(acc[1], 7) +
+			dbs_hash64_rotl(acc[2], 12) + dbs_hash64_rotl(acc[3], 18);
+
+		h = dbs_hash64_merge(h, acc[0]);
+		h = dbs_hash64_merge(h, acc[1]);
+		h = dbs_hash64_merge(h, acc[2]);
+		h = dbs_hash64_merge(h, acc[3]);
+	}
+	else {
+		h = seed + DBS_HASH64_P5;
+	}
+
+	h += total;
+
+	for(; i + 8 <= len; i += 8)
+		h = dbs_hash64_tail8(h, buf + i);
+
+	if(i + 4 <= len) {
+		h = dbs_hash64_tail4(h, buf + i);
+		i += 4;
+	}
+
+	for(; i < len; i++) {
+		h ^= buf[i] * DBS_HASH64_P5;
+		h = dbs_hash64_rotl(h, 11) * DBS_HASH64_P1;
+	}
+
+	return dbs_hash64_avalanche(h);
+}
+
+
+static void dbs_hash64_reset(u64 *acc, u64 seed)
+{
+	acc[0] = seed + DBS_HASH64_P1 + DBS_HASH64_P2;
+	acc[1] = seed + DBS_HASH64_P2;
+	acc[2] = seed;
+	acc[3] = seed - DBS_HASH64_P1;
+}
+
+
+DBS_API u64 dbs_hash_seed(void)
+{
+	static u64 cnt = 0;
+	u64 seed;
+
+	/*
+	 * Mix the time, the position of the stack and a counter, so seeds
+	 * taken shortly after another still differ.
+	 */
+	seed = (u64)time(NULL) ^ ((u64)clock() << 32);
+	seed ^= (u64)(size_t)&seed * DBS_HASH64_P3;
+	seed ^= __atomic_add_fetch(&cnt, 1, __ATOMIC_RELAXED) * DBS_HASH64_P1;
+
+	return dbs_hash64_avalanche(seed);
+}
+
+
+DBS_API u64 dbs_hash64(u8 *buf, u64 len, u64 seed)
+{
+	u64 acc[4];
+	u64 off = 0;
+
+	if(len >= DBS_HASH64_BLOCK) {
+		dbs_hash64_reset(acc, seed);
+		off = dbs_hash64_blocks(acc, buf, len);
+	}
+
+	return dbs_hash64_finish(acc, seed, len, buf + off, len - off);
+}
+
+
+DBS_API u64 dbs_hash64_4(u8 *buf, u64 seed)
+{
+	u64 h = seed + DBS_HASH64_P5 + 4;
+
+	return dbs_hash64_avalanche(dbs_hash64_tail4(h, buf));
+}
+
+
+DBS_API u64 dbs_hash64_8(u8 *buf, u64 seed)
+{
+	u64 h = seed + DBS_HASH64_P5 + 8;
+
+	return dbs_hash64_avalanche(dbs_hash64_tail8(h, buf));
+}
+
+
+DBS_API u64 dbs_hash64_16(u8 *buf, u64 seed)
+{
+	u64 h = seed + DBS_HASH64_P5 + 16;
+
+	h = dbs_hash64_tail8(h, buf);
+	return dbs_hash64_avalanche(dbs_hash64_tail8(h, buf + 8));
+}
+
+
+DBS_API void dbs_hash64_init(struct dbs_hash64_state *st, u64 seed)
+{
+	dbs_hash64_reset(st->acc, seed);
+	st->seed = seed;
+	st->total = 0;
+	st->buf_len = 0;
+}
+
+
+DBS_API void dbs_hash64_update(struct dbs_hash64_state *st, u8 *buf, u64 len)
+{
+	u64 tmp;
+
+	st->total += len;
+
+	/*
+	 * Fill up the buffered block first.
+	 */
+	if(st->buf_len > 0) {
+		tmp = DBS_HASH64_BLOCK - st->buf_len;
+		if(tmp > len)
+			tmp = len;
+
+		memcpy(st->buf + st->buf_len, buf, tmp);
+		st->buf_len += tmp;
+		buf += tmp;
+		len -= tmp;
+
+		if(st->buf_len < DBS_HASH64_BLOCK)
+			return;
+
+		dbs_hash64_blocks(st->acc, st->buf, DBS_HASH64_BLOCK);
+		st->buf_len = 0;
+	}
+
+	tmp = dbs_hash64_blocks(st->acc, buf, len);
+
+	memcpy(st->buf, buf + tmp, len - tmp);
+	st->buf_len = len - tmp;
+}
+
+
+DBS_API u64 dbs_hash64_final(struct dbs_hash64_state *st)
+{
+	return dbs_hash64_finish(st->acc, st->seed, st->total, st->buf,
+			st->buf_len);
+}